@@ -1,8 +1,19 @@
 #ifndef CACHE_H   
 #define CACHE_H
 
+#include "geometry.h"
+#include "replacement.h"
+
+// SIMULATION MODE
+
+// Build with -DTAG_ONLY_SIMULATION (make tag_only) to leave out the data payloads of the cache entries and main memory frames and all block copies.
+// Only tags and status bits are simulated, so hit/miss behaviour is identical while the simulated hierarchy is a fraction of the size.
+// #define TAG_ONLY_SIMULATION
+
 // L1 CACHE MACROS
 
+// The NUM_* macros give the default geometry - the caches are sized at run time from a level_geometry (see geometry.h)
+
 // 2KB 4-way set-associative L1 WAY-HALTING cache
 #define NUM_L1_CACHE_WAYS 4
 #define NUM_L1_CACHE_SETS 16
@@ -13,7 +24,7 @@
 #define NUM_L1_CACHE_HALT_TAG_BITS 4 
 #define NUM_L1_CACHE_MAIN_TAG_BITS 12      
 
-#define NUM_L1_LRU_COUNTER_BITS 8
+#define L1_CACHE_REPLACEMENT_POLICY REPLACEMENT_LRU
 
 // L2 CACHE MACROS
 
@@ -25,6 +36,8 @@
 #define NUM_L2_CACHE_SET_INDEX_BITS 5
 #define NUM_L2_CACHE_OFFSET_BITS 6
 #define NUM_L2_CACHE_TAG_BITS 14
+
+#define L2_CACHE_REPLACEMENT_POLICY REPLACEMENT_FIFO
  
 // BIT/FLAG VALUE MACROS
 
@@ -44,10 +57,18 @@
 #define INSTRUCTION 0
 #define DATA 1
 
-// To specify L1 way status
+// To specify L1 way status (bit of the halted ways mask)
 #define ACTIVE 0
 #define HALTED 1
 
+// L2 cache tag compare kernels - specialised for the common way counts, AVX2 kernels are selected at run time if the CPU supports them
+#define L2_TAG_MATCH_GENERIC 0
+#define L2_TAG_MATCH_8_WAYS 1
+#define L2_TAG_MATCH_16_WAYS 2
+#define L2_TAG_MATCH_32_WAYS 3
+#define L2_TAG_MATCH_16_WAYS_AVX2 4
+#define L2_TAG_MATCH_32_WAYS_AVX2 5
+
 // To specify the operation to be performed
 #define READ_ACCESS 0
 #define WRITE_ACCESS 1
@@ -69,70 +90,82 @@ typedef struct {
 
 // L1 cache entry structure 
 typedef struct {
-    unsigned int main_tag_bits:11;                        // First 11 bits of 15-bit cache tag bits - stored as main tag bits with each entry 
+    unsigned int main_tag_bits;                           // Cache tag bits above the halt tag bits - stored as main tag bits with each entry 
     unsigned int valid_bit:1;                             // Valid bit - set if the corresponding entry is valid
     unsigned int dirty_bit:1;                             // Dirty bit - set if the corresponding entry has been modified in this level but not updated in the next level
                                                           // (L1 cache uses write-back policy)
     unsigned int write_bit:1;                             // Read-Write permissions for the data block 
-    data_byte data_blocks [NUM_L1_CACHE_BLOCK_SIZE];      // 32B data block - 1B data stored in each array element
 } L1_cache_entry;
 
-// L1 cache structures
+// L1 cache structures - all arrays are sized from the geometry, the entry of way w in set s is at index s * num_ways + w
 typedef struct {
-    L1_cache_entry l1_cache_entry [NUM_L1_CACHE_WAYS];     // Array of NUM_L1_CACHE_WAYS L1 cache entries per set
-    unsigned int lru_counter [NUM_L1_CACHE_WAYS];          // N.log(N) bit LRU counter is maintained per set - assume log(N) bits stored in each array element N - No. of ways 
-} L1_cache_sets;                                           // log -- (base 2)
-
-typedef struct {
-    unsigned int halt_tags_per_way [NUM_L1_CACHE_SETS];    // The last 4 bits of tag are maintained in a halt tag array - maintained per way (Way Halting Cache)
-} Halt_tag_array;
-
-typedef struct {
-    L1_cache_sets l1_cache_sets [NUM_L1_CACHE_SETS];       // And array of NUM_L1_CACHE_SETS such sets make L1 cache
-    Halt_tag_array halt_tag_array [NUM_L1_CACHE_WAYS];     // Array of NUM_L1_CACHE_WAYS halt tags -- cuz Way-Halting cache
-    int way_status [NUM_L1_CACHE_WAYS];                    // Way-halting cache shuts down ways in which misses are pre-determined. Way status indicates if a particular way is HALTED or ACTIVE.
+    level_geometry geometry;                              // Sets, ways, block size and the derived shifts / masks
+    unsigned int halt_tag_bits;                           // Low-order tag bits kept in the halt tag arrays
+    L1_cache_entry *l1_cache_entries;                     // num_sets * num_ways L1 cache entries
+#ifndef TAG_ONLY_SIMULATION
+    data_byte *data_blocks;                               // block_size B data block per entry - 1B data stored in each array element
+#endif
+    replacement_state replacement;                        // Replacement policy state (LRU by default)
+    unsigned int *halt_tag_array;                         // The low-order tag bits of each entry are maintained in a halt tag array per way (Way Halting Cache) - [way][set]
+    unsigned long long *halt_tag_presence;                // Bit s of the bitmap of [halt tag h][way i] set if the VALID entry of set s in way i has halt tag h
+    unsigned int halt_tag_presence_words;                 // 64-bit words per presence bitmap (one bit per set)
+    unsigned int halted_ways_mask;                        // Way-halting cache shuts down ways in which misses are pre-determined. Bit i is set (HALTED) if way i is halted for the current access, clear if ACTIVE.
+    double av_num_ways_halted;                            // Sum over all searches of the fraction of ways halted (divide by the number of searches for the average)
 } L1_cache;
 
-// L2 CACHE ADT DEFINITIONS
+// L1 cache entry, data block and halt tag of way w in set s
+#define L1_CACHE_ENTRY(l1_cache, s, w) (&(l1_cache)->l1_cache_entries[(s) * (l1_cache)->geometry.num_ways + (w)])
+#define L1_CACHE_DATA_BLOCK(l1_cache, s, w) ((l1_cache)->data_blocks + ((size_t) (s) * (l1_cache)->geometry.num_ways + (w)) * (l1_cache)->geometry.block_size)
+#define L1_CACHE_HALT_TAG(l1_cache, s, w) ((l1_cache)->halt_tag_array[(w) * (l1_cache)->geometry.num_sets + (s)])
 
-// L2 cache entry structure 
-typedef struct {
-    unsigned int tag:NUM_L2_CACHE_TAG_BITS;               // 14-bit cache tag bits 
-    unsigned int valid_bit:1;                             // Valid bit - set if the corresponding entry is valid
-    unsigned int write_bit:1;                             // Read-Write permissions for the data block 
-    data_byte data_blocks [NUM_L2_CACHE_BLOCK_SIZE];      // 64B data block - 1B data stored in each array element
-} L2_cache_entry;
+// L2 CACHE ADT DEFINITIONS
 
-typedef struct {
-   L2_cache_entry l2_cache_entry [NUM_L2_CACHE_WAYS];     // Array of NUM_L2_CACHE_WAYS L2 cache entries per set
-   unsigned int fifo_bits:4;                              // log(N) bit FIFO counter is maintained per set - assume log(N) bits stored in each array element N - No. of ways 
-} L2_cache_sets;                                          // log -- (base 2)
+// L2 cache tag store entry - the tag (at most 15 bits) and the valid bit of a way packed into 16 bits as (tag << 1) | valid_bit,
+// so the 16 ways of a set fit one 32B vector and a single 16-lane compare against (tag << 1) | VALID finds the matching VALID way
+#define L2_CACHE_TAG_ENTRY(tag, valid_bit) ((unsigned short) (((tag) << 1) | (valid_bit)))
 
-// L2 cache structures
+// L2 cache structures - all arrays are sized from the geometry, the entry of way w in set s is at index s * num_ways + w
 typedef struct {
-    L2_cache_sets l2_cache_sets [NUM_L2_CACHE_SETS];                      
+    level_geometry geometry;                              // Sets, ways, block size and the derived shifts / masks
+    unsigned int l1_block_size;                           // Size of the blocks handed to the L1 caches (part of an L2 block)
+    int tag_match_kernel;                                 // Tag compare kernel selected for the way count and CPU (L2_TAG_MATCH_*)
+    unsigned short *tag_store;                            // Packed tag + valid bit of every way, one vector per set (32B aligned)
+    unsigned int tag_store_stride;                        // Tag store entries per set - num_ways rounded up to a whole number of 16B vectors
+#ifndef TAG_ONLY_SIMULATION
+    data_byte *data_blocks;                               // block_size B data block per entry (tags are kept apart in the tag store)
+#endif
+    unsigned int *write_bits;                             // Read-Write permissions of the data blocks per set - bit i set if way i is READ_WRITE 
+    unsigned int *valid_bits;                             // Valid bits per set (copy of the tag store valid bits) - bit i set if way i is VALID
+    replacement_state replacement;                        // Replacement policy state (FIFO by default)
 } L2_cache;
 
+// L2 cache tag store entries and data block of way w in set s
+#define L2_CACHE_TAG_STORE_SET(l2_cache, s) ((l2_cache)->tag_store + (s) * (l2_cache)->tag_store_stride)
+#define L2_CACHE_DATA_BLOCK(l2_cache, s, w) ((l2_cache)->data_blocks + ((size_t) (s) * (l2_cache)->geometry.num_ways + (w)) * (l2_cache)->geometry.block_size)
+
+#ifdef TAG_ONLY_SIMULATION
+// Placeholder block returned by the L2 cache and main memory block lookups in place of the (left out) data - never read
+extern data_byte tag_only_data_block [PAGE_SIZE];
+#endif
+
 // L1 CACHE FUNCTION DECLARATIONS
 
 // Initializes the L1 instruction and data cache by allocating memory for the structures and initializing all the entries
-L1_cache* initialize_L1_cache (int cache_type);
+L1_cache* initialize_L1_cache (int cache_type, const memory_geometry *geometry);
+
+// Frees the L1 cache structure and its arrays
+void free_L1_cache (L1_cache* l1_cache);
 
 // Search the L1 cache for the datablock entry corresponding to the given physical address 
 unsigned int search_L1_cache (L1_cache* l1_cache, unsigned int physical_address, unsigned int write_data, int access_type);
 
 // Predetermine the misses by searching all the halt tag arrays for the halt tag corresponding to the given physical address (in PARALLEL with set index decoding)
 // So that it can HALT the ways in which a miss is predetermined in order to prevent unnecessary access, thereby saving energy
-void L1_cache_way_halting_function (L1_cache* l1_cache, unsigned int halt_tag);
-
-// Update the L1 cache with the data acquired from the next level in memory (L2 cache) - placement / random replacement
-void update_L1_cache (L1_cache* l1_cache, L2_cache* l2_cache, data_byte *data, unsigned int physical_address);
+void L1_cache_way_halting_function (L1_cache* l1_cache, unsigned int set_index, unsigned int halt_tag);
 
-// Updates the LRU counter at every access that results in L1 cache hit 
-void update_L1_LRU_counter (L1_cache *l1_cache, int set_index, int way_index);
-
-// Get the Least Recently Used entry's way index from LRU counter (way corresponding to the entry 00)
-int get_L1_LRU_way_entry (L1_cache* l1_cache, int set_index);
+// Update the L1 cache with the data acquired from the next level in memory (L2 cache) - placement / replacement (LRU by default)
+// Returns 1 if a dirty block was replaced and, with no L2 cache given, left for the caller to write back from *write_back_address
+int update_L1_cache (L1_cache* l1_cache, L2_cache* l2_cache, data_byte *data, unsigned int physical_address, unsigned int *write_back_address);
 
 // Print all L1 cache entries
 void print_L1_cache (L1_cache *l1_cache);
@@ -143,19 +176,20 @@ int calc_exp (int a, int b);
 // L2 CACHE FUNCTION DECLARATIONS
 
 // Initializes the L2 cache by allocating memory for the structures and initializing all the entries
-L2_cache* initialize_L2_cache ();
+L2_cache* initialize_L2_cache (const memory_geometry *geometry);
 
-// Search the L2 cache for the datablock entry corresponding to the given physical address 
-data_byte* search_L2_cache (L2_cache* l2_cache, unsigned int physical_address, data_byte* write_data, int access_type);
+// Frees the L2 cache structure and its arrays
+void free_L2_cache (L2_cache* l2_cache);
 
-// Update the L2 cache with the data acquired from the next level in memory (Main memory) - placement / random replacement
-void update_L2_cache (L2_cache* l2_cache_1, data_byte* data,unsigned int physical_address);
+// Search the L2 cache for the datablock entry corresponding to the given physical address - READ returns a pointer view of the L1-sized block inside the L2 entry
+data_byte* search_L2_cache (L2_cache* l2_cache, unsigned int physical_address, data_byte* write_data, int access_type);
 
-// Updates the FIFO counter at every access that results in L2 cache hit
-void update_L2_FIFO_counter (L2_cache* l2_cache_1, int set_index);
+// Find the way of the given set holding a VALID entry with the given tag (SIMD compare of the packed tag store) - returns -1 if there is none
+int find_L2_cache_way (L2_cache* l2_cache, unsigned int set_index, unsigned int tag);
 
-// Get the earliest arrived (FIFO) entry's way index from FIFO counter (way corresponding to the entry 0000)
-int get_FIFO_way_entry (L2_cache* l2_cache_1,int set_index);
+// Update the L2 cache with the data acquired from the next level in memory (Main memory) - placement / replacement (FIFO by default).
+// Returns a pointer view of the L1-sized block within the placed block, like a READ search
+data_byte* update_L2_cache (L2_cache* l2_cache, data_byte* data, unsigned int physical_address);
 
 // Print all L2 cache entries
 void print_L2_cache (L2_cache *l2_cache);
@@ -1,34 +1,27 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "tlb.h"
 #include "cache.h"
 #include "pagetable.h"
 #include "processes.h"
 #include "mainmemory.h"
+#include "simulator.h"
+#include "geometry.h"
+#include "sweep.h"
+#include "stack_distance.h"
+#include "parallel_l2.h"
 
 int main (int argc, char *argv[]) {
 
     int num_processes;                          // Total number of processes
     PCB *pcb_ptr;                               // Pointer to the pcb structure array
     FILE *fptr;                                 // Input file pointer
-    trace_info trace;                           // Trace info struct - consists of address bit fields
-    unsigned int frame_number_returned = 0;     // Temporary variable to store return value of TLB search functions
-    page_table_entry* pte;                      // Temporary variable to hold return value of page table walk function
+    trace_info traces[TLB_BATCH_MAX];           // Trace info structs of a batch - consist of address bit fields
+    int access_types[TLB_BATCH_MAX];            // L1 cache access type of each trace of the batch
+    int num_batch_traces = 0;                   // Number of traces in the batch
     page_table *temp_pt;
-    L1_cache *l1_cache_access_ptr;              // To set l1 access pointer to l1 instruction/data cache pointer depending on trace type
-    int l1_cache_access_type = 0;               // To set l1 cache access depending on trace type
-    unsigned int l1_data_returned = 0;          // Temporary variable to store return value of L1 cache search function         
-    data_byte l1_cache_write_data;              // Temporary variable to data to be written into L1 cache
-    l1_cache_write_data.data = 255;             // Random data value chosen for l1 cache write simulation -- in an actual system, the processor will write the result obtained to the data memory 
-
-    // Pointer to structure to store L1 datablock returned by L2 cache search function after miss in L1 cache
-    data_byte *l2_l1_data_block_returned;  
-    l2_l1_data_block_returned = malloc (NUM_L1_CACHE_BLOCK_SIZE * sizeof (data_byte));
-
-    // Pointer to structure to store L2 datablock returned by main memory search function after miss in L1 cache
-    data_byte *mm_l2_data_block_returned;  
-    mm_l2_data_block_returned = malloc (NUM_L2_CACHE_BLOCK_SIZE * sizeof (data_byte));
 
     double tlb_L1_hit_rate = 0.0;
     double tlb_L2_hit_rate = 0.0;
@@ -37,29 +30,50 @@ int main (int argc, char *argv[]) {
     // double main_memory_hit_rate = 0.0;
     double page_fault_frequency = 0.0;          
 
-    // Initialize all the memory subsystem structures
-    main_memory *mm_ptr;
-    mm_ptr = main_memory_init();
-     
-    // Initialize L1 TLB
-    L1_TLB *l1_tlb;
-    l1_tlb = initialize_L1_TLB ();
+    // Usage: driver [-s <sweep file>] [-m <miss-ratio curve file>] [-p <L2 worker threads>] [<geometry file>]
+    const char *sweep_filename = NULL;
+    const char *miss_ratio_curve_filename = NULL;
+    int num_l2_worker_threads = 0;
+    int arg_index = 1;
+    while (arg_index + 1 < argc && argv[arg_index][0] == '-') {
+        if (strcmp (argv[arg_index], "-s") == 0)
+            sweep_filename = argv[arg_index + 1];
+        else if (strcmp (argv[arg_index], "-m") == 0)
+            miss_ratio_curve_filename = argv[arg_index + 1];
+        else if (strcmp (argv[arg_index], "-p") == 0)
+            num_l2_worker_threads = atoi (argv[arg_index + 1]);
+        else {
+            printf(" ERROR: Unknown option %s\n", argv[arg_index]);
+            return -1;
+        }
+        arg_index = arg_index + 2;
+    }
 
-    // Initialize L2 TLB
-    L2_TLB *l2_tlb;
-    l2_tlb = initialize_L2_TLB ();       
+    // Load the TLB and cache geometry - the compiled-in defaults, overridden by the geometry file given as argument (if any)
+    memory_geometry geometry;
+    set_default_memory_geometry (&geometry);
+    if (argc > arg_index && load_memory_geometry (argv[arg_index], &geometry) < 0)
+        return -1;
+    print_memory_geometry (&geometry);
 
-    // Initialize L1 INSTRUCTION cache
-    L1_cache *l1_instr_cache;
-    l1_instr_cache = initialize_L1_cache (INSTRUCTION);
+    // Cache sweep - the translated physical address stream is also fed to the cache configurations listed in the sweep file
+    cache_sweep *sweep = NULL;
+    if (sweep_filename != NULL) {
+        sweep = start_cache_sweep (sweep_filename, &geometry);
+        if (sweep == NULL)
+            return -1;
+    }
 
-    // Initialize L1 DATA cache
-    L1_cache *l1_data_cache;
-    l1_data_cache = initialize_L1_cache (DATA);  
+    // Stack distance analysis - LRU miss-ratio curves of every cache / TLB size from the same translated access stream
+    stack_distance_analyzer *stack_distance = NULL;
+    if (miss_ratio_curve_filename != NULL)
+        stack_distance = initialize_stack_distance_analyzer (&geometry);
 
-    // Initialize L2 cache
-    L2_cache *l2_cache;                 
-    l2_cache = initialize_L2_cache ();        
+    // Initialize all the memory subsystem structures - main memory, frame table, page tables, TLBs and caches belong to the simulator context
+    simulator_context *ctx;
+    ctx = initialize_simulator_context (&geometry);
+    ctx->sweep = sweep;
+    ctx->stack_distance = stack_distance;
 
     // Open and read input file
     fptr = fopen ("process_files.txt","r");
@@ -86,15 +100,26 @@ int main (int argc, char *argv[]) {
     proc_access_info = malloc (num_processes * sizeof (Proc_Access_Info));
     initialize_access_info_structs (proc_access_info, num_processes);
 
+    // Parallel L2 back end - the L1 misses are simulated in the L2 cache by worker threads, each owning a range of L2 sets
+    parallel_L2_cache *parallel_l2 = NULL;
+    if (num_l2_worker_threads > 0) {
+        parallel_l2 = start_parallel_L2_cache (ctx->l2_cache, num_l2_worker_threads, num_processes);
+        if (parallel_l2 == NULL)
+            return -1;
+        ctx->parallel_l2 = parallel_l2;
+    }
+
     // First 2 blocks of all the READY processes are prepaged
-    prepaging_function (pcb_ptr, proc_access_info, num_processes);
+    prepaging_function (ctx, pcb_ptr, proc_access_info, num_processes);
+
+    // Start reading and decoding the traces of all processes ahead of the simulation (TRACE_PREFETCH)
+    start_trace_prefetching (pcb_ptr, num_processes);
     
     int i = 0; 
     int j = 0;
-    unsigned int temp = 0; // to scan trace (logical address)
-    int shared_bit = 0;
+    int num_ready_processes = 0;
 
-    int fscanf_retval = 0; 
+    int trace_read_retval = 0; 
 
     while (1) {
 
@@ -105,250 +130,42 @@ int main (int argc, char *argv[]) {
 
                // Till number of traces simulated reaches max limit before context switch
                // Carry out simulations for process i
+               switch_TLB_address_space (ctx, pcb_ptr[i].pid);
 
-               for (j = 0; j < pcb_ptr[i].num_traces_context_sw; j++) {
+               for (j = 0; j < pcb_ptr[i].num_traces_context_sw; j = j + num_batch_traces) {
 
-                   // Read next trace (32-bit logical address) from input file
-                   fscanf_retval = fscanf(pcb_ptr[i].proc_input_file, "%x", &temp);
+                   // Get the next traces (32-bit logical address, trace type and page number) of the quantum from input file - a batch at a time
+                   num_batch_traces = 0;
+                   trace_read_retval = 0;
+                   while (num_batch_traces < TLB_BATCH_MAX && j + num_batch_traces < pcb_ptr[i].num_traces_context_sw) {
+                       trace_read_retval = get_next_trace_info(&pcb_ptr[i], &traces[num_batch_traces]);
+                       if (trace_read_retval == EOF)
+                           break;
+
+                       // If the trace is data address, access type approximately 72% read 28% write (P&H) - to simulate different access types,
+                       // generate a random number that gives a 0 - read 75% (e*o, e*e, o*e all div by 2) times, 1 - write 25% - (o*o not div by 2) times
+                       // (instruction traces are always read)
+                       if (traces[num_batch_traces].trace_type == DATA && (rand() % 2) * (rand() % 2))
+                           access_types[num_batch_traces] = WRITE_ACCESS;
+                       else
+                           access_types[num_batch_traces] = READ_ACCESS;
+                       num_batch_traces++;
+                   }
+
+                   // TLBs, page tables, caches and main memory
+                   simulate_access_batch (ctx, traces, access_types, num_batch_traces, &pcb_ptr[i], &proc_access_info[i], i);
 
                    // If EOF detected, TERMINATE the process, flush TLBs and free the memory structs
-                   if (fscanf_retval == EOF) {
+                   if (trace_read_retval == EOF) {
                        pcb_ptr[i].process_state = TERMINATED;
-                       fclose(pcb_ptr[i].proc_input_file);
+                       close_trace_input(&pcb_ptr[i]);
 
                        // Free page table, invalidate frames
-                       page_table_free(pcb_ptr[i].page_dir_base_addr);
+                       page_table_free(ctx, pcb_ptr[i].page_dir_base_addr);
 
-                       flush_L1_TLB (l1_tlb);
-                       flush_L2_TLB (l2_tlb);
+                       release_TLB_address_space (ctx, pcb_ptr[i].pid);
                        break;
                    }
-
-                   trace.logical_address = temp;
-                   // printf(" Logical address (trace): %x\n", trace.logical_address);           
-           
-                   // Determining if the trace belongs to instruction series (7f) or data series (10) 
-                   // - reqd to determine L1 (split) cache type
-                   if ((trace.logical_address >> 24) == 0x7f)
-                       trace.trace_type = INSTRUCTION;
-                   else
-                       trace.trace_type = DATA;
-            
-                   // Extract 23-bit page number from the 32-bit logical address
-                   trace.page_number = trace.logical_address >> 9;
-                   // printf(" Initiating TLB search for entries with the corresponding page number: %x\n", trace.page_number);
-             
-                   // ------------------------------------- TLB search ----------------------------------------------
-                
-                   // Search L1 TLB 
-                   frame_number_returned = search_L1_TLB (l1_tlb, trace.page_number);
-                   proc_access_info[i].num_l1_tlb_accesses++;
-
-                   // If the returned frame number is within valid range - L1 TLB HIT - frame number acquired
-                   if (frame_number_returned >= 0 && frame_number_returned <= MAX_FRAME_NUMBER) {
-                       trace.frame_number = frame_number_returned;
-                       // printf(" L1 TLB hit!\n Entry found - Page number %x, Frame number %x\n", trace.page_number, trace.frame_number);
-                       proc_access_info[i].num_l1_tlb_hits++;          
-                   }
-        
-                   // If the returned frame number is NOT within valid range - L1 TLB MISS
-                   else { 
-                       // printf(" L1 TLB miss!\n");
-                       proc_access_info[i].num_l1_tlb_misses++;
-           
-                       // Search L2 TLB
-                       frame_number_returned = search_L2_TLB (l2_tlb, trace.page_number);
-                       proc_access_info[i].num_l2_tlb_accesses++;
-           
-                       // If the returned frame number is within valid range - L2 TLB HIT - frame number acquired
-                       if (frame_number_returned >= 0 && frame_number_returned <= MAX_FRAME_NUMBER) {
-                           trace.frame_number = frame_number_returned;
-                           // printf(" L2 TLB hit!\n Entry found - Page number %x, Frame number %x\n", trace.page_number, trace.frame_number);
-                           proc_access_info[i].num_l2_tlb_hits++;
-                           
-                           // L1 TLB updation after L2 TLB hit
-                           update_L1_TLB (l1_tlb, trace.page_number, frame_number_returned, shared_bit);
-                       }
-                
-                       // If the returned frame number is NOT within valid range - L2 TLB MISS
-                       else {
-                           // printf(" L2 TLB miss!\n");
-                           proc_access_info[i].num_l2_tlb_misses++;
-           
-                           // EXCEPTION: Kernel performs page table walk and updates the TLB entry in both the levels (first L2 TLB, then L1 TLB)
-                           pte = get_page_entry (trace.page_number, pcb_ptr, proc_access_info);
-                           proc_access_info[i].num_main_memory_accesses++;
-                           frame_number_returned = pte->pageframe.frame_num;
-                           shared_bit = pte->shared_bit;
-                       
-                           // Number of main memory hits/misses updated in main memory functions - we check the updated value of page fault frequency
-                           proc_access_info[i].page_fault_frequency = (double)proc_access_info[i].num_main_memory_misses/(double)proc_access_info[i].num_main_memory_accesses;
-
-                           // Check for thrashing after every main memory access 
-                           /*                           
-                           if (proc_access_info[i].page_fault_frequency > MAX_PAGE_FAULT_FREQUENCY) {
-                               // printf(" Process page fault frequency exceeds MAX LIMIT..THRASHING DETECTED!\n Swapping process out by changing state to WAITING\n");
-                               pcb_ptr[i].process_state = WAITING;
-                               flush_L1_TLB (l1_tlb);
-                               flush_L2_TLB (l2_tlb);
-                           
-                               // Invalidate all of its pages  --- loop (4 times) starting from outermost structure
-                               for (int k = 0; k < 4; k++)
-                                   invalidate_page(pcb_ptr[i].page_dir_base_addr->entry_table[k].pageframe.p_table_index); // ideally should be swapped into swap space
-                               break; 
-                           } */                     
-                
-                           // Update L2 TLB with the acquired entry -- KERNEL
-                           update_L2_TLB (l2_tlb, trace.page_number, frame_number_returned, shared_bit);
-                           // printf(" L2 TLB updated by Kernel!\n");
-                           // print_L2_tlb (l2_tlb);
-               
-                           // Update L1 TLB with the acquired entry -- KERNEL
-                           update_L1_TLB (l1_tlb, trace.page_number, frame_number_returned, shared_bit);
-                           // printf(" L1 TLB updated by Kernel!\n");
-                           // print_L1_tlb (l1_tlb);
-                   
-                           // Accessing L1 TLB again, would result DEFINITELY result in a hit - Search L1 TLB 
-                           frame_number_returned = search_L1_TLB (l1_tlb, trace.page_number);
-                           proc_access_info[i].num_l1_tlb_accesses++;
-
-                           // If the returned frame number is within valid range - L1 TLB HIT - frame number acquired
-                           if (frame_number_returned >= 0 && frame_number_returned <= MAX_FRAME_NUMBER) {
-                               trace.frame_number = frame_number_returned;
-                               // printf(" L1 TLB hit after updation!\n Entry found - Page number %x, Frame number %x\n", trace.page_number, trace.frame_number);
-                               proc_access_info[i].num_l1_tlb_hits++;          
-                           }
-                       }
-                   }
-                      
-                   // Getting physical address from the frame number 
-                   trace.physical_address = ((trace.frame_number << 9) | (trace.logical_address % 512));
-                   // printf (" Therefore, corresponding physical address: %x\n\n", trace.physical_address);
-           
-                   // -------------------------------------------Cache & Memory accesses -------------------------------------------------------
-            
-                   // printf(" Initiating L1 cache search for datablock entries corresponding to the physical address %x\n", trace.physical_address);
-            
-                   // Determine which L1 cache (INSTRUCTION or DATA) is to be accessed depending on trace type
-            
-                   // If the trace is instruction address - L1 instruction cache to be accessed, access type is always read
-                   if (trace.trace_type == INSTRUCTION) { 
-                       l1_cache_access_ptr = l1_instr_cache;
-                       l1_cache_access_type = READ_ACCESS;
-                       // num_l1_instr_cache_accesses++;
-                   }
-            
-                   // If the trace is data address - L1 data cache to be accessed, access type approximately 72% read 28% write (P&H) 
-                   else {
-                       l1_cache_access_ptr = l1_data_cache;
-                       // num_l1_data_cache_accesses++;
-                   
-                       // To simulate different access types - generate a random number that gives a 0 -
-                       // - read 75% (e*o, e*e, o*e all div by 2) times, 1 - write 25% - (o*o not div by 2) times
-                       if ((rand() % 2) * (rand() % 2)) {
-                           l1_cache_access_type = WRITE_ACCESS;
-                           // num_l1_data_cache_write_accesses++;
-                       }
-                
-                       else {
-                           l1_cache_access_type = READ_ACCESS;
-                           // num_l1_data_cache_read_accesses++;
-                       }
-                   }
-            
-                   // Search entry corresponding to the given physical address in L1 cache - if found, read/write the corresponding - 
-                   // - datablock depending on the access type 
-                   l1_data_returned = search_L1_cache (l1_cache_access_ptr, trace.physical_address, l1_cache_write_data.data, l1_cache_access_type);
-                   proc_access_info[i].num_l1_cache_accesses++;
-                   
-                   // If data returned by L1 cache is within valid range, L1 cache HIT for READ access     
-                   if (l1_data_returned >= 0 && l1_data_returned <= 255) {
-                       proc_access_info[i].num_l1_cache_hits++;
-                   
-                       if (trace.trace_type == INSTRUCTION) {
-                           // num_l1_instr_cache_hits++;
-                           // printf(" L1 INSTRUCTION cache hit!\n The processor successfully read the data %x corresponding to the address %x from L1 INSTRUCTION cache.\n", l1_data_returned, trace.physical_address);
-                       }
-                       else {
-                           // num_l1_data_cache_hits++;
-                           // printf(" L1 DATA cache hit!\n The processor successfully read the data from the datablock %x corresponding to the address %x from L1 DATA cache.\n", l1_data_returned, trace.physical_address);   
-                       }
-                   }
-               
-                   // If the function returns L1_CACHE_WRITE_SUCCESSFUL flag, L1 cache HIT for WRITE access 
-                   else if (l1_data_returned == L1_CACHE_WRITE_SUCCESSFUL) {
-                       // num_l1_data_cache_hits++;
-                       proc_access_info[i].num_l1_cache_hits++;
-                       // printf(" L1 DATA cache hit!\n The processor successfully wrote the data into the datablock %x corresponding to the address %x into L1 DATA cache.\n", l1_data_returned, trace.physical_address);
-                   }
-            
-                   // If the function returns L1_CACHE_WRITE_PROTECTION_EXCEPTION flag, L1 cache MISS for WRITE access, since this is an EXCEPTION - Execute exception routine
-                   // Second access to L1 will be a HIT in this case 
-                   else if (l1_data_returned == L1_CACHE_WRITE_PROTECTION_EXCEPTION) {
-                       // printf(" L1 DATA cache miss!\n The datablock %x corresponding to the address %x was found in L1 DATA cache.\n But the process executing does not have the permission to write into this datablock.\n Execute WRITE PROTECT EXCEPTION routine for process %d...\n", l1_data_returned, trace.physical_address, i);
-                   
-                       // num_l1_data_cache_misses++;
-                       proc_access_info[i].num_l1_cache_misses++;
-                   
-                       // Will execute the exception routine, re-execute same instruction - next time access will result in hit
-                   
-                       // num_l1_data_cache_hits++; 
-                       proc_access_info[i].num_l1_cache_hits++;
-                   }
-            
-                   // if NOT found -- LOOK-THROUGH to L2 cache and update L1 with the datablock entry reqd
-                   else {
-                       // printf(" L1 cache miss!\n");
-                       proc_access_info[i].num_l1_cache_misses++;
-                   
-                       // *** L2 is Look-aside --> search L2 and main memory simultaneously
-                
-                       // If the entry corresponding to the given physical address is not found in L1, cache miss stall and search in L2 (L1 follows look-through policy) 
-                       l2_l1_data_block_returned = search_L2_cache (l2_cache, trace.physical_address, NULL, READ_ACCESS);
-                       proc_access_info[i].num_l2_cache_accesses++;
-                       
-                       // But since L2 is look-aside, when L2 search is initiated, L2 sends a signal to start searching main memory
-                       mm_l2_data_block_returned = get_l2_block (trace.physical_address >> NUM_L2_CACHE_OFFSET_BITS, &proc_access_info[i]);
-                
-                       // If search L2 cache returns a NULL pointer - L2 cache miss
-                       if (l2_l1_data_block_returned == NULL) {
-                           // printf(" L2 cache miss!\n");
-                           proc_access_info[i].num_l2_cache_misses++;
-                           proc_access_info[i].num_main_memory_accesses++;  // incrementing main memory access only when L2 is miss
-                                                                            // else, L2 accessed
-                       
-                           // Number of main memory hits/misses updated in main memory functions - we check the updated value of page fault frequency
-                           proc_access_info[i].page_fault_frequency = (double)proc_access_info[i].num_main_memory_misses/(double)proc_access_info[i].num_main_memory_accesses;
-                           /*
-                           // Check for thrashing after every main memory access                                                  
-                           if (proc_access_info[i].page_fault_frequency > MAX_PAGE_FAULT_FREQUENCY) {
-                               // printf(" Process page fault frequency exceeds MAX LIMIT..THRASHING DETECTED!\n Swapping process out by changing state to WAITING\n");
-                               pcb_ptr[i].process_state = WAITING;
-                               flush_L1_TLB (l1_tlb);
-                               flush_L2_TLB (l2_tlb);
-                           
-                               // Invalidate all of its pages  --- loop (4 times) starting from outermost structure
-                               for (int k = 0; k < 4; k++)
-                                   invalidate_page(pcb_ptr[i].page_dir_base_addr->entry_table[k].pageframe.p_table_index); // ideally should be swapped into swap space
-                               break; 
-                           } */
-                       
-                           // Update L2 cache with mm_l2_data_block_returned
-                           update_l2_cache (l2_cache, mm_l2_data_block_returned, trace.physical_address);
-                           l2_l1_data_block_returned = search_L2_cache (l2_cache, trace.physical_address, NULL, READ_ACCESS);
-                       
-                           // Update L1 cache with l2_l1_data_block_returned
-                           update_L1_cache (l1_cache_access_ptr, l2_cache, l2_l1_data_block_returned, trace.physical_address);                       
-                       }
-                    
-                       // If search L2 cache returns some data - L2 cache hit - sends signal to main memory to call off the search
-                       else {
-                           // printf(" L2 cache hit!\n");
-                           proc_access_info[i].num_l2_cache_hits++;
-                           // proc_access_info[i].num_main_memory_hits--; or proc_access_info[i].num_main_memory_misses--; TODO: bug fix HOW TO RECTIFY? 
-                           update_L1_cache (l1_cache_access_ptr, l2_cache, l2_l1_data_block_returned, trace.physical_address);
-                       }
-                   }           
                }
         
                if (j == pcb_ptr[i].num_traces_context_sw) {
@@ -358,13 +175,17 @@ int main (int argc, char *argv[]) {
         
                    // Context Switch
                    // printf(" Context Switch! Flushing the TLB (retaining all shared entries)...\n\n");
-                   flush_L1_TLB (l1_tlb);
-                   flush_L2_TLB (l2_tlb);
+                   leave_TLB_address_space (ctx);
                }
            }            
        }
        
+       // The L2 stats of the round are needed for the page fault frequencies below - wait for the L2 worker threads and merge them
+       if (parallel_l2 != NULL)
+           merge_parallel_L2_stats (parallel_l2, proc_access_info);
+
        // If all processes TERMINATED break out of while loop
+       j = 0;
        for (i = 0; i < num_processes; i++) {
            if (pcb_ptr[i].process_state == TERMINATED)
                j++;
@@ -372,6 +193,15 @@ int main (int argc, char *argv[]) {
        
        if (j == num_processes)
            break;  
+
+       // Processes swapped out in the previous round are swapped back in - their pages fault in again as they are accessed
+       num_ready_processes = 0;
+       for (i = 0; i < num_processes; i++) {
+           if (pcb_ptr[i].process_state == WAITING)
+               pcb_ptr[i].process_state = READY;
+           if (pcb_ptr[i].process_state == READY)
+               num_ready_processes++;
+       }
            
        // THRASHING DETECTION
        page_fault_frequency = 0.0;
@@ -382,17 +212,23 @@ int main (int argc, char *argv[]) {
                 page_fault_frequency = page_fault_frequency + ((double)proc_access_info[i].num_main_memory_misses/(double)proc_access_info[i].num_main_memory_accesses);
        }
        
-       // Swapping out processes
-       while (page_fault_frequency > MAX_PAGE_FAULT_FREQUENCY) {
+       // Swapping out processes - at least one process is left READY, so that every round simulates some traces
+       while (page_fault_frequency > MAX_PAGE_FAULT_FREQUENCY && num_ready_processes > 1) {
            // printf(" Swap out processes (randomly) by changing their state to WAITING and invalidating all pages (swap out), till active (ready/running) processes PFFs summation is within the set bounds \n");
            i = rand () % num_processes;
+           if (pcb_ptr[i].process_state != READY)
+               continue;
            pcb_ptr[i].process_state = WAITING;
+           num_ready_processes--;
            page_fault_frequency = page_fault_frequency - ((double)proc_access_info[i].num_main_memory_misses/(double)proc_access_info[i].num_main_memory_accesses);
                            
            // Invalidate all of its pages  --- loop (4 times) starting from outermost structure
-           for (int k = 0; k < 4; k++)
-               invalidate_page(temp_pt->entry_table[k].pageframe.p_table_index); // ideally should be swapped into swap space - this code 
-                                                                                 // currently does not contain the required ADTs, functions to swap in / swap out pages
+           temp_pt = pcb_ptr[i].page_dir_base_addr;
+           for (int k = 0; k < 4; k++) {
+               if (temp_pt->entry_table[k].valid_bit == VALID)
+                   invalidate_page(ctx, temp_pt->entry_table[k].pageframe.p_table_index); // ideally should be swapped into swap space - this code 
+                                                                                     // currently does not contain the required ADTs, functions to swap in / swap out pages
+           }
        }
    } 
    
@@ -437,12 +273,17 @@ int main (int argc, char *argv[]) {
    // printf(" L2 Cache hit rate: %lf\n", L2_cache_hit_rate);
    // printf(" Average page fault frequency (rate): %lf\n", page_fault_frequency);
    
+   if (parallel_l2 != NULL)
+       stop_parallel_L2_cache(parallel_l2);
+   if (sweep != NULL)
+       finish_cache_sweep(sweep);
+   if (stack_distance != NULL) {
+       write_miss_ratio_curves(stack_distance, miss_ratio_curve_filename);
+       free_stack_distance_analyzer(stack_distance);
+   }
+
    // Free 
-   main_memory_free(mm_ptr);
-   free(l1_instr_cache);
-   free(l1_data_cache);
-   free(l1_tlb);
-   free(l2_tlb);
+   free_simulator_context(ctx);
    
    return 0;
 }
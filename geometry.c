@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "geometry.h"
+#include "tlb.h"
+#include "cache.h"
+#include "replacement.h"
+
+// Geometry descriptor files hold one "<key> <value>" pair per line, e.g.
+//     l1_cache_sets 32
+//     l2_cache_ways 8
+//     l2_cache_policy srrip
+// Keys left out keep their current (default) value, lines starting with # are comments. The keys are the names of the
+// configurable fields in the table below.
+
+typedef struct {
+    const char *key;
+    size_t offset;                             // Offset of the configured field within memory_geometry
+    int is_policy;                             // Set if the value is a replacement policy name (see replacement.h) rather than a number
+} geometry_key;
+
+static const geometry_key geometry_keys[] = {
+    { "l1_tlb_sets", offsetof (memory_geometry, l1_tlb.num_sets), 0 },
+    { "l1_tlb_ways", offsetof (memory_geometry, l1_tlb.num_ways), 0 },
+    { "l1_tlb_policy", offsetof (memory_geometry, l1_tlb.replacement_policy), 1 },
+    { "l2_tlb_sets", offsetof (memory_geometry, l2_tlb.num_sets), 0 },
+    { "l2_tlb_ways", offsetof (memory_geometry, l2_tlb.num_ways), 0 },
+    { "l2_tlb_policy", offsetof (memory_geometry, l2_tlb.replacement_policy), 1 },
+    { "tlb_asids", offsetof (memory_geometry, tlb_asids), 0 },
+    { "l1_cache_sets", offsetof (memory_geometry, l1_cache.num_sets), 0 },
+    { "l1_cache_ways", offsetof (memory_geometry, l1_cache.num_ways), 0 },
+    { "l1_cache_block_size", offsetof (memory_geometry, l1_cache.block_size), 0 },
+    { "l1_cache_halt_tag_bits", offsetof (memory_geometry, l1_cache_halt_tag_bits), 0 },
+    { "l1_cache_policy", offsetof (memory_geometry, l1_cache.replacement_policy), 1 },
+    { "l2_cache_sets", offsetof (memory_geometry, l2_cache.num_sets), 0 },
+    { "l2_cache_ways", offsetof (memory_geometry, l2_cache.num_ways), 0 },
+    { "l2_cache_block_size", offsetof (memory_geometry, l2_cache.block_size), 0 },
+    { "l2_cache_policy", offsetof (memory_geometry, l2_cache.replacement_policy), 1 }
+};
+
+#define NUM_GEOMETRY_KEYS (sizeof (geometry_keys) / sizeof (geometry_keys[0]))
+
+// Returns log_2(value), or -1 if value is not a power of 2.
+
+static int get_log2 (unsigned int value) {
+    if (value == 0 || (value & (value - 1)) != 0)
+        return -1;
+    return __builtin_ctz (value);
+}
+
+// Derives the shifts and masks of a level from its number of sets, ways and block size. address_bits is the width of the
+// addresses the level is indexed with (page numbers for TLBs, physical addresses for caches). Returns -1 if the geometry is invalid.
+
+static int derive_level_geometry (level_geometry *level, const char *name, unsigned int address_bits) {
+    int set_index_bits = get_log2 (level->num_sets);
+    int offset_bits = get_log2 (level->block_size);
+
+    if (set_index_bits < 0 || offset_bits < 0) {
+        fprintf(stderr, " ERROR: %s sets and block size must be powers of 2\n", name);
+        return -1;
+    }
+    if (level->num_ways == 0 || level->num_ways > MAX_GEOMETRY_WAYS) {
+        fprintf(stderr, " ERROR: %s must have 1 to %d ways\n", name, MAX_GEOMETRY_WAYS);
+        return -1;
+    }
+#ifdef REPLACEMENT_POLICY
+    // Policy fixed at compile time (see replacement.h) - the configured one is ignored
+    level->replacement_policy = REPLACEMENT_POLICY;
+#endif
+    if (level->replacement_policy >= NUM_REPLACEMENT_POLICIES) {
+        fprintf(stderr, " ERROR: %s has an unknown replacement policy\n", name);
+        return -1;
+    }
+    if (level->replacement_policy == REPLACEMENT_TREE_PLRU && get_log2 (level->num_ways) < 0) {
+        fprintf(stderr, " ERROR: %s tree PLRU replacement needs a power of 2 ways\n", name);
+        return -1;
+    }
+    if ((unsigned int) (set_index_bits + offset_bits) >= address_bits) {
+        fprintf(stderr, " ERROR: %s sets and block size leave no tag bits\n", name);
+        return -1;
+    }
+
+    level->set_index_bits = set_index_bits;
+    level->offset_bits = offset_bits;
+    level->tag_bits = address_bits - set_index_bits - offset_bits;
+    level->set_index_mask = level->num_sets - 1;
+    level->offset_mask = level->block_size - 1;
+    level->way_mask = (level->num_ways == 32) ? 0xFFFFFFFFu : ((1u << level->num_ways) - 1);
+    return 0;
+}
+
+// Derives the shifts and masks of all levels and checks the constraints between them.
+
+static int derive_memory_geometry (memory_geometry *geometry) {
+    if (derive_level_geometry (&geometry->l1_tlb, "L1 TLB", VIRTUAL_PAGE_NUMBER_BITS) < 0 ||
+        derive_level_geometry (&geometry->l2_tlb, "L2 TLB", VIRTUAL_PAGE_NUMBER_BITS) < 0 ||
+        derive_level_geometry (&geometry->l1_cache, "L1 cache", PHYSICAL_ADDRESS_BITS) < 0 ||
+        derive_level_geometry (&geometry->l2_cache, "L2 cache", PHYSICAL_ADDRESS_BITS) < 0)
+        return -1;
+
+    // TLB entries hold one page number each
+    if (geometry->l1_tlb.block_size != 1 || geometry->l2_tlb.block_size != 1) {
+        fprintf(stderr, " ERROR: TLB block size must be 1\n");
+        return -1;
+    }
+
+    // L2 returns L1-sized blocks out of its own blocks, main memory returns L2-sized blocks out of a frame
+    if (geometry->l1_cache.block_size > geometry->l2_cache.block_size || geometry->l2_cache.block_size > PAGE_SIZE) {
+        fprintf(stderr, " ERROR: Block sizes must satisfy L1 <= L2 <= %d\n", PAGE_SIZE);
+        return -1;
+    }
+
+    if (geometry->l1_cache_halt_tag_bits == 0 || geometry->l1_cache_halt_tag_bits > MAX_L1_CACHE_HALT_TAG_BITS ||
+        geometry->l1_cache_halt_tag_bits >= geometry->l1_cache.tag_bits) {
+        fprintf(stderr, " ERROR: L1 cache halt tag must have 1 to %d bits and leave main tag bits\n", MAX_L1_CACHE_HALT_TAG_BITS);
+        return -1;
+    }
+
+    if (geometry->tlb_asids > 1) {
+        fprintf(stderr, " ERROR: tlb_asids must be 0 (flush the TLBs at context switches) or 1 (ASID-tagged TLB entries)\n");
+        return -1;
+    }
+
+    if (geometry->l2_cache.tag_bits > MAX_L2_CACHE_TAG_BITS) {
+        fprintf(stderr, " ERROR: L2 cache tag has %u bits, at most %d fit the tag store - use more sets or larger blocks\n", geometry->l2_cache.tag_bits, MAX_L2_CACHE_TAG_BITS);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Fills in the compiled-in default geometry.
+
+void set_default_memory_geometry (memory_geometry *geometry) {
+    memset (geometry, 0, sizeof (memory_geometry));
+
+    geometry->l1_tlb.num_sets = NUM_L1_TLB_SETS;
+    geometry->l1_tlb.num_ways = NUM_L1_TLB_WAYS;
+    geometry->l1_tlb.block_size = 1;
+    geometry->l1_tlb.replacement_policy = L1_TLB_REPLACEMENT_POLICY;
+
+    geometry->l2_tlb.num_sets = NUM_L2_TLB_SETS;
+    geometry->l2_tlb.num_ways = NUM_L2_TLB_WAYS;
+    geometry->l2_tlb.block_size = 1;
+    geometry->l2_tlb.replacement_policy = L2_TLB_REPLACEMENT_POLICY;
+    geometry->tlb_asids = TLB_ASIDS;
+
+    geometry->l1_cache.num_sets = NUM_L1_CACHE_SETS;
+    geometry->l1_cache.num_ways = NUM_L1_CACHE_WAYS;
+    geometry->l1_cache.block_size = NUM_L1_CACHE_BLOCK_SIZE;
+    geometry->l1_cache_halt_tag_bits = NUM_L1_CACHE_HALT_TAG_BITS;
+    geometry->l1_cache.replacement_policy = L1_CACHE_REPLACEMENT_POLICY;
+
+    geometry->l2_cache.num_sets = NUM_L2_CACHE_SETS;
+    geometry->l2_cache.num_ways = NUM_L2_CACHE_WAYS;
+    geometry->l2_cache.block_size = NUM_L2_CACHE_BLOCK_SIZE;
+    geometry->l2_cache.replacement_policy = L2_CACHE_REPLACEMENT_POLICY;
+
+    derive_memory_geometry (geometry);
+}
+
+// Sets the configured field named by key to the given value (a number, or a policy name for policy keys).
+// Returns -1 if there is no such key, -2 if the value is not valid for the key.
+
+static int set_memory_geometry_key (memory_geometry *geometry, const char *key, const char *value) {
+    unsigned int number = 0;
+    int policy = 0;
+    char *end;
+    size_t i = 0;
+
+    for (i = 0; i < NUM_GEOMETRY_KEYS; i++) {
+        if (strcmp (key, geometry_keys[i].key) == 0) {
+            if (geometry_keys[i].is_policy) {
+                policy = get_replacement_policy (value);
+                if (policy < 0)
+                    return -2;
+                number = (unsigned int) policy;
+            }
+            else {
+                number = (unsigned int) strtoul (value, &end, 10);
+                if (end == value || *end != '\0')
+                    return -2;
+            }
+            *(unsigned int *) ((char *) geometry + geometry_keys[i].offset) = number;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Prints the error of a failed set_memory_geometry_key call - location is the "<file>:<line>: " prefix of the setting (empty if none).
+
+static void print_geometry_key_error (const char *location, int error, const char *key, const char *value) {
+    if (error == -1)
+        fprintf(stderr, " ERROR: %sunknown geometry key %s\n", location, key);
+    else
+        fprintf(stderr, " ERROR: %sinvalid value %s for geometry key %s\n", location, value, key);
+}
+
+// Reads a geometry descriptor file on top of the given geometry and derives the shifts and masks of all levels.
+// On error the geometry is left partly updated and -1 is returned.
+
+int load_memory_geometry (const char *filename, memory_geometry *geometry) {
+    FILE *fptr;
+    char line[256];
+    char key[64];
+    char value[64];
+    char location[300];
+    int line_number = 0;
+    int error = 0;
+
+    fptr = fopen (filename, "r");
+    if (fptr == NULL) {
+        fprintf(stderr, " ERROR: Could not open the geometry file %s\n", filename);
+        return -1;
+    }
+
+    while (fgets (line, sizeof (line), fptr) != NULL) {
+        line_number++;
+
+        // Skip blank lines and comments
+        if (sscanf (line, " %63s", key) != 1 || key[0] == '#')
+            continue;
+
+        if (sscanf (line, " %63s %63s", key, value) != 2) {
+            fprintf(stderr, " ERROR: %s:%d: expected \"<key> <value>\"\n", filename, line_number);
+            fclose (fptr);
+            return -1;
+        }
+
+        error = set_memory_geometry_key (geometry, key, value);
+        if (error < 0) {
+            snprintf (location, sizeof (location), "%s:%d: ", filename, line_number);
+            print_geometry_key_error (location, error, key, value);
+            fclose (fptr);
+            return -1;
+        }
+    }
+
+    fclose (fptr);
+    return derive_memory_geometry (geometry);
+}
+
+// Applies the "<key> <value>" pairs of a single line (e.g. "l1_cache_ways 8 l2_cache_sets 64") on top of the given geometry
+// and derives the shifts and masks of all levels. Returns -1 on error.
+
+int apply_memory_geometry_settings (const char *settings, memory_geometry *geometry) {
+    char key[64];
+    char value[64];
+    int length = 0;
+    int error = 0;
+
+    while (sscanf (settings, " %63s%n", key, &length) == 1) {
+        if (sscanf (settings, " %63s %63s%n", key, value, &length) != 2) {
+            fprintf(stderr, " ERROR: expected \"<key> <value>\" pairs in \"%s\"\n", settings);
+            return -1;
+        }
+        error = set_memory_geometry_key (geometry, key, value);
+        if (error < 0) {
+            print_geometry_key_error ("", error, key, value);
+            return -1;
+        }
+        settings += length;
+    }
+
+    return derive_memory_geometry (geometry);
+}
+
+// Prints the geometry of a single level.
+
+static void print_level_geometry (const char *name, const level_geometry *level) {
+    printf(" %-9s %5u sets x %2u ways x %3u B blocks, %-6s replacement (tag bits: %u, set index bits: %u, offset bits: %u)\n", name,
+           level->num_sets, level->num_ways, level->block_size, get_replacement_policy_name (level->replacement_policy),
+           level->tag_bits, level->set_index_bits, level->offset_bits);
+}
+
+void print_memory_geometry (const memory_geometry *geometry) {
+    print_level_geometry ("L1 TLB", &geometry->l1_tlb);
+    print_level_geometry ("L2 TLB", &geometry->l2_tlb);
+    printf(" TLB context switches: %s\n", geometry->tlb_asids ? "entries tagged with address space IDs" : "flushed (shared entries kept)");
+    print_level_geometry ("L1 cache", &geometry->l1_cache);
+    print_level_geometry ("L2 cache", &geometry->l2_cache);
+}
@@ -0,0 +1,58 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+// GEOMETRY MACROS
+
+// Address widths the geometries are checked against
+#define VIRTUAL_PAGE_NUMBER_BITS 23            // 32-bit virtual address, 9-bit offset - 512B page
+#define PHYSICAL_ADDRESS_BITS 25               // 16-bit frame number, 9-bit offset - 512B page
+#define PAGE_SIZE 512
+
+// Limits of the runtime geometries
+#define MAX_GEOMETRY_WAYS 32                   // Per-set way bit masks (valid, shared, write, halted ways) are 32 bits wide
+#define MAX_L2_CACHE_TAG_BITS 15               // L2 tag + valid bit are packed into 16-bit tag store entries
+#define MAX_L1_CACHE_HALT_TAG_BITS 8           // Halt tag presence bitmaps are kept for every possible halt tag
+
+// GEOMETRY ADT DEFINITIONS
+
+// Geometry of one TLB / cache level. Only the number of sets, ways, the block size and the replacement policy are configured, the shifts
+// and masks used to split addresses are derived from them once when the geometry is loaded (all sizes are powers of 2).
+typedef struct {
+    unsigned int num_sets;
+    unsigned int num_ways;
+    unsigned int block_size;                   // Bytes per block (caches) - 1 for TLBs, which hold one page number per entry
+    unsigned int replacement_policy;           // REPLACEMENT_* (see replacement.h)
+    unsigned int set_index_bits;               // log_2(num_sets)
+    unsigned int offset_bits;                  // log_2(block_size)
+    unsigned int tag_bits;                     // Address bits left for the tag
+    unsigned int set_index_mask;               // num_sets - 1
+    unsigned int offset_mask;                  // block_size - 1
+    unsigned int way_mask;                     // Bit mask with one bit set per way
+} level_geometry;
+
+// Geometry of the whole memory subsystem
+typedef struct {
+    level_geometry l1_tlb;
+    level_geometry l2_tlb;
+    level_geometry l1_cache;                   // Instruction and data L1 caches share a geometry
+    level_geometry l2_cache;
+    unsigned int l1_cache_halt_tag_bits;       // Low-order L1 tag bits kept in the halt tag arrays
+    unsigned int tlb_asids;                    // 1 - TLB entries tagged with address space IDs and kept across context switches, 0 - flushed
+} memory_geometry;
+
+// FUNCTION DECLARATIONS
+
+// Fills in the compiled-in default geometry (the NUM_* macros of tlb.h and cache.h)
+void set_default_memory_geometry (memory_geometry *geometry);
+
+// Reads a geometry descriptor file ("<key> <value>" per line, # comments) on top of the given geometry - returns 0 on success, -1 on error.
+// Policy keys take a policy name as value (e.g. "l2_cache_policy srrip"), all other keys a number
+int load_memory_geometry (const char *filename, memory_geometry *geometry);
+
+// Applies the "<key> <value>" pairs of a single line on top of the given geometry - returns 0 on success, -1 on error
+int apply_memory_geometry_settings (const char *settings, memory_geometry *geometry);
+
+// Prints the geometry of all levels
+void print_memory_geometry (const memory_geometry *geometry);
+
+#endif
@@ -2,340 +2,355 @@
 #include <stdlib.h>
 #include "cache.h"
 
-double av_num_ways_halted = 0.0;
+// Initializes the L1 instruction and data cache structures with the L1 cache geometry.  
 
-// Initializes the L1 instruction and data cache structures.  
-
-L1_cache* initialize_L1_cache (int cache_type) {
-    int i = 0;
-    int j = 0;
+L1_cache* initialize_L1_cache (int cache_type, const memory_geometry *geometry) {
+    unsigned int num_sets = geometry->l1_cache.num_sets;
+    unsigned int num_ways = geometry->l1_cache.num_ways;
+    unsigned int i = 0;
+    unsigned int j = 0;
 
     // Create an empty L1 cache structure
     L1_cache *l1_cache;
     l1_cache = (L1_cache *) malloc (sizeof (L1_cache));
     
+    l1_cache->geometry = geometry->l1_cache;
+    l1_cache->halt_tag_bits = geometry->l1_cache_halt_tag_bits;
+    l1_cache->l1_cache_entries = (L1_cache_entry *) malloc (num_sets * num_ways * sizeof (L1_cache_entry));
+#ifndef TAG_ONLY_SIMULATION
+    l1_cache->data_blocks = (data_byte *) calloc ((size_t) num_sets * num_ways * geometry->l1_cache.block_size, sizeof (data_byte));
+#endif
+    initialize_replacement_state (&l1_cache->replacement, &geometry->l1_cache);
+    
     // Initializing all the entries
-    for (i = 0; i < NUM_L1_CACHE_SETS; i++) {
-        for (j = 0; j < NUM_L1_CACHE_WAYS; j++) {
+    for (i = 0; i < num_sets; i++) {
+        for (j = 0; j < num_ways; j++) {
         
             // Initialize the valid bit as INVALID and dirty bit as CLEAN 
-            l1_cache->l1_cache_sets[i].l1_cache_entry[j].valid_bit = INVALID;       
-            l1_cache->l1_cache_sets[i].l1_cache_entry[j].dirty_bit = CLEAN;
+            L1_CACHE_ENTRY (l1_cache, i, j)->main_tag_bits = 0;
+            L1_CACHE_ENTRY (l1_cache, i, j)->valid_bit = INVALID;       
+            L1_CACHE_ENTRY (l1_cache, i, j)->dirty_bit = CLEAN;
             
             // Depending on the cache type given, initialize write bit values
             if (cache_type == INSTRUCTION)
-                l1_cache->l1_cache_sets[i].l1_cache_entry[j].write_bit = READ_ONLY;    // L1 INSTUCTION cache is READ ONLY 
+                L1_CACHE_ENTRY (l1_cache, i, j)->write_bit = READ_ONLY;    // L1 INSTUCTION cache is READ ONLY 
             else 
-                l1_cache->l1_cache_sets[i].l1_cache_entry[j].write_bit = READ_WRITE;   // L1 DATA cache can be READ as well as WRITE   
-            
-            // Initializing all LRU counter values to 0
-            l1_cache->l1_cache_sets[i].lru_counter[j] = 0;
+                L1_CACHE_ENTRY (l1_cache, i, j)->write_bit = READ_WRITE;   // L1 DATA cache can be READ as well as WRITE   
         }    
     }
     
     // Marking last set entry in each way as READ_ONLY (Write protected)
     if (cache_type == DATA) {
-        for (j = 0; j < NUM_L1_CACHE_WAYS; j++)
-            l1_cache->l1_cache_sets[NUM_L1_CACHE_SETS - 1].l1_cache_entry[j].write_bit = READ_ONLY;
+        for (j = 0; j < num_ways; j++)
+            L1_CACHE_ENTRY (l1_cache, num_sets - 1, j)->write_bit = READ_ONLY;
     }
     
     // Initializing all entries of L1 Cache Halt Tag Array (corresponding to each way) to 0
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
-        for (j = 0; j < NUM_L1_CACHE_SETS; j++)
-            l1_cache->halt_tag_array[i].halt_tags_per_way[j] = 0;
-    }
+    l1_cache->halt_tag_array = (unsigned int *) calloc (num_ways * num_sets, sizeof (unsigned int));
+    
+    // No VALID entries yet - no halt tag is present in any way, all ways start HALTED
+    l1_cache->halt_tag_presence_words = (num_sets + 63) / 64;
+    l1_cache->halt_tag_presence = (unsigned long long *) calloc ((1u << l1_cache->halt_tag_bits) * num_ways * l1_cache->halt_tag_presence_words, sizeof (unsigned long long));
+    l1_cache->halted_ways_mask = l1_cache->geometry.way_mask;
+    l1_cache->av_num_ways_halted = 0.0;
             
     return l1_cache;    // Return pointer to the initialized cache structure
 }
 
+// Frees the L1 cache structure.
+
+void free_L1_cache (L1_cache* l1_cache) {
+    free (l1_cache->l1_cache_entries);
+#ifndef TAG_ONLY_SIMULATION
+    free (l1_cache->data_blocks);
+#endif
+    free_replacement_state (&l1_cache->replacement);
+    free (l1_cache->halt_tag_array);
+    free (l1_cache->halt_tag_presence);
+    free (l1_cache);
+}
+
 // Search the L1 cache for data entry corresponding to the given physical address. 
 // If found, perform a read or write operation depeding on the type of access.
 
 unsigned int search_L1_cache (L1_cache* l1_cache, unsigned int physical_address, unsigned int write_data, int access_type) {
     unsigned int tag = 0;         // L1 cache tag bits
     unsigned int set_index = 0;   // L1 cache set index bits
-    unsigned int offset = 0;      // L1 cache byte offset bits
+#ifndef TAG_ONLY_SIMULATION
+    unsigned int offset = 0;      // L1 cache byte offset bits (only needed to address the simulated data)
+#endif
     
     // Extracting the tag, offset and index bits from the physical address
-    offset = physical_address % NUM_L1_CACHE_BLOCK_SIZE;
-    set_index = (physical_address >> NUM_L1_CACHE_OFFSET_BITS) % NUM_L1_CACHE_SETS;
-    tag = physical_address >> (NUM_L1_CACHE_SET_INDEX_BITS + NUM_L1_CACHE_OFFSET_BITS);  
+#ifndef TAG_ONLY_SIMULATION
+    offset = physical_address & l1_cache->geometry.offset_mask;
+#endif
+    set_index = (physical_address >> l1_cache->geometry.offset_bits) & l1_cache->geometry.set_index_mask;
+    tag = physical_address >> (l1_cache->geometry.set_index_bits + l1_cache->geometry.offset_bits);  
     
     // L1 cache is Way-halting - so the tag field is further divided into Main tag and Halt tag 
-    unsigned int halt_tag = 0;    // Low-order 4 bits give the halt tag
-    unsigned int main_tag = 0;    // Remaining 11 tag bits (tag bits - 4 halt tag bits) give the main tag 
+    unsigned int halt_tag = 0;    // Low-order halt tag bits give the halt tag (4 bits by default)
+    unsigned int main_tag = 0;    // Remaining tag bits (tag bits - halt tag bits) give the main tag 
 
     // Extracting the main tag and halt tag entries from the tag field
-    main_tag = tag >> NUM_L1_CACHE_HALT_TAG_BITS;
-    halt_tag = tag % (1 << NUM_L1_CACHE_HALT_TAG_BITS);
+    main_tag = tag >> l1_cache->halt_tag_bits;
+    halt_tag = tag & ((1u << l1_cache->halt_tag_bits) - 1);
     
     // While the decoder decodes the set index bits, the halt tag array is simultaneously searched for the 
     // halt tag entry corresponding to the given physical address. HALT the ways corresponding to halt tag 
     // arrays resulting in 0 hits
-    L1_cache_way_halting_function (l1_cache, halt_tag);
+    L1_cache_way_halting_function (l1_cache, set_index, halt_tag);
 
     unsigned int data;
-    int num_halted_ways = NUM_L1_CACHE_WAYS;
-    int i = 0;
+    unsigned int num_ways = l1_cache->geometry.num_ways;
+    unsigned int num_halted_ways = __builtin_popcount (l1_cache->halted_ways_mask);
+    unsigned int i = 0;
+    L1_cache_entry *entry;
 
     // Searching the L1 cache
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
+    for (i = 0; i < num_ways; i++) {
 
-        // Check halt tag entries corresponding to the ACTIVE ways' decoded set index - if entry matches proceed to compare main tags 
-        if (l1_cache->way_status[i] == ACTIVE) {
-            num_halted_ways--; 
-        
-            if (l1_cache->halt_tag_array[i].halt_tags_per_way [set_index] == halt_tag) {
-        
-                // If the entry is VALID and the tag value matches the main tag bits -- entry found!        
-                if (l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].valid_bit == VALID && l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].main_tag_bits == main_tag) {
-                    
-                    // For READ access
-                    if (access_type == READ_ACCESS) {
+        // Only the ACTIVE ways are accessed - their entry at the decoded set index is VALID and its halt tag matches, proceed to compare main tags 
+        if (((l1_cache->halted_ways_mask >> i) & 1) == ACTIVE) {
+            entry = L1_CACHE_ENTRY (l1_cache, set_index, i);
+
+            // If the entry is VALID and the tag value matches the main tag bits -- entry found!        
+            if (entry->valid_bit == VALID && entry->main_tag_bits == main_tag) {
+                
+                // For READ access
+                if (access_type == READ_ACCESS) {
  
-                        // Read 1 byte of data from L1 cache datablock (location in datablock given by offset)
-                        data = l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].data_blocks[offset].data;     
+                    // Read 1 byte of data from L1 cache datablock (location in datablock given by offset)
+#ifndef TAG_ONLY_SIMULATION
+                    data = L1_CACHE_DATA_BLOCK (l1_cache, set_index, i)[offset].data;     
+#else
+                    data = 0;    // No data simulated - any value below 256 signals a hit
+#endif
  
-                        // Update LRU counter corresponding to this set index
-                        update_L1_LRU_counter(l1_cache, set_index, i);    
-    
-                        return data;
-                    }
-                                
-                    // For WRITE access - when WRITE permission is available
-                    else if (access_type == WRITE_ACCESS && l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].write_bit == READ_WRITE) {
-                    
-                        // Write 1 byte of data into L1 cache datablock (location in datablock given by offset)
-                        l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].data_blocks[offset].data = write_data;
-                    
-                        // Set the dirty bit to indicate that the data is modified in L1 cache (write-back policy)
-                        l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].dirty_bit = DIRTY;
-                    
-                        // Update LRU counter corresponding to this set index
-                        update_L1_LRU_counter(l1_cache, set_index, i);
-                        
-                        return L1_CACHE_WRITE_SUCCESSFUL; 
-                    }
+                    // Update the replacement state corresponding to this set index
+                    replacement_on_hit (&l1_cache->replacement, set_index, i);
+
+                    return data;
+                }
+                            
+                // For WRITE access - when WRITE permission is available
+                else if (access_type == WRITE_ACCESS && entry->write_bit == READ_WRITE) {
                 
-                    // For WRITE access - when WRITE permission is denied --- The write access results in a WRITE PROTECTION EXCEPTION
-                    else if (access_type == WRITE_ACCESS && l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].write_bit == READ_ONLY) {
-                        return L1_CACHE_WRITE_PROTECTION_EXCEPTION;
-                    }
+                    // Write 1 byte of data into L1 cache datablock (location in datablock given by offset)
+#ifndef TAG_ONLY_SIMULATION
+                    L1_CACHE_DATA_BLOCK (l1_cache, set_index, i)[offset].data = write_data;
+#endif
+                
+                    // Set the dirty bit to indicate that the data is modified in L1 cache (write-back policy)
+                    entry->dirty_bit = DIRTY;
+                
+                    // Update the replacement state corresponding to this set index
+                    replacement_on_hit (&l1_cache->replacement, set_index, i);
+                    
+                    return L1_CACHE_WRITE_SUCCESSFUL; 
+                }
+            
+                // For WRITE access - when WRITE permission is denied --- The write access results in a WRITE PROTECTION EXCEPTION
+                else if (access_type == WRITE_ACCESS && entry->write_bit == READ_ONLY) {
+                    return L1_CACHE_WRITE_PROTECTION_EXCEPTION;
                 }
             }
         }
     }
     
-    av_num_ways_halted = av_num_ways_halted + ((double)num_halted_ways/4.0);
+    l1_cache->av_num_ways_halted = l1_cache->av_num_ways_halted + ((double)num_halted_ways/(double)num_ways);
     
     // MISS!
-    if (num_halted_ways == NUM_L1_CACHE_WAYS)
+    if (num_halted_ways == num_ways)
         return L1_CACHE_MISS_PREDETERMINED;
     else
         return L1_CACHE_MISS;    // Search L2 and main memory (L1 - look-through and L2 - look-aside), update L1
 }
 
-// Performs the way-halting function for L1 cache by searching all the halt tag arrays for the halt tag corresponding to the given physical address 
-// (in PARALLEL with set index decoding). If no match is found, the corresponding way is a predetermined MISS. So, it HALTs the corresponding way to 
-// prevent unnecessary access, thereby saving energy.
+// Performs the way-halting function for L1 cache by looking up the halt tag corresponding to the given physical address in the halt tag presence bitmaps
+// (in PARALLEL with set index decoding). If the entry of the decoded set in a way does not hold the halt tag, the way is a predetermined MISS. So, it HALTs
+// the corresponding way to prevent unnecessary access, thereby saving energy. The presence bitmaps are kept up to date by update_L1_cache, so this is
+// one bitmap load and AND per way instead of comparing the halt tag array entries of every set.
 
-void L1_cache_way_halting_function (L1_cache* l1_cache, unsigned int halt_tag) {
-    int halt_tag_comparator[NUM_L1_CACHE_SETS];    // halt tag array comparator output bits
-    int i = 0;
-    int j = 0;
+void L1_cache_way_halting_function (L1_cache* l1_cache, unsigned int set_index, unsigned int halt_tag) {
+    unsigned int num_ways = l1_cache->geometry.num_ways;
+    unsigned int words = l1_cache->halt_tag_presence_words;
+    const unsigned long long *presence = l1_cache->halt_tag_presence + (halt_tag * num_ways) * words + set_index / 64;
+    unsigned long long set_bit = 1ULL << (set_index % 64);
+    unsigned int halted_ways_mask = 0;
+    unsigned int i = 0;
 
-    // For halt tag array corresponding to each way
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
-    
-        // Search in PARALLEL the halt tag entries corresponding to each set 
-        for (j = 0; j < NUM_L1_CACHE_SETS; j++) {
-        
-            // If the j-th entry matches the halt tag from physical address 
-            // j-th bit of comparator output array is set to 1, else 0
-            if (l1_cache->halt_tag_array[i].halt_tags_per_way[j] == halt_tag)
-                halt_tag_comparator[j] = 1;
-            else
-                halt_tag_comparator[j] = 0;
-        }
-    }
-   
-    // Check if any of the halt tag entries in the way halt tag arrays matches the last four bits of the tag field 
-    // (Actually implemented by ORing all comparator outputs to determine if output corresponding to at least one of 
-    // the sets are HIGH i.e set to 1)
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
-    
-        // Check all entries in a given halt tag array
-        for (j = 0; j < NUM_L1_CACHE_SETS; j++) {
-            if (halt_tag_comparator[j] == 1)
-                break;
-        }
-        
-        // If no halt tag entries for a way match (i.e. OR of all comparator outputs is 0) --> predetermined MISS! 
-        // So, the corresponding WAY is HALTED to prevent unnecessary access and save energy
-        if (j == NUM_L1_CACHE_SETS)
-            l1_cache->way_status[i] = HALTED;    
-        else
-            l1_cache->way_status[i] = ACTIVE; 
+    // If no VALID entry of the decoded set in way i has the halt tag (presence bit is 0) --> predetermined MISS! The way is HALTED
+    for (i = 0; i < num_ways; i++) {
+        if ((presence[i * words] & set_bit) == 0)
+            halted_ways_mask |= 1u << i;
     }
+
+    l1_cache->halted_ways_mask = halted_ways_mask;
+}
+
+// Records in the halt tag presence bitmaps that the entry of the given set in the given way now holds new_halt_tag
+// (replacing old_halt_tag if the entry was VALID before).
+
+static void update_L1_halt_tag_presence (L1_cache* l1_cache, unsigned int set_index, int way_index, int was_valid, unsigned int old_halt_tag, unsigned int new_halt_tag) {
+    unsigned int num_ways = l1_cache->geometry.num_ways;
+    unsigned int words = l1_cache->halt_tag_presence_words;
+    unsigned long long set_bit = 1ULL << (set_index % 64);
+
+    if (was_valid == VALID)
+        l1_cache->halt_tag_presence[(old_halt_tag * num_ways + way_index) * words + set_index / 64] &= ~set_bit;
+    l1_cache->halt_tag_presence[(new_halt_tag * num_ways + way_index) * words + set_index / 64] |= set_bit;
 }
 
 // Updates the L1 cache with the datablock fetched from the next level i.e. L2 cache and main memory (look-aside). 
 // Depending on the availability of free slots an entry is PLACED/REPLACED in the L1 cache. 
 // If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there. 
-// Else, REPLACE any of the way entries with required set index using LRU REPLACEMENT. 
+// Else, REPLACE the way entry chosen by the L1 cache replacement policy (LRU REPLACEMENT by default). 
+// A dirty REPLACED block is written back to the given L2 cache. Without one (parallel L2 back end) its address is stored in
+// *write_back_address for the caller to forward - returns 1 in that case, 0 otherwise.
 
-void update_L1_cache (L1_cache* l1_cache, L2_cache* l2_cache, data_byte* fetched_data, unsigned int physical_address) {
+int update_L1_cache (L1_cache* l1_cache, L2_cache* l2_cache, data_byte* fetched_data, unsigned int physical_address, unsigned int *write_back_address) {
     unsigned int tag = 0;         // L1 cache tag bits
     unsigned int set_index = 0;   // L1 cache set index bits
-    unsigned int offset = 0;      // L1 cache byte offset bits
     
-    // Extracting the tag, offset and index bits from the physical address
-    offset = physical_address % NUM_L1_CACHE_BLOCK_SIZE;
-    set_index = (physical_address >> NUM_L1_CACHE_OFFSET_BITS) % NUM_L1_CACHE_SETS;
-    tag = physical_address >> (NUM_L1_CACHE_SET_INDEX_BITS + NUM_L1_CACHE_OFFSET_BITS);  
+    // Extracting the tag and index bits from the physical address
+    set_index = (physical_address >> l1_cache->geometry.offset_bits) & l1_cache->geometry.set_index_mask;
+    tag = physical_address >> (l1_cache->geometry.set_index_bits + l1_cache->geometry.offset_bits);  
     
-    unsigned int halt_tag = 0;    // Low-order 4 bits give the halt tag
-    unsigned int main_tag = 0;    // Remaining 11 tag bits (tag bits - 4 halt tag bits) give the main tag 
+    unsigned int halt_tag = 0;    // Low-order halt tag bits give the halt tag
+    unsigned int main_tag = 0;    // Remaining tag bits (tag bits - halt tag bits) give the main tag 
     
     // Extracting the main tag and halt tag entries from the tag field
-    main_tag = tag >> NUM_L1_CACHE_HALT_TAG_BITS;
-    halt_tag = tag % (1 << NUM_L1_CACHE_HALT_TAG_BITS); // to extract the low-order halt tag bits from tag 
+    main_tag = tag >> l1_cache->halt_tag_bits;
+    halt_tag = tag & ((1u << l1_cache->halt_tag_bits) - 1); // to extract the low-order halt tag bits from tag 
 
-    int LRU_way = 0;              // way index corresponding to least recently used entry in the set
+    unsigned int num_ways = l1_cache->geometry.num_ways;
+    int victim_way = 0;           // way index of the entry chosen by the replacement policy (least recently used entry with LRU)
+    L1_cache_entry *entry;
     
     // In case a dirty block from L1 cache needs to be REPLACED. The data from this block must be written back to L2 cache
-    unsigned int write_back_address = 0;    
+    unsigned int dirty_block_address = 0;    
+    int write_back_pending = 0;
 
-    int i = 0;
-    int j = 0;
+    unsigned int i = 0;
+#ifndef TAG_ONLY_SIMULATION
+    unsigned int block_size = l1_cache->geometry.block_size;
+    unsigned int j = 0;
+#endif
 
     // PLACEMENT: If there are INVALID entries in L1 cache corresponding to the given set index, PLACE this entry in the first INVALID entry's slot    
     
     // Looking for the first INVALID entry for given set index in L1 cache
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
+    for (i = 0; i < num_ways; i++) {
+        entry = L1_CACHE_ENTRY (l1_cache, set_index, i);
        
-        if (l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].valid_bit == INVALID) {
+        if (entry->valid_bit == INVALID) {
             
             // L1 cache data block updation
-            for (j = 0; j < NUM_L1_CACHE_BLOCK_SIZE; j++)
-                l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].data_blocks[j].data = fetched_data[j].data;
+#ifndef TAG_ONLY_SIMULATION
+            for (j = 0; j < block_size; j++)
+                L1_CACHE_DATA_BLOCK (l1_cache, set_index, i)[j].data = fetched_data[j].data;
+#endif
+            
+            // L1 halt tag presence updation (entry was INVALID)
+            update_L1_halt_tag_presence (l1_cache, set_index, i, INVALID, 0, halt_tag);
             
             // L1 cache entry updation
-            l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].main_tag_bits = main_tag;  
-            l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].valid_bit = VALID;
-            l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].dirty_bit = CLEAN;
+            entry->main_tag_bits = main_tag;  
+            entry->valid_bit = VALID;
+            entry->dirty_bit = CLEAN;
             
             // L1 tag halt tag array entry updation
-            l1_cache->halt_tag_array[i].halt_tags_per_way[set_index] = halt_tag;
+            L1_CACHE_HALT_TAG (l1_cache, set_index, i) = halt_tag;
             
+            replacement_on_fill (&l1_cache->replacement, set_index, i);
             break;
         }        
     }
     
-    // REPLACEMENT: If all entries corresponding to the given set index are VALID, check the LRU counter and replace entry corresponding to LRU way
+    // REPLACEMENT: If all entries corresponding to the given set index are VALID, replace the entry chosen by the replacement policy
+    if (i == num_ways) {
     
-    // Instantiate data block to copy replaced data to L2 (in case it is MODIFIED i.e. dirty bit is set)
-    data_byte write_back_data [NUM_L1_CACHE_BLOCK_SIZE];
-    
-    if (i == NUM_L1_CACHE_WAYS) {
-    
-        // Check LRU counter to get the LRU way entry index
-        LRU_way = get_L1_LRU_way_entry (l1_cache, set_index);
+        // Get the way entry index to be replaced from the replacement state
+        victim_way = replacement_choose_victim (&l1_cache->replacement, set_index);
+        entry = L1_CACHE_ENTRY (l1_cache, set_index, victim_way);
         
         // Check the dirty bit of selected block - if it is set, initiate write back to L2
-        if (l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].dirty_bit == DIRTY) {
+        if (entry->dirty_bit == DIRTY) {
             
             // Get the physical address of the dirty block to be written back to L2  
-            write_back_address = (l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].main_tag_bits << (NUM_L1_CACHE_HALT_TAG_BITS + NUM_L1_CACHE_SET_INDEX_BITS + NUM_L1_CACHE_OFFSET_BITS)) |
-                                 (l1_cache->halt_tag_array[LRU_way].halt_tags_per_way[set_index] << (NUM_L1_CACHE_SET_INDEX_BITS + NUM_L1_CACHE_OFFSET_BITS)) | 
-                                 (set_index << NUM_L1_CACHE_OFFSET_BITS); 
+            dirty_block_address = (entry->main_tag_bits << (l1_cache->halt_tag_bits + l1_cache->geometry.set_index_bits + l1_cache->geometry.offset_bits)) |
+                                  (L1_CACHE_HALT_TAG (l1_cache, set_index, victim_way) << (l1_cache->geometry.set_index_bits + l1_cache->geometry.offset_bits)) | 
+                                  (set_index << l1_cache->geometry.offset_bits); 
             
-            for (int ii =0; ii < NUM_L1_CACHE_BLOCK_SIZE; ii++)
-                write_back_data[ii].data = l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].data_blocks[ii].data;
-            
-            // Write the dirty block in L1 back to L2 cache
-            search_L2_cache (l2_cache, write_back_address, write_back_data, WRITE_ACCESS);
+            // Write the dirty block in L1 back to L2 cache (L2 copies it straight out of the L1 entry)
+            if (l2_cache != NULL) {
+#ifndef TAG_ONLY_SIMULATION
+                search_L2_cache (l2_cache, dirty_block_address, L1_CACHE_DATA_BLOCK (l1_cache, set_index, victim_way), WRITE_ACCESS);
+#else
+                search_L2_cache (l2_cache, dirty_block_address, tag_only_data_block, WRITE_ACCESS);
+#endif
+            }
+
+            // No L2 cache given - the parallel L2 back end only models the L2 tags, the caller queues the write back for it
+            else {
+                *write_back_address = dirty_block_address;
+                write_back_pending = 1;
+            }
         }
         
         // L1 cache data block updation
-        for (j = 0; j < NUM_L1_CACHE_BLOCK_SIZE; j++)
-            l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].data_blocks[j].data = fetched_data[j].data;
+#ifndef TAG_ONLY_SIMULATION
+        for (j = 0; j < block_size; j++)
+            L1_CACHE_DATA_BLOCK (l1_cache, set_index, victim_way)[j].data = fetched_data[j].data;
+#endif
+        
+        // L1 halt tag presence updation (replaced entry was VALID)
+        update_L1_halt_tag_presence (l1_cache, set_index, victim_way, VALID, L1_CACHE_HALT_TAG (l1_cache, set_index, victim_way), halt_tag);
         
         // L1 cache entry updation
-        l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].main_tag_bits = main_tag; 
-        l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].valid_bit = VALID;
-        l1_cache->l1_cache_sets[set_index].l1_cache_entry[LRU_way].dirty_bit = CLEAN;
+        entry->main_tag_bits = main_tag; 
+        entry->valid_bit = VALID;
+        entry->dirty_bit = CLEAN;
         
         // L1 tag halt tag array entry updation        
-        l1_cache->halt_tag_array[LRU_way].halt_tags_per_way[set_index] = halt_tag;
-    }
-}
-
-// Updates the LRU counter corresponding to given set index at every access that results in L1 cache hit.
-
-void update_L1_LRU_counter (L1_cache *l1_cache, int set_index, int way_index) {
-    int i = 0;
-    
-    // temp holds the lru count of accessed way index before updation
-    int temp = l1_cache->l1_cache_sets[set_index].lru_counter[way_index]; 
-    
-    // Update LRU counter values for all ways
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
-    
-        // For the way index accessed, set the counter to maximum value i.e. NUM_L1_CACHE_WAYS - 1 
-        if (i == way_index)
-            l1_cache->l1_cache_sets[set_index].lru_counter[way_index] = (NUM_L1_CACHE_WAYS - 1);
-            
-        // For all the other ways, decrement LRU counter by 1 if it is greater than temp 
-        else {
-            if (l1_cache->l1_cache_sets[set_index].lru_counter[i] > temp) 
-                l1_cache->l1_cache_sets[set_index].lru_counter[i]--;   
-        }
-    }         
-}
+        L1_CACHE_HALT_TAG (l1_cache, set_index, victim_way) = halt_tag;
 
-/* Get the LRU way entry index for REPLACEMENT */
-
-int get_L1_LRU_way_entry (L1_cache* l1_cache, int set_index) {
-    int i = 0;
-    
-    // Check LRU counter values for all ways to find the first way entry having counter value as 0
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
-        if (l1_cache->l1_cache_sets[set_index].lru_counter[i] == 0)
-            break;        
+        replacement_on_fill (&l1_cache->replacement, set_index, victim_way);
     }
-    return i;
+
+    return write_back_pending;
 }
 
 // Prints L1 instruction/data cache entries, halt tag arrays and data blocks.
 
 void print_L1_cache (L1_cache *l1_cache) {
-    int i = 0;
-    int j = 0;
-    int k = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+#ifndef TAG_ONLY_SIMULATION
+    unsigned int k = 0;
+#endif
 
-    for (i = 0; i < NUM_L1_CACHE_SETS; i++) {
+    for (i = 0; i < l1_cache->geometry.num_sets; i++) {
         printf ("SET %d\n", i + 1);
-        for (j = 0; j < NUM_L1_CACHE_WAYS; j++) {
+        for (j = 0; j < l1_cache->geometry.num_ways; j++) {
         
             // Print L1 cache entries
-            printf(" Main Tag: %d Valid Bit: %d Dirty bit: %d\n Write bit: %d\n", l1_cache->l1_cache_sets[i].l1_cache_entry[j].main_tag_bits, l1_cache->l1_cache_sets[i].l1_cache_entry[j].valid_bit, l1_cache->l1_cache_sets[i].l1_cache_entry[j].dirty_bit, l1_cache->l1_cache_sets[i].l1_cache_entry[j].write_bit);
+            printf(" Main Tag: %d Valid Bit: %d Dirty bit: %d\n Write bit: %d\n", L1_CACHE_ENTRY (l1_cache, i, j)->main_tag_bits, L1_CACHE_ENTRY (l1_cache, i, j)->valid_bit, L1_CACHE_ENTRY (l1_cache, i, j)->dirty_bit, L1_CACHE_ENTRY (l1_cache, i, j)->write_bit);
         
-            // Print LRU counter values for all sets
-            printf(" LRU counter for set %d: %d\n", i + 1, l1_cache->l1_cache_sets[i].lru_counter[j]); 
-            
             // Print L1 cache datablock entries 
-            for (k = 0;  k < NUM_L1_CACHE_BLOCK_SIZE; k++)
-                printf(" Data block[%d]: %d ", k, l1_cache->l1_cache_sets[i].l1_cache_entry[j].data_blocks[k].data);
+#ifndef TAG_ONLY_SIMULATION
+            for (k = 0;  k < l1_cache->geometry.block_size; k++)
+                printf(" Data block[%d]: %d ", k, L1_CACHE_DATA_BLOCK (l1_cache, i, j)[k].data);
+#endif
             printf("\n\n");
         }
     }
         
-    // Initialize all entries of L1 Cache Halt Tag Array (corresponding to each way) to 0
-    for (i = 0; i < NUM_L1_CACHE_WAYS; i++) {
+    // Print all entries of L1 Cache Halt Tag Array (corresponding to each way)
+    for (i = 0; i < l1_cache->geometry.num_ways; i++) {
         printf (" Halt tag array for way %d\n", i + 1);
-        for (j = 0; j < NUM_L1_CACHE_SETS; j++)
-            printf (" Halt tag[%d]: %d ", j, l1_cache->halt_tag_array[i].halt_tags_per_way[j]);
+        for (j = 0; j < l1_cache->geometry.num_sets; j++)
+            printf (" Halt tag[%d]: %d ", j, L1_CACHE_HALT_TAG (l1_cache, j, i));
     }
 }
 
@@ -2,216 +2,302 @@
 #include <stdlib.h>
 #include "cache.h"
 
-// Initializes the L2 cache structures.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define L2_CACHE_X86_SIMD 1
+#endif
 
-L2_cache* initialize_L2_cache () {
-    int i = 0;
-    int j = 0;
+// The tags of a set are searched with one compare of the packed tag store. The compare kernel is picked once per cache from the way count:
+// 8 ways - one SSE2 16B compare, 16 / 32 ways - one / two AVX2 32B compares if the CPU supports them, else two / four SSE2 16B compares,
+// any other way count - a scalar loop. The AVX2 kernels are compiled with a per-function target attribute and selected at run time
+// (like the trace parser), so the makefile flags do not change.
+
+#ifdef TAG_ONLY_SIMULATION
+data_byte tag_only_data_block [PAGE_SIZE];
+#endif
+
+#ifdef L2_CACHE_X86_SIMD
+
+// Each kernel compares the packed tag store entries of a set with the search entry - returns a mask with 2 bits set per matching way
+// (bit 2i and 2i + 1 for way i), so the 16 and 32 way masks need a 64-bit result.
+
+__attribute__ ((target ("sse2")))
+static unsigned long long match_L2_tag_store_8_ways (const unsigned short *tag_store, unsigned short search_entry) {
+    return (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi16 (_mm_load_si128 ((const __m128i *) tag_store), _mm_set1_epi16 ((short) search_entry)));
+}
+
+__attribute__ ((target ("sse2")))
+static unsigned long long match_L2_tag_store_16_ways (const unsigned short *tag_store, unsigned short search_entry) {
+    return match_L2_tag_store_8_ways (tag_store, search_entry) | (match_L2_tag_store_8_ways (tag_store + 8, search_entry) << 16);
+}
+
+__attribute__ ((target ("sse2")))
+static unsigned long long match_L2_tag_store_32_ways (const unsigned short *tag_store, unsigned short search_entry) {
+    return match_L2_tag_store_16_ways (tag_store, search_entry) | (match_L2_tag_store_16_ways (tag_store + 16, search_entry) << 32);
+}
+
+__attribute__ ((target ("avx2")))
+static unsigned long long match_L2_tag_store_16_ways_avx2 (const unsigned short *tag_store, unsigned short search_entry) {
+    __m256i tags = _mm256_load_si256 ((const __m256i *) tag_store);
+    return (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi16 (tags, _mm256_set1_epi16 ((short) search_entry)));
+}
+
+__attribute__ ((target ("avx2")))
+static unsigned long long match_L2_tag_store_32_ways_avx2 (const unsigned short *tag_store, unsigned short search_entry) {
+    return match_L2_tag_store_16_ways_avx2 (tag_store, search_entry) | (match_L2_tag_store_16_ways_avx2 (tag_store + 16, search_entry) << 32);
+}
+
+#endif
+
+// Picks the tag compare kernel for the given way count and the CPU the simulator runs on.
+
+static int get_L2_tag_match_kernel (unsigned int num_ways) {
+#ifdef L2_CACHE_X86_SIMD
+    int avx2_supported = 0;
+
+    __builtin_cpu_init ();
+    avx2_supported = __builtin_cpu_supports ("avx2") ? 1 : 0;
+
+    switch (num_ways) {
+        case 8:
+            return L2_TAG_MATCH_8_WAYS;
+        case 16:
+            return avx2_supported ? L2_TAG_MATCH_16_WAYS_AVX2 : L2_TAG_MATCH_16_WAYS;
+        case 32:
+            return avx2_supported ? L2_TAG_MATCH_32_WAYS_AVX2 : L2_TAG_MATCH_32_WAYS;
+    }
+#endif
+    (void) num_ways;
+    return L2_TAG_MATCH_GENERIC;
+}
+
+// Initializes the L2 cache structures with the L2 cache geometry.
+
+L2_cache* initialize_L2_cache (const memory_geometry *geometry) {
+    unsigned int num_sets = geometry->l2_cache.num_sets;
+    unsigned int num_ways = geometry->l2_cache.num_ways;
+    size_t tag_store_size = 0;
+    unsigned int i = 0;
 
     // Create an empty L2 cache structure
     L2_cache *l2_cache;
     l2_cache = (L2_cache *) malloc (sizeof (L2_cache));
-    
-    // Initializing all the entries
-    for (i = 0; i < NUM_L2_CACHE_SETS; i++) {
-        for (j = 0; j < NUM_L2_CACHE_WAYS; j++) {
-        
-            // Initialize the valid bit as INVALID  
-            l2_cache->l2_cache_sets[i].l2_cache_entry[j].valid_bit = INVALID;       
-            
-            // Initializing write bit values to READ_WRITE
-            l2_cache->l2_cache_sets[i].l2_cache_entry[j].write_bit = READ_WRITE;   // L2 (unified) cache access can be READ as well as WRITE   
-            
-            // Initializing all FIFO counter values to 0
-            l2_cache->l2_cache_sets[i].fifo_counter[j] = (1 << 4) - 1;
-        }    
-    }
-    
+
+    l2_cache->geometry = geometry->l2_cache;
+    l2_cache->l1_block_size = geometry->l1_cache.block_size;
+    l2_cache->tag_match_kernel = get_L2_tag_match_kernel (num_ways);
+
+    // The tag store is searched with aligned vector loads - each set starts on a 16B boundary (32B for 16 and 32 ways).
+    // Padding entries stay 0, i.e. INVALID, so they never match a search entry
+    l2_cache->tag_store_stride = (num_ways + 7) & ~7u;
+    tag_store_size = ((size_t) num_sets * l2_cache->tag_store_stride * sizeof (unsigned short) + 31) & ~(size_t) 31;
+    l2_cache->tag_store = (unsigned short *) aligned_alloc (32, tag_store_size);
+
+    // Initializing all the entries - valid bit as INVALID
+    for (i = 0; i < num_sets * l2_cache->tag_store_stride; i++)
+        l2_cache->tag_store[i] = L2_CACHE_TAG_ENTRY (0, INVALID);
+
+#ifndef TAG_ONLY_SIMULATION
+    l2_cache->data_blocks = (data_byte *) calloc ((size_t) num_sets * num_ways * geometry->l2_cache.block_size, sizeof (data_byte));
+#endif
+
+    // Initializing write bit values to READ_WRITE - L2 (unified) cache access can be READ as well as WRITE
+    l2_cache->write_bits = (unsigned int *) malloc (num_sets * sizeof (unsigned int));
+    for (i = 0; i < num_sets; i++)
+        l2_cache->write_bits[i] = l2_cache->geometry.way_mask;
+
+    // No VALID entries yet
+    l2_cache->valid_bits = (unsigned int *) calloc (num_sets, sizeof (unsigned int));
+
+    // Initializing the replacement state (FIFO pointer at the first way by default)
+    initialize_replacement_state (&l2_cache->replacement, &geometry->l2_cache);
+
     // Marking last set entry in each way as READ_ONLY (Write protected)
-        for (j = 0; j < NUM_L2_CACHE_WAYS; j++)
-            l2_cache->l2_cache_sets[NUM_L2_CACHE_SETS - 1].l2_cache_entry[j].write_bit = READ_ONLY;
-            
+    l2_cache->write_bits[num_sets - 1] = 0;
+
     return l2_cache;    // Return pointer to the initialized cache structure
 }
 
-// Search the L2 cache for data entry corresponding to the given physical address. 
+// Frees the L2 cache structure.
+
+void free_L2_cache (L2_cache* l2_cache) {
+    free (l2_cache->tag_store);
+#ifndef TAG_ONLY_SIMULATION
+    free (l2_cache->data_blocks);
+#endif
+    free (l2_cache->write_bits);
+    free (l2_cache->valid_bits);
+    free_replacement_state (&l2_cache->replacement);
+    free (l2_cache);
+}
+
+// Finds the way of the given set that holds a VALID entry with the given tag.
+// Since the valid bit is packed with the tag, a single compare against (tag << 1) | VALID rejects INVALID ways as well. Returns -1 if the tag is not present.
+
+int find_L2_cache_way (L2_cache* l2_cache, unsigned int set_index, unsigned int tag) {
+    const unsigned short *tag_store = L2_CACHE_TAG_STORE_SET (l2_cache, set_index);
+    unsigned short search_entry = L2_CACHE_TAG_ENTRY (tag, VALID);
+    unsigned int i = 0;
+
+#ifdef L2_CACHE_X86_SIMD
+    unsigned long long match_mask = 0;
+
+    switch (l2_cache->tag_match_kernel) {
+        case L2_TAG_MATCH_8_WAYS:
+            match_mask = match_L2_tag_store_8_ways (tag_store, search_entry);
+            break;
+        case L2_TAG_MATCH_16_WAYS:
+            match_mask = match_L2_tag_store_16_ways (tag_store, search_entry);
+            break;
+        case L2_TAG_MATCH_32_WAYS:
+            match_mask = match_L2_tag_store_32_ways (tag_store, search_entry);
+            break;
+        case L2_TAG_MATCH_16_WAYS_AVX2:
+            match_mask = match_L2_tag_store_16_ways_avx2 (tag_store, search_entry);
+            break;
+        case L2_TAG_MATCH_32_WAYS_AVX2:
+            match_mask = match_L2_tag_store_32_ways_avx2 (tag_store, search_entry);
+            break;
+        default:
+            goto generic;
+    }
+
+    // Each 16-bit lane sets 2 mask bits - the way index is half the position of the first set bit
+    if (match_mask != 0)
+        return __builtin_ctzll (match_mask) >> 1;
+    return -1;
+
+generic:
+#endif
+
+    for (i = 0; i < l2_cache->geometry.num_ways; i++) {
+        if (tag_store[i] == search_entry)
+            return i;
+    }
+    return -1;
+}
+
+// Search the L2 cache for data entry corresponding to the given physical address.
 // If found, perform a read or write operation depeding on the type of access.
 
 data_byte* search_L2_cache (L2_cache* l2_cache, unsigned int physical_address, data_byte* write_data, int access_type) {
     int i = 0;
+#ifndef TAG_ONLY_SIMULATION
     int j = 0;
+#endif
     unsigned int tag = 0;           // L2 cache tag bits
     unsigned int set_index = 0;     // L2 cache set index bits
     unsigned int offset = 0;        // L2 cache offset bits
     unsigned int block_offset = 0;  // L2 cache block offset
-    
-    // Allocating memory to store the datablock to be fetched 
-    data_byte* data;
-    data = malloc (sizeof (data_byte) * 32);
-    
+    data_byte* data_block;          // L2 datablock of the matching way
+
     // Extracting the tag, offset and index bits from the physical address
-    offset = physical_address % NUM_L2_CACHE_BLOCK_SIZE;    
-    set_index = (physical_address >> NUM_L2_CACHE_OFFSET_BITS) % NUM_L2_CACHE_SETS;
-    tag = physical_address >> (NUM_L2_CACHE_SET_INDEX_BITS + NUM_L2_CACHE_OFFSET_BITS); 
-    
-    block_offset = offset | (1 << NUM_L1_CACHE_OFFSET_BITS);      // block offset (64B - first 32B or last 32B) - location of the first byte of the 32B block
-    
-    // Searching the L2 cache
-    for (i = 0; i < NUM_L2_CACHE_WAYS; i++) {      
-                
-        // If the entry is VALID and the tag value matches the main tag bits -- entry found!        
-        if (l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].valid_bit == VALID && l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].main_tag_bits == main_tag) {
-                    
-            // For READ access
-            if (access_type == READ_ACCESS) {
-            
-                // Read 32B (L1 cache block size) of data from 64B L2 cache datablock (starting location in datablock given by block offset)
-                for (j = 0; j < NUM_L1_CACHE_BLOCK_SIZE; j++)
-                    data = l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].data_blocks[block_offset + j].data;     
- 
-                // Update FIFO counter corresponding to this set index
-                update_L2_FIFO_counter(l2_cache, set_index, i);    
-    
-                return data;
-            }
-        }                                
-        
-        // For WRITE access - when WRITE permission is available
-        else if (access_type == WRITE_ACCESS && l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].write_bit == READ_WRITE) {
-                    
-            // Write 32B (L1 cache block size) of data into L2 cache datablock (starting location in datablock given by block offset)
-            for (j = 0; j < NUM_L1_CACHE_BLOCK_SIZE; j++)
-                l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].data_blocks[block_offset + j].data = write_data;  
-                                     
-            // Initiate write to the corresponding block in Main Memory (write-through policy)
-            // TODO update_main_memory_fn
-                    
-            // Update FIFO counter corresponding to this set index
-            update_L2_FIFO_counter(l2_cache, set_index, i);
-                        
-            return write_data;    // anything other than NULL. NULL is used to indicate miss/ write exception 
-        }
-                
-        // For WRITE access - when WRITE permission is denied --- The write access results in a WRITE PROTECTION EXCEPTION
-        else if (access_type == WRITE_ACCESS && l1_cache->l1_cache_sets[set_index].l1_cache_entry[i].write_bit == READ_ONLY) {
-            return NULL;
-        }
-    }
-    
-    // If the data is not found in any of the ways corresponding to the set index obtained - MISS
-    return NULL;
-}
+    offset = physical_address & l2_cache->geometry.offset_mask;
+    set_index = (physical_address >> l2_cache->geometry.offset_bits) & l2_cache->geometry.set_index_mask;
+    tag = physical_address >> (l2_cache->geometry.set_index_bits + l2_cache->geometry.offset_bits);
 
-// Updates the L2 cache with the datablock fetched from the next level i.e. main memory. 
-// Depending on the availability of free slots an entry is PLACED/REPLACED in the L2 cache. 
-// If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there. 
-// Else, REPLACE any of the way entries with required set index using FIFO REPLACEMENT. 
+    block_offset = offset & ~(l2_cache->l1_block_size - 1);      // block offset (e.g. 64B - first 32B or last 32B) - location of the first byte of the L1-sized block
 
-void update_L2_cache (L2_cache* l2_cache, Main_memory* Main_memory, data_byte* fetched_data, unsigned int physical_address) {
-    unsigned int tag = 0;         // L2 cache tag bits
-    unsigned int set_index = 0;   // L2 cache set index bits
-    unsigned int offset = 0;      // L2 cache byte offset bits
-    
-    // Extracting the tag, offset and index bits from the physical address
-    offset = physical_address % NUM_L2_CACHE_BLOCK_SIZE;
-    set_index = (physical_address >> NUM_L2_CACHE_OFFSET_BITS) % NUM_L2_CACHE_SETS;
-    tag = physical_address >> (NUM_L2_CACHE_SET_INDEX_BITS + NUM_L2_CACHE_OFFSET_BITS);  
-    
-    int FIFO_way = 0;              // way index corresponding to first arrived entry in the set
-    
-    // Any block REPLACED in L2 cache needs to be updated in Main Memory immediately (Write-through Policy). 
-    unsigned int write_through_address = 0;    
+    // Searching the L2 cache -- if no VALID entry of the set holds the tag, MISS
+    i = find_L2_cache_way (l2_cache, set_index, tag);
+    if (i < 0)
+        return NULL;
 
-    int i = 0;
-    int j = 0;
+#ifndef TAG_ONLY_SIMULATION
+    data_block = L2_CACHE_DATA_BLOCK (l2_cache, set_index, i);
+#else
+    data_block = tag_only_data_block;    // No data simulated - the placeholder block only signals the hit
+#endif
 
-    // PLACEMENT: If there are INVALID entries in L1 cache corresponding to the given set index, PLACE this entry in the first INVALID entry's slot    
-    
-    // Looking for the first INVALID entry for given set index in L1 cache
-    for (i = 0; i < NUM_L2_CACHE_WAYS; i++) {
-       
-        if (l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].valid_bit == INVALID) {
-            
-            // L2 cache data block updation
-            for (j = 0; j < NUM_L2_CACHE_BLOCK_SIZE; j++)
-                l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].data_blocks[j].data = fetched_data[j].data;
-            
-            // L2 cache entry updation
-            l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].tag = tag;  
-            l2_cache->l2_cache_sets[set_index].l2_cache_entry[i].valid_bit = VALID;
-            
-            break;
-        }        
+    // For READ access - update the replacement state
+    // Return a pointer view of the L1 cache block size of data within the L2 cache datablock (starting location in datablock given by block offset).
+    // No copy is made - the view stays valid until the entry is replaced, the reader (update_L1_cache) copies it into L1 straight away
+    if (access_type == READ_ACCESS) {
+        replacement_on_hit (&l2_cache->replacement, set_index, i);
+        return data_block + block_offset;
     }
-    
-    // REPLACEMENT: If all entries corresponding to the given set index are VALID, check the LRU counter and replace entry corresponding to LRU way
-    if (i == NUM_L2_CACHE_WAYS) {
-    
-        data_byte write_back_data [NUM_L2_CACHE_BLOCK_SIZE];
-    
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////     
-    
-        // Check FIFO counter to get the FIFO way entry index
-        FIFO_way = get_L2_FIFO_way_entry (l2_cache, set_index);
-        
-        // Initiate write back to main memory
-        // Get the physical address of the dirty block to be written back to L2  
-        write_through_address = (l2_cache->l2_cache_sets[set_index].l2_cache_entry[FIFO_way].tag << (NUM_L2_CACHE_SET_INDEX_BITS + NUM_L2_CACHE_OFFSET_BITS)) | (set_index << NUM_L2_CACHE_OFFSET_BITS); 
-        
-        // Copy datablock to be written to next level    
-        for (int ii =0; ii < NUM_L2_CACHE_BLOCK_SIZE; ii++)
-            write_back_data[ii].data = l2_cache->l2_cache_sets[set_index].l2_cache_entry[FIFO_way].data_blocks[ii].data;
-            
-        // Write the block to be replaced in L2 back to Main Memory
+
+    // For WRITE access - when WRITE permission is available
+    else if (((l2_cache->write_bits[set_index] >> i) & 1) == READ_WRITE) {
+
+        // Write L1 cache block size of data into L2 cache datablock (starting location in datablock given by block offset)
+#ifndef TAG_ONLY_SIMULATION
+        for (j = 0; j < (int) l2_cache->l1_block_size; j++)
+            data_block[block_offset + j].data = write_data[j].data;
+#endif
+
+        // Initiate write to the corresponding block in Main Memory (write-through policy)
         // TODO update_main_memory_fn
+
+        // A write back from L1 updates the replacement state like a READ hit (as the FIFO counter was updated on writes)
+        replacement_on_hit (&l2_cache->replacement, set_index, i);
+
+        return write_data;    // anything other than NULL. NULL is used to indicate miss/ write exception
     }
-        
-    // L2 cache data block updation
-    for (j = 0; j < NUM_L2_CACHE_BLOCK_SIZE; j++)
-        l2_cache->l2_cache_sets[set_index].l2_cache_entry[FIFO_way].data_blocks[j].data = fetched_data[j].data;
-        
-        // L2 cache entry updation
-        l2_cache->l2_cache_sets[set_index].l2_cache_entry[FIFO_way].tag = tag; 
-        l2_cache->l2_cache_sets[set_index].l2_cache_entry[FIFO_way].valid_bit = VALID;
-    }
+
+    // For WRITE access - when WRITE permission is denied --- The write access results in a WRITE PROTECTION EXCEPTION
+    else
+        return NULL;
 }
 
+// Updates the L2 cache with the datablock fetched from the next level i.e. main memory.
+// Depending on the availability of free slots an entry is PLACED/REPLACED in the L2 cache.
+// If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there.
+// Else, REPLACE the way entry chosen by the L2 cache replacement policy (FIFO REPLACEMENT by default).
 
+// Returns a pointer view of the L1 cache block size of data within the placed block (as a READ hit on it would, without counting as a hit
+// in the replacement state).
 
-void update_fifo_l2_cache(L2_cache* l2_cache_1, int set_index)
-{
-    int i;
-    for (i = 0; i < NUM_L2_CACHE_WAYS; i++) {
-        if (l2_cache_1->set_array[set_index].set_entries[i].valid_bit == VALID) {
-            l2_cache_1->set_array[set_index].set_entries[i].fifo_bits--;
-        }        
-    }
-}
-int get_FIFO_replacement(L2_cache* l2_cache_1,int set_index)
-{
-    for (int i = 0; i < NUM_L2_CACHE_WAYS; i++) {
-        if (l2_cache_1->set_array[set_index].set_entries[i].fifo_bits == 0) {
-            return i;
-        }        
-    }
+data_byte* update_L2_cache (L2_cache* l2_cache, data_byte* fetched_data, unsigned int physical_address) {
+    unsigned int tag = 0;         // L2 cache tag bits
+    unsigned int set_index = 0;   // L2 cache set index bits
+    unsigned int block_offset = 0;// L2 cache block offset of the L1-sized block
+    unsigned int invalid_ways = 0;
+    int way = 0;                  // way index the entry is placed in
+#ifndef TAG_ONLY_SIMULATION
+    int j = 0;
+#endif
 
-}
+    // Extracting the tag and index bits from the physical address
+    set_index = (physical_address >> l2_cache->geometry.offset_bits) & l2_cache->geometry.set_index_mask;
+    tag = physical_address >> (l2_cache->geometry.set_index_bits + l2_cache->geometry.offset_bits);
 
-void print_L2_cache (L2_cache *l2_cache_1) {
-    for (int i = 0; i < NUM_L2_CACHE_SETS; i++) {
-        if(i==28)
-        {
-            printf ("SET %d\n", i + 1);
-            for (int j = 0; j < NUM_L2_CACHE_WAYS; j++) {
-                printf(" Main Tag: %d Valid Bit: %d \n", l2_cache_1->set_array[i].set_entries[j].tag, l2_cache_1->set_array[i].set_entries[j].valid_bit);
-                printf("\n\n");
-            }
-
-        }
-    }   
-}
+    // PLACEMENT: If there are INVALID entries in L2 cache corresponding to the given set index, PLACE this entry in the first INVALID entry's slot
+    invalid_ways = ~l2_cache->valid_bits[set_index] & l2_cache->geometry.way_mask;
+    if (invalid_ways != 0)
+        way = __builtin_ctz (invalid_ways);
 
+    // REPLACEMENT: if all entries of the given set index are VALID, REPLACE the entry chosen by the replacement policy.
+    // Since L2 follows the write-through policy, the replaced block is already up to date in Main Memory and is simply overwritten.
+    else
+        way = replacement_choose_victim (&l2_cache->replacement, set_index);
 
+    // L2 cache data block updation
+#ifndef TAG_ONLY_SIMULATION
+    for (j = 0; j < (int) l2_cache->geometry.block_size; j++)
+        L2_CACHE_DATA_BLOCK (l2_cache, set_index, way)[j].data = fetched_data[j].data;
+#endif
+
+    // L2 cache entry updation
+    L2_CACHE_TAG_STORE_SET (l2_cache, set_index)[way] = L2_CACHE_TAG_ENTRY (tag, VALID);
+    l2_cache->valid_bits[set_index] |= 1u << way;
+    replacement_on_fill (&l2_cache->replacement, set_index, way);
 
+#ifndef TAG_ONLY_SIMULATION
+    block_offset = (physical_address & l2_cache->geometry.offset_mask) & ~(l2_cache->l1_block_size - 1);
+    return L2_CACHE_DATA_BLOCK (l2_cache, set_index, way) + block_offset;
+#else
+    (void) block_offset;
+    return tag_only_data_block;
+#endif
+}
 
+// Prints all L2 cache entries set-wise
 
+void print_L2_cache (L2_cache *l2_cache) {
+    for (unsigned int i = 0; i < l2_cache->geometry.num_sets; i++) {
+        printf ("SET %d\n", i + 1);
+        for (unsigned int j = 0; j < l2_cache->geometry.num_ways; j++)
+            printf(" Tag: %x Valid Bit: %d Write Bit: %d\n", L2_CACHE_TAG_STORE_SET (l2_cache, i)[j] >> 1, L2_CACHE_TAG_STORE_SET (l2_cache, i)[j] & 1, (l2_cache->write_bits[i] >> j) & 1);
+    }
+}
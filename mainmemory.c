@@ -1,14 +1,15 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "cache.h"
 #include "pagetable.h"
 #include "mainmemory.h"
 #include "processes.h"
+#include "simulator.h"
 
-#define PAGE_TABLE_LIMIT 1019
-#define PER_PROCESS_PAGE_LIMIT 256
 /*
 ///////TEMPORARY DECARATIONS TILL CODE IS INTEGRATED//
 typedef struct pcb
@@ -29,68 +30,170 @@ typedef struct Proc_Access_Info
 //////
 */
 
-PCB* temp_pcb;
-Proc_Access_Info* temp_pai;
+// The main memory, frame table, frame allocator, CLOCK replacement state and counters are part of the simulator context (simulator.h)
 
-main_memory* mm;
-frame_table* f_table;
-second_chance_fifo_queue* second_chance_fifo;
-int total_page_count;
-int frame_table_index;
-
-extern page_table_entry* get_page_entry(unsigned int block_number, PCB* temp_pcb, Proc_Access_Info* temp_pai);
-
-main_memory* main_memory_init()
+main_memory* main_memory_init(simulator_context* ctx)
 {
-    main_memory* mm;
-    mm = (main_memory*)malloc(sizeof(main_memory));
-    frame_table_index=0;
+    // The main memory of the context is the owner of all page tables and blocks - cache levels get pointer views into its blocks
+    main_memory* mm = (main_memory*)calloc(1, sizeof(main_memory));
+    ctx->mm = mm;
+    mm->dram = (main_memory_block*)mmap(NULL, MAIN_MEMORY_DRAM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    mm->dram_mapped = 1;
+    if(mm->dram == MAP_FAILED)
+    {
+        fprintf(stderr, " ERROR: Could not reserve %zu B for main memory - allocating it instead\n", MAIN_MEMORY_DRAM_SIZE);
+        mm->dram = (main_memory_block*)calloc(NUM_FRAMES, sizeof(main_memory_block));
+        mm->dram_mapped = 0;
+    }
+    ctx->f_table = &(mm->f_table);
+    initialize_frame_allocator(&(mm->free_frames));
     mm->total_access_count=0;
     mm->access_hit_count=0;
     return mm;
 }
 
-second_chance_fifo_queue* second_chance_replacement_init()
+void initialize_frame_allocator(frame_allocator* allocator)
 {
-    // second_chance_fifo_queue second_chance_fifo;
-    second_chance_fifo = (second_chance_fifo_queue*)malloc(sizeof(second_chance_fifo_queue));
-    second_chance_fifo->head = (second_chance_node*)malloc(sizeof(second_chance_node));
-    second_chance_fifo->tail = (second_chance_node*)malloc(sizeof(second_chance_node));
-    second_chance_fifo->head->next = second_chance_fifo->tail;
-    second_chance_fifo->head->prev = NULL;
-    second_chance_fifo->tail->next = NULL;
-    second_chance_fifo->tail->prev = second_chance_fifo->head;
-    return second_chance_fifo;
+    // All frames free - bits past the last frame stay clear so they are never found
+    for(unsigned int i=0;i<NUM_FRAMES;i++)
+    {
+        allocator->free_bits[i>>6] |= 1ULL << (i&63);
+    }
+    for(unsigned int i=0;i<FRAME_BITMAP_WORDS;i++)
+    {
+        allocator->summary_bits[i>>6] |= 1ULL << (i&63);
+    }
+    for(unsigned int i=0;i<FRAME_SUMMARY_WORDS;i++)
+    {
+        allocator->top_bits |= 1ULL << i;
+    }
+    allocator->free_list_count=0;
+    allocator->free_frame_count=NUM_FRAMES;
+    return;
 }
 
-data_byte* get_l1_block(unsigned int block_number/* physical address/32 */) //called from l1 cache//
+// Lowest free frame at or after start_frame, -1 if there is none - at most one find-first-set per bitmap level
+static int find_free_frame(frame_allocator* allocator, unsigned int start_frame)
 {
-    unsigned int frame_number = block_number/16;
-    unsigned int index = block_number%16;
+    unsigned int word = start_frame>>6;
+    unsigned int summary;
+    unsigned long long bits;
+
+    if(start_frame>=NUM_FRAMES) return -1;
 
-    main_memory_block* temp = (mm->blocks[frame_number]);
+    // Rest of the word of start_frame
+    bits = allocator->free_bits[word] & (~0ULL << (start_frame&63));
+    if(bits) return (word<<6) + __builtin_ctzll(bits);
 
-    data_byte* data = (data_byte*)malloc(32*sizeof(data_byte));
-    for(int i=0;i<32;i++)
+    // Rest of the summary word
+    word++;
+    summary = word>>6;
+    if(summary>=FRAME_SUMMARY_WORDS) return -1;
+    bits = allocator->summary_bits[summary] & (~0ULL << (word&63));
+    if(bits == 0)
     {
-        data[i].data=temp->entry[(4*index)+i].data;
+        // Next summary word with a free frame
+        if(summary+1>=64) return -1;
+        bits = allocator->top_bits & (~0ULL << (summary+1));
+        if(bits == 0) return -1;
+        summary = __builtin_ctzll(bits);
+        bits = allocator->summary_bits[summary];
     }
-    // l1_block.valid_bit = VALID;
-    return data;
+    word = (summary<<6) + __builtin_ctzll(bits);
+    return (word<<6) + __builtin_ctzll(allocator->free_bits[word]);
 }
 
-data_byte* get_l2_block(unsigned int block_number/* physical address/64 */, Proc_Access_Info* temp_pai) //called from l2 cache//
+static void mark_frame_used(frame_allocator* allocator, unsigned int frame_number)
 {
-    unsigned int frame_number = block_number/8;
-    unsigned int index = block_number%8;
+    unsigned int word = frame_number>>6;
 
-    main_memory_block* temp = (mm->blocks[frame_number]);
+    allocator->free_bits[word] &= ~(1ULL << (frame_number&63));
+    if(allocator->free_bits[word] == 0)
+    {
+        allocator->summary_bits[word>>6] &= ~(1ULL << (word&63));
+        if(allocator->summary_bits[word>>6] == 0) allocator->top_bits &= ~(1ULL << (word>>6));
+    }
+    allocator->free_frame_count--;
+    return;
+}
 
-    data_byte* data = (data_byte*)malloc(64*sizeof(data_byte));
-    for(int i=0;i<64;i++)
+int allocate_frame(frame_allocator* allocator, unsigned int start_frame)
+{
+    int frame_number;
+
+    // Fast path - a recently released frame. Entries of frames allocated again since are dropped (each entry is taken at most once).
+    while(allocator->free_list_count>0)
     {
-        data[i].data=temp->entry[(4*index)+i].data;
+        frame_number = allocator->free_list[--allocator->free_list_count];
+        if(allocator->free_bits[frame_number>>6] & (1ULL << (frame_number&63)))
+        {
+            mark_frame_used(allocator, frame_number);
+            return frame_number;
+        }
     }
+
+    // Lowest free frame from start_frame, wrapping around to the start of memory
+    frame_number = find_free_frame(allocator, start_frame);
+    if(frame_number<0) frame_number = find_free_frame(allocator, 0);
+    if(frame_number<0) return -1;
+    mark_frame_used(allocator, frame_number);
+    return frame_number;
+}
+
+void release_frame(frame_allocator* allocator, unsigned int frame_number)
+{
+    unsigned int word = frame_number>>6;
+
+    if(allocator->free_bits[word] & (1ULL << (frame_number&63))) return; //already free//
+    allocator->free_bits[word] |= 1ULL << (frame_number&63);
+    allocator->summary_bits[word>>6] |= 1ULL << (word&63);
+    allocator->top_bits |= 1ULL << (word>>6);
+    allocator->free_frame_count++;
+
+    // When the free list is full the frame is still found through the bitmap
+    if(allocator->free_list_count<FRAME_FREE_LIST_SIZE)
+    {
+        allocator->free_list[allocator->free_list_count++] = frame_number;
+    }
+    return;
+}
+
+// Returns a pointer view of the L1-sized block within its main memory frame (valid until the frame is replaced) - no copy is made
+data_byte* get_l1_block(simulator_context* ctx, unsigned int block_number/* physical address/block size */, unsigned int block_size) //called from l1 cache//
+{
+#ifndef TAG_ONLY_SIMULATION
+    main_memory* mm = ctx->mm;
+    unsigned int frame_number = block_number/(PAGE_SIZE/block_size);
+    unsigned int index = block_number%(PAGE_SIZE/block_size);
+
+    main_memory_block* temp = &(mm->dram[frame_number]);
+
+    // l1_block.valid_bit = VALID;
+    return &(temp->entry[block_size*index]);
+#else
+    (void) ctx;
+    (void) block_number;
+    (void) block_size;
+    return tag_only_data_block;
+#endif
+}
+
+// Returns a pointer view of the L2-sized block within its main memory frame (valid until the frame is replaced) - no copy is made
+data_byte* get_l2_block(simulator_context* ctx, unsigned int block_number/* physical address/block size */, unsigned int block_size, Proc_Access_Info* temp_pai) //called from l2 cache//
+{
+    main_memory* mm = ctx->mm;
+    unsigned int frame_number = block_number/(PAGE_SIZE/block_size);
+
+    reference_mm_frame(mm, frame_number);
+#ifndef TAG_ONLY_SIMULATION
+    unsigned int index = block_number%(PAGE_SIZE/block_size);
+
+    main_memory_block* temp = &(mm->dram[frame_number]);
+    data_byte* data = &(temp->entry[block_size*index]);
+#else
+    data_byte* data = tag_only_data_block;
+#endif
+
     // l2_block.valid_bit = VALID;
     //
     //increment hit count
@@ -98,173 +201,125 @@ data_byte* get_l2_block(unsigned int block_number/* physical address/64 */, Proc
     return data;
 }
 
-void write_to_main_memory(unsigned int physical_address/*actual physcal address*/, data_byte* write_data) //called from l2 cache
+void write_to_main_memory(simulator_context* ctx, unsigned int physical_address/*actual physcal address*/, data_byte* write_data) //called from l2 cache
 {
+#ifndef TAG_ONLY_SIMULATION
+    main_memory* mm = ctx->mm;
     unsigned int frame_number=physical_address/512;
     unsigned int byte_offset=physical_address%512;
     
-    main_memory_block* temp = (mm->blocks[frame_number]);
+    main_memory_block* temp = &(mm->dram[frame_number]);
 
     for(int i=0;i<64;i++)
     {
         temp->entry[byte_offset/8+i]=write_data[i];
     }
+#endif
     return;
 }
 
-void replace_mm_block(second_chance_node* replaced) //functionality of second_chance_fifo//
+void reference_mm_frame(main_memory* mm, unsigned int frame_number)
 {
-    //Check end of queue
-    // printf("replacing mm block\n");
-    if(replaced->second_chance_bit==0)
-    {
-        //Reset valid bit in page table to zero
-        //Get PID of page involved
-        unsigned int temppid = f_table->entry_table[replaced->block_number]->pid;
-        unsigned int page_no = f_table->entry_table[replaced->block_number]->page_number;
-        // temp_pcb = &(process_table[pid]);
-        //Traverse through page tables till we get to required address
-        Proc_Access_Info* temp_pai= (Proc_Access_Info*)malloc(sizeof(Proc_Access_Info));
-        page_table_entry* page_entry = get_page_entry(page_no, temp_pcb, temp_pai);
-        free(temp_pai);
-        //Set valid bit to 0
-        page_entry->valid_bit=INVALID;
-        //Remove node from fifo structure
-        replaced->prev->next=replaced->next;
-        replaced->next->prev=replaced->prev;
-
-        //Remove node
-        free(replaced->data);
-        // free(replaced->second_chance_bit);
-        free(replaced);
-    }
-    else
-    {
-        //Change bit to 0;
-        replaced->second_chance_bit=0;
-        //assign new_head to replaced;
-        //replaced=replaced->prev;
-        second_chance_node* temp = replaced->prev;
-        temp->next = replaced->next;
-        second_chance_fifo->tail->prev = temp;
-        //send to head of queue;
-        replaced->next = second_chance_fifo->head->next;
-        second_chance_fifo->head->next = replaced;
-        replaced->prev = second_chance_fifo->head;
-        replaced->next->prev = replaced;
-        //replace_mm_block(new_replaced);
-        replaced=temp;
-        replace_mm_block(replaced);
-    }
-
-    mm->f_table.entry_table[replaced->block_number]->valid_bit=INVALID; //Change frame table entry//
-
-    //temp_pcb = &(process_table[f_table->entry_table[replaced->block_number]->pid]);
-    Proc_Access_Info* temp_pai = (Proc_Access_Info*)malloc(sizeof(Proc_Access_Info));
-    page_table_entry* page_lookup = get_page_entry(f_table->entry_table[replaced->block_number]->page_number, temp_pcb, temp_pai);
-    free(temp_pai);
-    page_lookup->valid_bit=INVALID; //Change page table entry//
-
+    mm->mm_clock.reference_bits[frame_number>>6] |= 1ULL << (frame_number&63);
     return;
 }
 
-main_memory_block* get_disk_block(unsigned int block_number /*physical address/512*/, unsigned int pid)
+// The hand sweeps the allocated frames from where it stopped, giving referenced frames a second chance (reference bit cleared) until it
+// reaches an unreferenced one. Iterative - after one full turn every reference bit is clear, so at most two turns of the frame table.
+int choose_mm_victim(simulator_context* ctx, int pid)
 {
-    // printf("getting disk block\n");
-    //increment miss count
-    main_memory_block* mm_block = (main_memory_block*)malloc(sizeof(main_memory_block));
-    second_chance_node* scn = (second_chance_node*)malloc(sizeof(second_chance_node));printf("malloced both\n");
-    scn->data = mm_block;
-    scn->block_number = block_number;
-    scn->prev = second_chance_fifo->head;
-    scn->next = second_chance_fifo->head->next;
-    second_chance_fifo->head->next = scn;
-    scn->next->prev = scn; 
-    scn->second_chance_bit=1;
-    mm->f_table.entry_table[block_number] = (frame_table_entry*)malloc(sizeof(frame_table_entry));
-    mm->f_table.entry_table[block_number]->valid_bit=VALID;
-    mm->f_table.entry_table[block_number]->frame_number=block_number;
-    mm->f_table.entry_table[block_number]->pid=pid;
-
-    total_page_count++;
-    temp_pcb->page_count++;
-    // printf("counts incremented\n");
-    if(total_page_count>PAGE_TABLE_LIMIT)
-    {
-        second_chance_node* replaced = second_chance_fifo->tail->prev;
-        replace_mm_block(replaced);
-        total_page_count--;
-    }
-    else if(temp_pcb->page_count >= PER_PROCESS_PAGE_LIMIT)
+    main_memory* mm = ctx->mm;
+    clock_replacement* clock = &(mm->mm_clock);
+    unsigned int frame = clock->hand;
+    unsigned int word, victim;
+    unsigned long long allocated, candidates;
+
+    for(unsigned int step=0;step<=2*FRAME_BITMAP_WORDS;step++)
     {
-        second_chance_node* replaced = second_chance_fifo->tail->prev;
-        while(1)
+        word = frame>>6;
+        allocated = ~mm->free_frames.free_bits[word] & (~0ULL << (frame&63));
+        if(pid<0)
+        {
+            // Any process - the whole word at once
+            candidates = allocated & ~clock->reference_bits[word];
+            if(candidates)
+            {
+                victim = (word<<6) + __builtin_ctzll(candidates);
+                if(victim<NUM_FRAMES)
+                {
+                    clock->reference_bits[word] &= ~(allocated & ((1ULL << (victim&63)) - 1));
+                    clock->hand = (victim+1<NUM_FRAMES) ? victim+1 : 0;
+                    return victim;
+                }
+            }
+            clock->reference_bits[word] &= ~allocated;
+        }
+        else
         {
-            if(mm->f_table.entry_table[replaced->block_number]->pid == pid)
+            // Frames of the given process only - frames of other processes keep their reference bit
+            while(allocated)
             {
-                if(replaced->second_chance_bit)
+                victim = (word<<6) + __builtin_ctzll(allocated);
+                allocated &= allocated-1;
+                if(victim>=NUM_FRAMES) break;
+                if(mm->f_table.entry_table[victim].pid!=(unsigned int)pid) continue;
+                if(clock->reference_bits[word] & (1ULL << (victim&63)))
                 {
-                    replaced->second_chance_bit=0;
-                    
-                    second_chance_node* temp = replaced->prev;
-                    temp->next = replaced->next;
-                    replaced->next->prev = temp;
-                    
-                    replaced->next = second_chance_fifo->head->next;
-                    second_chance_fifo->head->next = replaced;
-                    replaced->prev = second_chance_fifo->head;
-                    replaced->next->prev = replaced;
-                    
-                    replaced = temp;
+                    clock->reference_bits[word] &= ~(1ULL << (victim&63));
                     continue;
                 }
-                else break;
+                clock->hand = (victim+1<NUM_FRAMES) ? victim+1 : 0;
+                return victim;
             }
-            replaced = replaced->prev;
         }
-        replace_mm_block(replaced);
-        total_page_count--;
-        temp_pcb->page_count--;
+        frame = (((word+1)<<6)<NUM_FRAMES) ? (word+1)<<6 : 0;
     }
-    // printf("finished\n");
-    return mm_block;
+    return -1;
 }
 
-// unsigned int get_data_address(unsigned int page_number)
-// Check in pagetabe.c
-
-void frame_table_free(frame_table* f_table)
+// Evicts the page held by the frame - its page table entry, TLB entries and frame table entry are invalidated and the frame is free again.
+// The frame keeps its block for the next page it holds.
+void replace_mm_block(simulator_context* ctx, unsigned int frame_number)
 {
-    free(f_table);
+    main_memory* mm = ctx->mm;
+    frame_table_entry* entry = &(mm->f_table.entry_table[frame_number]);
+
+    // Page table entry mapping the frame from the reverse map - no page table walk
+    mm->p_tables[entry->pte_table_index]->entry_table[entry->pte_entry_index].valid_bit=INVALID; //Change page table entry//
+    invalidate_TLB_page(ctx->l1_tlb, ctx->l2_tlb, entry->page_number, frame_number); //TLB shootdown//
+
+    entry->valid_bit=INVALID; //Change frame table entry//
+    mm->mm_clock.reference_bits[frame_number>>6] &= ~(1ULL << (frame_number&63));
+    release_frame(&(mm->free_frames), frame_number);
     return;
 }
 
-void second_chance_free(second_chance_fifo_queue* second_chance_fifo)
+// unsigned int get_data_address(unsigned int page_number)
+// Check in pagetabe.c
+
+// Empties main memory for the next simulation - every frame free and unreferenced, no page tables. The frame data is left as it is (like
+// the data of a frame handed out again): the host pages already touched stay backed, so the next run does not fault them in again.
+void main_memory_reset(simulator_context* ctx)
 {
-    second_chance_node* curr = second_chance_fifo->head;
-    second_chance_node* clear;
-    while (curr->next != second_chance_fifo->tail)
-    {
-        clear = curr;
-        curr = curr->next;
-        free(clear);
-    }
-    free (second_chance_fifo);
+    main_memory* mm = ctx->mm;
+    memset(&(mm->f_table), 0, sizeof(frame_table));
+    memset(&(mm->free_frames), 0, sizeof(frame_allocator));
+    initialize_frame_allocator(&(mm->free_frames));
+    memset(&(mm->mm_clock), 0, sizeof(clock_replacement));
+    memset(mm->p_tables, 0, sizeof(mm->p_tables));
+    memset(mm->p_table_nodes, 0, sizeof(mm->p_table_nodes));
+    mm->num_free_p_table_slots=0;
+    mm->total_access_count=0;
+    mm->access_hit_count=0;
     return;
 }
 
-void main_memory_free(main_memory* mm)
+void main_memory_free(simulator_context* ctx)
 {
-    frame_table_free(&(mm->f_table));
-    second_chance_free(second_chance_fifo);
-    for(int i=0;i<1024;i++)
-    {
-        if(mm->p_tables[i]!=NULL) free(mm->p_tables[i]);
-    }
-    for(int i=0;i<63488;i++)
-    {
-        if(mm->blocks[i]!=NULL) free(mm->blocks[i]);
-    }
+    main_memory* mm = ctx->mm;
+    // The page tables belong to the page table slab of the context
+    if(mm->dram_mapped) munmap(mm->dram, MAIN_MEMORY_DRAM_SIZE);
+    else free(mm->dram);
     free(mm);
     return;
 }
@@ -1,70 +1,106 @@
-#ifndef MAIN_MEMORY_H
-#define MAIN_MEMORY_H
-
-#define VALID 1
-#define INVALID 0
-
-#include "processes.h"
-#include "cache.h"
-#include "pagetable.h"
-
-extern int frame_table_index;
-
-typedef struct frame_table_entry
-{
-    unsigned int frame_number:16; //TODO: will be removed, frame table indexed by frame number.
-    unsigned int pid:16;
-    unsigned int page_number:23;
-    unsigned int valid_bit:1;
-    unsigned int modified_bit:1;
-} frame_table_entry;
-
-typedef struct frame_table
-{
-    frame_table_entry* entry_table[63488];
-} frame_table;
-
-//typedef struct data_byte
-//{
-//    unsigned int data:8;
-//} data_byte;
-
-typedef struct main_memory_block
-{
-    data_byte entry[512];
-} main_memory_block;
-
-typedef struct main_memory
-{
-    frame_table f_table;
-    // page_table* global_pages[1024];
-    page_table* p_tables[1024]; //CHANGED from 65536 to 1024//
-    main_memory_block* blocks[63488]; //65536 - 2048. 1024 each for page table and frame table//
-    unsigned int total_access_count;
-    unsigned int access_hit_count;
-} main_memory;
-
-typedef struct second_chance_node second_chance_node;
-
-struct second_chance_node
-{
-    unsigned int block_number:16; //Physical block address
-    main_memory_block* data;
-    second_chance_node* prev;
-    second_chance_node* next;
-    unsigned int second_chance_bit:1;
-};
-
-typedef struct second_chance_fifo_queue
-{
-    second_chance_node* head;
-    second_chance_node* tail;
-} second_chance_fifo_queue;
-extern second_chance_fifo_queue* second_chance_fifo;
-
-main_memory* main_memory_init();
-data_byte* get_l2_block(unsigned int block_number/* physical address/64 */, Proc_Access_Info* temp_pai); //called from l2 cache//;
-void main_memory_free(main_memory* mm);
-
-
-#endif
+#ifndef MAIN_MEMORY_H
+#define MAIN_MEMORY_H
+
+#define VALID 1
+#define INVALID 0
+
+#include "processes.h"
+#include "cache.h"
+#include "pagetable.h"
+
+#define NUM_FRAMES 63488    // 65536 - 2048. 1024 each for page table and frame table
+
+// Free frame bitmap - one bit per frame, one summary bit per bitmap word, one top bit per summary word (bit set - free frame below)
+#define FRAME_BITMAP_WORDS ((NUM_FRAMES + 63) / 64)
+#define FRAME_SUMMARY_WORDS ((FRAME_BITMAP_WORDS + 63) / 64)
+
+// Recently released frames are handed out again first, without a bitmap search
+#define FRAME_FREE_LIST_SIZE 64
+
+// Frame table entry - 8 bytes, the frame table is indexed by frame number. It is also the reverse map of the frame: the owning process and
+// the page table entry mapping the frame (page table index and entry within it), set when the page is mapped.
+typedef struct frame_table_entry
+{
+    unsigned int pid:16;
+    unsigned int pte_table_index:10;
+    unsigned int valid_bit:1;
+    unsigned int modified_bit:1;
+    unsigned int page_number:23;
+    unsigned int pte_entry_index:7;
+} frame_table_entry;
+
+typedef struct frame_table
+{
+    frame_table_entry entry_table[NUM_FRAMES];  // Contiguous - a frame lookup is one indexed load
+} frame_table;
+
+// Physical frame allocator - hierarchical free bitmap searched with find-first-set, plus a free list of recently released frames
+typedef struct frame_allocator
+{
+    unsigned long long free_bits[FRAME_BITMAP_WORDS];
+    unsigned long long summary_bits[FRAME_SUMMARY_WORDS];
+    unsigned long long top_bits;
+    unsigned int free_list[FRAME_FREE_LIST_SIZE];   // May hold frames allocated again since - checked against the bitmap when taken
+    unsigned int free_list_count;
+    unsigned int free_frame_count;
+} frame_allocator;
+
+//typedef struct data_byte
+//{
+//    unsigned int data:8;
+//} data_byte;
+
+#ifndef TAG_ONLY_SIMULATION
+#define MAIN_MEMORY_BLOCK_DATA_SIZE 512
+#else
+#define MAIN_MEMORY_BLOCK_DATA_SIZE 1   // Frame data left out in tag-only simulation - one placeholder byte
+#endif
+
+typedef struct main_memory_block
+{
+    data_byte entry[MAIN_MEMORY_BLOCK_DATA_SIZE];
+} main_memory_block;
+
+// The simulated DRAM is one reserved, demand-zero region of NUM_FRAMES blocks (mmap with MAP_NORESERVE) - the host only backs the pages
+// that are written, frames never written read as zero. The host footprint follows the memory the simulation touches, not its size.
+#define MAIN_MEMORY_DRAM_SIZE ((size_t) NUM_FRAMES * sizeof(main_memory_block))
+
+// CLOCK main memory replacement - one reference bit per frame, the hand sweeps the allocated frames in frame number order
+typedef struct clock_replacement
+{
+    unsigned long long reference_bits[FRAME_BITMAP_WORDS];  // Bit set - frame referenced since the hand last passed it
+    unsigned int hand;                                      // Frame the next sweep starts from
+} clock_replacement;
+
+typedef struct main_memory
+{
+    frame_table f_table;
+    frame_allocator free_frames;
+    clock_replacement mm_clock;
+    // page_table* global_pages[1024];
+    page_table* p_tables[1024]; //CHANGED from 65536 to 1024//
+    page_table_lru_node* p_table_nodes[1024];   // Replacement queue node of each page table in p_tables
+    unsigned short free_p_table_slots[1024];    // p_tables slots of released page tables - reused before new slots
+    unsigned int num_free_p_table_slots;
+    main_memory_block* dram;    // Frame data - block i holds frame i (see MAIN_MEMORY_DRAM_SIZE)
+    unsigned int dram_mapped:1; // Reserved with mmap - 0 if the fallback calloc was used
+    unsigned int total_access_count;
+    unsigned int access_hit_count;
+} main_memory;
+
+
+main_memory* main_memory_init(simulator_context* ctx);
+data_byte* get_l1_block(simulator_context* ctx, unsigned int block_number/* physical address/block size */, unsigned int block_size); //called from l1 cache//
+data_byte* get_l2_block(simulator_context* ctx, unsigned int block_number/* physical address/block size */, unsigned int block_size, Proc_Access_Info* temp_pai); //called from l2 cache//;
+void write_to_main_memory(simulator_context* ctx, unsigned int physical_address, data_byte* write_data);
+void initialize_frame_allocator(frame_allocator* allocator);
+int allocate_frame(frame_allocator* allocator, unsigned int start_frame); //recently released frame, else lowest free frame from start_frame - -1 if memory is full//
+void release_frame(frame_allocator* allocator, unsigned int frame_number);
+void reference_mm_frame(main_memory* mm, unsigned int frame_number);
+int choose_mm_victim(simulator_context* ctx, int pid); //-1 for any process, returns -1 if no frame qualifies//
+void replace_mm_block(simulator_context* ctx, unsigned int frame_number);
+void main_memory_reset(simulator_context* ctx);
+void main_memory_free(simulator_context* ctx);
+
+
+#endif
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "simulator.h"
+#include "tlb.h"
+
+// Memory-full check - two processes each touch more distinct pages than fit in main memory together, re-reading one hot page after
+// every new one. The hot page stays in the TLBs while CLOCK evicts it from main memory (its L1 cache hits do not reference the frame),
+// so every translation is checked against the frame table: the frame must still hold the page of that process.
+
+#define CHECK_NUM_PROCESSES 2
+#define CHECK_PAGES_PER_PROCESS 32768         // 2 x 32768 pages > NUM_FRAMES
+#define CHECK_QUANTUM 64                      // New pages touched per context switch
+#define CHECK_DATA_BASE 0x10000000
+#define CHECK_HOT_ADDRESS 0x7fff0000
+
+// Simulates one access and checks its translation - returns 1 if the frame does not hold the translated page of the process. Checked
+// right away, as later page faults may legitimately reuse the frame.
+
+static int check_access (simulator_context *ctx, unsigned int logical_address, int access_type, PCB *pcb, Proc_Access_Info *access_info,
+                         int process) {
+    frame_table_entry *entry;
+    trace_info trace;
+
+    decode_trace (logical_address, &trace);
+    simulate_access_batch (ctx, &trace, &access_type, 1, pcb, access_info, process);
+
+    entry = &ctx->mm->f_table.entry_table[trace.frame_number];
+    return entry->valid_bit != VALID || entry->pid != (unsigned int) pcb->pid || entry->page_number != trace.page_number;
+}
+
+// Runs the access pattern with the TLBs flushed at context switches (tlb_asids 0) or ASID-tagged (tlb_asids 1) - returns the number of
+// stale translations.
+
+static int run_memory_full_check (unsigned int tlb_asids) {
+    memory_geometry geometry;
+    simulator_context *ctx;
+    PCB pcb[CHECK_NUM_PROCESSES] = { 0 };
+    Proc_Access_Info access_info[CHECK_NUM_PROCESSES];
+    int num_stale = 0;
+    int process = 0;
+    int first_page = 0;
+    int i = 0;
+
+    set_default_memory_geometry (&geometry);
+    geometry.tlb_asids = tlb_asids;
+    ctx = initialize_simulator_context (&geometry);
+    initialize_access_info_structs (access_info, CHECK_NUM_PROCESSES);
+    for (process = 0; process < CHECK_NUM_PROCESSES; process++) {
+        pcb[process].pid = process;
+        pcb[process].process_state = RUNNING;
+        pcb[process].page_dir_base_addr = page_dir_init ();
+    }
+
+    for (first_page = 0; first_page < CHECK_PAGES_PER_PROCESS; first_page += CHECK_QUANTUM) {
+        for (process = 0; process < CHECK_NUM_PROCESSES; process++) {
+            switch_TLB_address_space (ctx, pcb[process].pid);
+            for (i = first_page; i < first_page + CHECK_QUANTUM; i++) {
+                num_stale += check_access (ctx, CHECK_DATA_BASE + i * PAGE_SIZE, WRITE_ACCESS, &pcb[process], &access_info[process], process);
+                num_stale += check_access (ctx, CHECK_HOT_ADDRESS, READ_ACCESS, &pcb[process], &access_info[process], process);
+            }
+            leave_TLB_address_space (ctx);
+        }
+    }
+
+    for (process = 0; process < CHECK_NUM_PROCESSES; process++)
+        page_table_free (ctx, pcb[process].page_dir_base_addr);
+    free_simulator_context (ctx);
+    return num_stale;
+}
+
+int main () {
+    unsigned int tlb_asids = 0;
+    int num_stale = 0;
+    int num_failed = 0;
+
+    for (tlb_asids = 0; tlb_asids <= 1; tlb_asids++) {
+        num_stale = run_memory_full_check (tlb_asids);
+        printf (" Memory full, tlb_asids %u: %d stale translations - %s\n", tlb_asids, num_stale, num_stale == 0 ? "PASSED" : "FAILED");
+        if (num_stale != 0)
+            num_failed++;
+    }
+    return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
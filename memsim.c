@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memsim.h"
+#include "simulator.h"
+
+struct memsim {
+    memory_geometry geometry;
+    simulator_context *ctx;
+    int num_processes;
+    PCB *pcb;                                 // Only the pid and page directory of each process are used
+    Proc_Access_Info *access_info;            // Counts of the batch being simulated (int counters) - added to the stats after every batch
+    memsim_stats *stats;
+    int current_process;                      // Process of the latest access (-1 before the first access)
+};
+
+memsim* memsim_create (int num_processes) {
+    memsim *sim;
+    int i = 0;
+
+    if (num_processes <= 0 || num_processes > 65536)
+        return NULL;
+
+    sim = (memsim *) calloc (1, sizeof (memsim));
+    set_default_memory_geometry (&sim->geometry);
+    sim->ctx = initialize_simulator_context (&sim->geometry);
+    sim->num_processes = num_processes;
+    sim->current_process = -1;
+
+    sim->pcb = (PCB *) calloc (num_processes, sizeof (PCB));
+    for (i = 0; i < num_processes; i++) {
+        sim->pcb[i].pid = i;
+        sim->pcb[i].process_state = RUNNING;
+        sim->pcb[i].page_dir_base_addr = page_dir_init ();
+    }
+
+    sim->access_info = (Proc_Access_Info *) malloc (num_processes * sizeof (Proc_Access_Info));
+    initialize_access_info_structs (sim->access_info, num_processes);
+    sim->stats = (memsim_stats *) calloc (num_processes, sizeof (memsim_stats));
+
+    return sim;
+}
+
+// Replaces the TLBs and caches with ones of the given geometry. Main memory and the page tables are still empty at this point,
+// so the whole context is rebuilt.
+
+static int rebuild_memsim_context (memsim *sim, const memory_geometry *geometry) {
+    if (sim->current_process != -1) {
+        return -1;
+    }
+
+    sim->geometry = *geometry;
+    free_simulator_context (sim->ctx);
+    sim->ctx = initialize_simulator_context (&sim->geometry);
+    return 0;
+}
+
+int memsim_configure (memsim *sim, const char *settings) {
+    memory_geometry geometry = sim->geometry;
+
+    if (apply_memory_geometry_settings (settings, &geometry) < 0)
+        return -1;
+    return rebuild_memsim_context (sim, &geometry);
+}
+
+int memsim_load_geometry (memsim *sim, const char *filename) {
+    memory_geometry geometry = sim->geometry;
+
+    if (load_memory_geometry (filename, &geometry) < 0)
+        return -1;
+    return rebuild_memsim_context (sim, &geometry);
+}
+
+// Adds the batch counts of every process to its stats and clears them for the next batch.
+
+static void collect_memsim_stats (memsim *sim) {
+    Proc_Access_Info *info;
+    memsim_stats *stats;
+    int i = 0;
+
+    for (i = 0; i < sim->num_processes; i++) {
+        info = &sim->access_info[i];
+        stats = &sim->stats[i];
+
+        stats->num_l1_tlb_accesses += info->num_l1_tlb_accesses;
+        stats->num_l1_tlb_hits += info->num_l1_tlb_hits;
+        stats->num_l1_tlb_misses += info->num_l1_tlb_misses;
+        stats->num_l2_tlb_accesses += info->num_l2_tlb_accesses;
+        stats->num_l2_tlb_hits += info->num_l2_tlb_hits;
+        stats->num_l2_tlb_misses += info->num_l2_tlb_misses;
+        stats->num_l1_cache_accesses += info->num_l1_cache_accesses;
+        stats->num_l1_cache_hits += info->num_l1_cache_hits;
+        stats->num_l1_cache_misses += info->num_l1_cache_misses;
+        stats->num_l2_cache_accesses += info->num_l2_cache_accesses;
+        stats->num_l2_cache_hits += info->num_l2_cache_hits;
+        stats->num_l2_cache_misses += info->num_l2_cache_misses;
+        stats->num_main_memory_accesses += info->num_main_memory_accesses;
+        stats->num_main_memory_hits += info->num_main_memory_hits;
+        stats->num_main_memory_misses += info->num_main_memory_misses;
+    }
+    initialize_access_info_structs (sim->access_info, sim->num_processes);
+}
+
+// Simulates the gathered accesses of the current process.
+
+static void simulate_memsim_batch (memsim *sim, trace_info *traces, const int *access_types, int num_traces) {
+    int process = sim->current_process;
+
+    simulate_access_batch (sim->ctx, traces, access_types, num_traces, &sim->pcb[process], &sim->access_info[process], process);
+}
+
+int memsim_access_batch (memsim *sim, const memsim_access *accesses, unsigned int num_accesses) {
+    trace_info traces[TLB_BATCH_MAX];
+    int access_types[TLB_BATCH_MAX];
+    int num_traces = 0;
+    int process = 0;
+    int retval = 0;
+    unsigned int k = 0;
+
+    for (k = 0; k < num_accesses; k++) {
+        process = accesses[k].process;
+        if (process >= sim->num_processes) {
+            retval = -1;
+            break;
+        }
+
+        // Only the data and instruction regions have page tables
+        if (get_page_directory_index (accesses[k].logical_address >> 9) < 0) {
+            retval = -1;
+            break;
+        }
+
+        // A run of accesses of one process is simulated as one batch - it ends at a context switch or once the batch is full
+        if (num_traces == TLB_BATCH_MAX || (num_traces > 0 && process != sim->current_process)) {
+            simulate_memsim_batch (sim, traces, access_types, num_traces);
+            num_traces = 0;
+        }
+
+        // Context switch - the TLBs are flushed (retaining all shared entries), or with ASIDs switched to the address space of the process
+        if (process != sim->current_process) {
+            if (sim->current_process != -1) {
+                leave_TLB_address_space (sim->ctx);
+                sim->stats[process].num_context_switches++;
+            }
+            switch_TLB_address_space (sim->ctx, sim->pcb[process].pid);
+            sim->current_process = process;
+        }
+
+        decode_trace (accesses[k].logical_address, &traces[num_traces]);
+        access_types[num_traces] = (accesses[k].access_type == MEMSIM_WRITE) ? WRITE_ACCESS : READ_ACCESS;
+        num_traces++;
+        sim->stats[process].num_accesses++;
+    }
+    if (num_traces > 0)
+        simulate_memsim_batch (sim, traces, access_types, num_traces);
+
+    collect_memsim_stats (sim);
+    return retval;
+}
+
+// Adds the counters of one process to the given stats.
+
+static void add_memsim_stats (memsim_stats *sum, const memsim_stats *stats) {
+    sum->num_accesses += stats->num_accesses;
+    sum->num_context_switches += stats->num_context_switches;
+    sum->num_l1_tlb_accesses += stats->num_l1_tlb_accesses;
+    sum->num_l1_tlb_hits += stats->num_l1_tlb_hits;
+    sum->num_l1_tlb_misses += stats->num_l1_tlb_misses;
+    sum->num_l2_tlb_accesses += stats->num_l2_tlb_accesses;
+    sum->num_l2_tlb_hits += stats->num_l2_tlb_hits;
+    sum->num_l2_tlb_misses += stats->num_l2_tlb_misses;
+    sum->num_l1_cache_accesses += stats->num_l1_cache_accesses;
+    sum->num_l1_cache_hits += stats->num_l1_cache_hits;
+    sum->num_l1_cache_misses += stats->num_l1_cache_misses;
+    sum->num_l2_cache_accesses += stats->num_l2_cache_accesses;
+    sum->num_l2_cache_hits += stats->num_l2_cache_hits;
+    sum->num_l2_cache_misses += stats->num_l2_cache_misses;
+    sum->num_main_memory_accesses += stats->num_main_memory_accesses;
+    sum->num_main_memory_hits += stats->num_main_memory_hits;
+    sum->num_main_memory_misses += stats->num_main_memory_misses;
+}
+
+int memsim_get_stats (const memsim *sim, int process, memsim_stats *stats) {
+    int i = 0;
+
+    if (process < -1 || process >= sim->num_processes)
+        return -1;
+
+    *stats = (memsim_stats) {0};
+    for (i = 0; i < sim->num_processes; i++) {
+        if (process == -1 || process == i)
+            add_memsim_stats (stats, &sim->stats[i]);
+    }
+
+    if (stats->num_main_memory_accesses > 0)
+        stats->page_fault_frequency = (double) stats->num_main_memory_misses / (double) stats->num_main_memory_accesses;
+    return 0;
+}
+
+void memsim_reset (memsim *sim) {
+    int i = 0;
+    int j = 0;
+
+    // The page directory entries of the processes point to page tables of the context - all invalid again
+    for (i = 0; i < sim->num_processes; i++) {
+        for (j = 0; j < 128; j++)
+            sim->pcb[i].page_dir_base_addr->entry_table[j].valid_bit = INVALID;
+    }
+
+    reset_simulator_context (sim->ctx);
+    initialize_access_info_structs (sim->access_info, sim->num_processes);
+    memset (sim->stats, 0, sim->num_processes * sizeof (memsim_stats));
+    sim->current_process = -1;
+}
+
+void memsim_destroy (memsim *sim) {
+    int i = 0;
+
+    for (i = 0; i < sim->num_processes; i++)
+        page_table_free (sim->ctx, sim->pcb[i].page_dir_base_addr);
+
+    free_simulator_context (sim->ctx);
+    free (sim->pcb);
+    free (sim->access_info);
+    free (sim->stats);
+    free (sim);
+}
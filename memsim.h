@@ -0,0 +1,91 @@
+#ifndef MEMSIM_H
+#define MEMSIM_H
+
+// MEMORY SUBSYSTEM SIMULATOR LIBRARY
+
+// Embeds the simulator (TLBs, page tables, L1 / L2 caches and main memory) in another program, e.g. a tracing tool that pushes the
+// addresses it collects in batches instead of writing them to trace files. Built as libmemsim.a / libmemsim.so (make lib).
+//
+//     memsim *sim = memsim_create (num_processes);
+//     memsim_configure (sim, "l1_cache_ways 8 l2_cache_sets 32");      // optional - before the first access
+//     memsim_access_batch (sim, accesses, num_accesses);               // as often as needed
+//     memsim_get_stats (sim, process, &stats);
+//     memsim_reset (sim);                                              // optional - to simulate another run from scratch
+//     memsim_destroy (sim);
+//
+// This header is self-contained - the simulator structures stay private to the library.
+
+// Access types
+#define MEMSIM_READ 0
+#define MEMSIM_WRITE 1
+
+// MEMSIM ADT DEFINITIONS
+
+typedef struct memsim memsim;
+
+// One memory access. The logical address follows the trace file address series - instruction (7f...) or data (10...) - which selects
+// the L1 instruction or data cache. Instruction accesses are always reads. Addresses outside these regions (0x10000000 - 0x10ffffff
+// and 0x7f000000 - 0x7fffffff) are rejected.
+typedef struct {
+    unsigned int logical_address;
+    unsigned short process;                    // Index of the process (0 .. num_processes - 1) the address belongs to
+    unsigned char access_type;                 // MEMSIM_READ or MEMSIM_WRITE
+    unsigned char reserved;
+} memsim_access;
+
+// Access stats of one process (or of all processes)
+typedef struct {
+    unsigned long long num_accesses;
+    unsigned long long num_context_switches;   // Switches to this process from another one - the TLBs are flushed (shared entries retained) unless
+                                               // ASIDs are configured ("tlb_asids 1")
+
+    unsigned long long num_l1_tlb_accesses;
+    unsigned long long num_l1_tlb_hits;
+    unsigned long long num_l1_tlb_misses;
+
+    unsigned long long num_l2_tlb_accesses;
+    unsigned long long num_l2_tlb_hits;
+    unsigned long long num_l2_tlb_misses;
+
+    unsigned long long num_l1_cache_accesses;
+    unsigned long long num_l1_cache_hits;
+    unsigned long long num_l1_cache_misses;
+
+    unsigned long long num_l2_cache_accesses;
+    unsigned long long num_l2_cache_hits;
+    unsigned long long num_l2_cache_misses;
+
+    unsigned long long num_main_memory_accesses;
+    unsigned long long num_main_memory_hits;
+    unsigned long long num_main_memory_misses;   // Page faults
+    double page_fault_frequency;
+} memsim_stats;
+
+// FUNCTION DECLARATIONS
+
+// Creates a simulator for the given number of processes with the default TLB / cache geometry - returns NULL on error
+memsim* memsim_create (int num_processes);
+
+// Applies geometry "<key> <value>" pairs (the keys of geometry files, e.g. "l2_cache_ways 16") and rebuilds the TLBs and caches.
+// Returns 0 on success, -1 on an invalid setting (described on stderr) or once accesses have been simulated (the simulator is left unchanged)
+int memsim_configure (memsim *sim, const char *settings);
+
+// Reads a geometry file on top of the current geometry and rebuilds the TLBs and caches - same rules as memsim_configure
+int memsim_load_geometry (memsim *sim, const char *filename);
+
+// Simulates the accesses in order. An access of a process other than the previous access's is a context switch.
+// Returns 0 on success, -1 if an access names an unknown process or an address outside the regions (the accesses before it are simulated)
+int memsim_access_batch (memsim *sim, const memsim_access *accesses, unsigned int num_accesses);
+
+// Gets the stats of the given process, or the sums over all processes if process is -1 - returns -1 on an unknown process
+int memsim_get_stats (const memsim *sim, int process, memsim_stats *stats);
+
+// Empties the simulator for the next run with the same geometry - cold TLBs and caches, empty main memory and page tables, zero stats.
+// Much cheaper than destroying and creating a simulator (the page table slabs and the main memory region are kept). The geometry can be
+// changed again afterwards.
+void memsim_reset (memsim *sim);
+
+// Frees the simulator
+void memsim_destroy (memsim *sim);
+
+#endif
@@ -1,9 +1,12 @@
 #include <unistd.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "pagetable.h"
 #include "mainmemory.h"
 #include "processes.h"
+#include "simulator.h"
 
 #define PAGE_TABLE_LIMIT 1019
 #define DIRECTORY 1
@@ -30,53 +33,60 @@ typedef struct Proc_Access_Info
 } Proc_Access_Info; */
 //////
 
-main_memory* mm;
-page_table_lru_queue page_table_lru;
-int total_page_count;
-int page_table_index;
-int frame_table_index;
+// The main memory, page table LRU queue and counters are part of the simulator context (simulator.h)
 
-extern main_memory_block get_disk_block(unsigned int block_number, unsigned int pid);
-
-page_table_lru_queue page_table_lru_init()
+page_table_lru_queue page_table_lru_init(simulator_context* ctx)
 {
-    page_table_lru.head = (page_table_lru_node*)malloc(sizeof(page_table_lru_node));
-    page_table_lru.tail = (page_table_lru_node*)malloc(sizeof(page_table_lru_node));
-    page_table_lru.head->next = page_table_lru.tail;
-    page_table_lru.head->prev = NULL;
-    page_table_lru.tail->next = NULL;
-    page_table_lru.tail->prev = page_table_lru.head;
-    return page_table_lru;
+    ctx->page_table_lru.head = (page_table_lru_node*)slab_alloc(&(ctx->page_table_lru_slab));
+    ctx->page_table_lru.tail = (page_table_lru_node*)slab_alloc(&(ctx->page_table_lru_slab));
+    ctx->page_table_lru.head->next = ctx->page_table_lru.tail;
+    ctx->page_table_lru.head->prev = NULL;
+    ctx->page_table_lru.tail->next = NULL;
+    ctx->page_table_lru.tail->prev = ctx->page_table_lru.head;
+    return ctx->page_table_lru;
 }
 
-void invalidate_page(unsigned int p_table_index)
+void invalidate_page(simulator_context* ctx, unsigned int p_table_index)
 {
     // printf("invalidating page");
-    page_table* p_table = mm->p_tables[p_table_index];
+    page_table* p_table = ctx->mm->p_tables[p_table_index];
     for(int i=0;i<128;i++)
     {
         if(p_table->entry_table[i].valid_bit==VALID)
         {
             if(p_table->granularity==1)
             {
-                invalidate_page(p_table->entry_table[i].pageframe.p_table_index);
+                // The page table is empty now - released right away, so no table outlives the directory entry pointing to it
+                invalidate_page(ctx, p_table->entry_table[i].pageframe.p_table_index);
+                replace_page_table(ctx, ctx->mm->p_table_nodes[p_table->entry_table[i].pageframe.p_table_index]);
+            }
+            else //page - its frame is free again, and no TLB may translate to it
+            {
+                invalidate_TLB_page(ctx->l1_tlb, ctx->l2_tlb, ctx->mm->f_table.entry_table[p_table->entry_table[i].pageframe.frame_num].page_number, p_table->entry_table[i].pageframe.frame_num);
+                ctx->mm->f_table.entry_table[p_table->entry_table[i].pageframe.frame_num].valid_bit=INVALID;
+                release_frame(&(ctx->mm->free_frames), p_table->entry_table[i].pageframe.frame_num);
             }
-            p_table->entry_table[i].valid_bit==INVALID;
+            p_table->entry_table[i].valid_bit=INVALID;
         }
     }
     return;
 }
 
-void replace_page_table(page_table_lru_node* replaced)
+// Unlinks the page table from the replacement queue and frees it - its p_tables slot is free for the next page table
+void replace_page_table(simulator_context* ctx, page_table_lru_node* replaced)
 {
     //INVALIDATE ENTRIES
     // printf("replace page table called");
+    main_memory* mm = ctx->mm;
     page_table_lru_node* temp = replaced->prev;
     temp->next=replaced->next;
     temp = replaced->next;
     temp->prev=replaced->prev;
-    free(replaced->data);
-    free(replaced);
+    mm->p_tables[replaced->p_table_index] = NULL;
+    mm->p_table_nodes[replaced->p_table_index] = NULL;
+    mm->free_p_table_slots[mm->num_free_p_table_slots++] = replaced->p_table_index;
+    slab_free(&(ctx->page_table_slab), replaced->data);
+    slab_free(&(ctx->page_table_lru_slab), replaced);
 }
 
 page_table* page_dir_init()
@@ -84,101 +94,96 @@ page_table* page_dir_init()
     page_table* page_dir = (page_table*)malloc(sizeof(page_table));
     for(int i=0;i<128;i++)
     {
-        page_dir->entry_table[i].valid_bit = INVALID;
+        page_dir->entry_table[i] = (page_table_entry){0};
     }
     page_dir->granularity = DIRECTORY;
     return page_dir;
 }
 
-page_table_lru_node* page_table_init(/*should take block number as arg*/)
+page_table_lru_node* page_table_init(simulator_context* ctx/*should take block number as arg*/)
 {
     // printf("page table init called\n");
     // increment page access    
     // increment page miss
-    page_table* p_table = (page_table*)malloc(sizeof(page_table));
-    page_table_lru_node* ptln = (page_table_lru_node*)malloc(sizeof(page_table_lru_node));
+    main_memory* mm = ctx->mm;
+    page_table* p_table = (page_table*)slab_alloc(&(ctx->page_table_slab));
+    page_table_lru_node* ptln = (page_table_lru_node*)slab_alloc(&(ctx->page_table_lru_slab));
     ptln->data = p_table;
-    ptln->prev = page_table_lru.head;
-    ptln->next = page_table_lru.head->next;
-    page_table_lru.head->next = ptln;
-    page_table_lru_node* temp = ptln->next;
-    temp->prev = ptln;
-    page_table_index++;
-    total_page_count++;
-    frame_table_index++;
-    if(page_table_index>PAGE_TABLE_LIMIT)
+    ptln->parent_entry = NULL;
+    if(mm->num_free_p_table_slots==0 && ctx->page_table_index>=PAGE_TABLE_LIMIT)
     {
-        page_table_lru_node* replaced = page_table_lru.tail->prev;
-        invalidate_page(replaced->p_table_index);
-        replace_page_table(replaced);
+        // All page table slots used - the least recently allocated page table (not directory) is replaced and its slot reused.
+        // Page directories are never replaced (at most 4 per process), and a page table is released as soon as its directory
+        // entry is invalidated, so the parent entry of a queued page table always points to it.
+        page_table_lru_node* replaced = ctx->page_table_lru.tail->prev;
+        while(replaced->data->granularity!=TABLE)
+        {
+            replaced = replaced->prev;
+        }
+        invalidate_page(ctx, replaced->p_table_index);
+        replaced->parent_entry->valid_bit = INVALID;
+        replace_page_table(ctx, replaced);
     }
-    ptln->p_table_index=page_table_index;
-    
-    //initialize entries//
-    for(int i=0;i<128;i++)
+    if(mm->num_free_p_table_slots>0)
+    {
+        ptln->p_table_index = mm->free_p_table_slots[--mm->num_free_p_table_slots];
+    }
+    else
     {
-        (*p_table).entry_table[i].valid_bit = INVALID;
+        ctx->page_table_index++;
+        ctx->total_page_count++;
+        ptln->p_table_index=ctx->page_table_index;
     }
+    mm->p_tables[ptln->p_table_index] = p_table;   // Page table walks find the table by its index
+    mm->p_table_nodes[ptln->p_table_index] = ptln;
+    ptln->prev = ctx->page_table_lru.head;
+    ptln->next = ctx->page_table_lru.head->next;
+    ctx->page_table_lru.head->next = ptln;
+    page_table_lru_node* temp = ptln->next;
+    temp->prev = ptln;
+    
+    //initialize entries - whole entries, a slab object holds whatever the table it was last used for left in it//
+    memset(p_table->entry_table, 0, sizeof(p_table->entry_table));
     return ptln;
     // return p_table;
 }
 
-page_table_entry *get_page_entry(unsigned int block_number /*virtual address*/, PCB* temp_pcb, Proc_Access_Info* temp_pai) //page table walk
+int get_page_directory_index(unsigned int block_number /*virtual address*/)
+{
+    unsigned int outerindex = block_number >> 14;
+    // 10 addresses map to 00 and 01, 7f addresses map to 10 and 11
+    if(outerindex==32) return 0;
+    else if(outerindex==33) return 1;
+    else if(outerindex==254) return 2;
+    else if(outerindex==255) return 3;
+    return -1; //INVALID entry
+}
+
+page_table_entry *get_page_entry(simulator_context* ctx, unsigned int block_number /*virtual address*/, PCB* temp_pcb, Proc_Access_Info* temp_pai) //page table walk
 {
+    main_memory* mm = ctx->mm;
     // printf("get page entry called\n");
     page_table* outer = temp_pcb->page_dir_base_addr;
     unsigned int middle, inner;
-    unsigned int outerindex = block_number >> 14;
-    // 10 addresses map to 00 and 01
-    if(outerindex==32) 
-    {
-        if(outer->entry_table[0].valid_bit==INVALID)
-        {
-            // fetch page directory
-            page_table_lru_node* temp = page_table_init(); //removes lru node from within
-            temp->data->granularity = DIRECTORY;
-
-            outer->entry_table[0].pageframe.p_table_index = temp->p_table_index;
-            temp_pai->num_main_memory_misses++;
-        }
-        temp_pai->num_main_memory_hits++;
-        middle = outer->entry_table[0].pageframe.p_table_index;
-    }
-    else if(outerindex==33) 
+    int outerentry = get_page_directory_index(block_number);
+    if(outerentry<0) //INVALID entry
     {
-        if(outer->entry_table[1].valid_bit==INVALID)
-        {
-            // fetch page directory
-            page_table_lru_node* temp = page_table_init(); //removes lru node from within
-            temp->data->granularity = DIRECTORY;
-
-            outer->entry_table[0].pageframe.p_table_index = temp->p_table_index;
-            temp_pai->num_main_memory_misses++;
-        }
-        temp_pai->num_main_memory_hits++;
-        middle = outer->entry_table[1].pageframe.p_table_index;
+        // printf("invalid entry\n");
+        return NULL;
     }
-    // 7f addresses map to 10 and 11
-    else if(outerindex==254) middle = outer->entry_table[2].pageframe.p_table_index; //Never occurs
-    else if(outerindex==255) 
+    if(outer->entry_table[outerentry].valid_bit==INVALID)
     {
-        if(outer->entry_table[3].valid_bit==INVALID)
-        {
-            // fetch page directory
-            page_table_lru_node* temp = page_table_init(); //removes lru node from within
-            temp->data->granularity = DIRECTORY;
+        // fetch page directory
+        page_table_lru_node* temp = page_table_init(ctx); //removes lru node from within
+        temp->data->granularity = DIRECTORY;
+        temp->parent_entry = &(outer->entry_table[outerentry]);
 
-            outer->entry_table[0].pageframe.p_table_index = temp->p_table_index;
-            temp_pai->num_main_memory_misses++;
-        }
-        temp_pai->num_main_memory_hits++;
-        middle = outer->entry_table[3].pageframe.p_table_index;
-    }
-    else //INVALID entry
-    {
-        // printf("invalid entry\n");
-        return NULL;
+        outer->entry_table[outerentry].pageframe.p_table_index = temp->p_table_index;
+        outer->entry_table[outerentry].valid_bit = VALID;
+        temp_pai->num_main_memory_misses++;
     }
+    temp_pai->num_main_memory_hits++;
+    middle = outer->entry_table[outerentry].pageframe.p_table_index;
 
     // Middle level
     // Each entry in outer level points to a page directory with 128 entries each
@@ -186,10 +191,12 @@ page_table_entry *get_page_entry(unsigned int block_number /*virtual address*/,
     if(mm->p_tables[middle]->entry_table[middleindex].valid_bit==INVALID)
     {
         //fetch page table
-        page_table_lru_node* temp = page_table_init(); //removes lru node from within
+        page_table_lru_node* temp = page_table_init(ctx); //removes lru node from within
         temp->data->granularity = TABLE;
+        temp->parent_entry = &(mm->p_tables[middle]->entry_table[middleindex]);
 
         mm->p_tables[middle]->entry_table[middleindex].pageframe.p_table_index = temp->p_table_index;
+        mm->p_tables[middle]->entry_table[middleindex].valid_bit = VALID;
         temp_pai->num_main_memory_misses++;
     }
     temp_pai->num_main_memory_hits++;
@@ -208,30 +215,28 @@ page_table_entry *get_page_entry(unsigned int block_number /*virtual address*/,
     //Go to the table whose adress was found (inner), get the required entry (frameindex), return its pointer
     if(mm->p_tables[inner]->entry_table[frameindex].valid_bit==INVALID)
     {
-        //fetch block
-        unsigned int index = frame_table_index;
-        while(mm->f_table.entry_table[index]->valid_bit==VALID) //looking for INVALID entry to remove
+        //fetch block - free frame from the frame allocator (page tables live outside main memory, every frame holds data)
+        int index = allocate_frame(&(mm->free_frames), 0);
+        if(index<0)
         {
-            index++;
+            // Main memory full - the page in the CLOCK victim frame is evicted and the frame reused
+            replace_mm_block(ctx, choose_mm_victim(ctx, -1));
+            ctx->total_page_count--;
+            index = allocate_frame(&(mm->free_frames), 0);
         }
-        // main_memory_block temp = get_disk_block(index, temp_pcb->pid);
-        main_memory_block mm_block = *(main_memory_block*)malloc(sizeof(main_memory_block));
-        second_chance_node* scn = (second_chance_node*)malloc(sizeof(second_chance_node));
-        scn->data = &mm_block;
-        scn->block_number = index;
-        scn->prev = second_chance_fifo->head;
-        scn->next = second_chance_fifo->head->next;
-        second_chance_fifo->head->next = scn;
-        scn->next->prev = scn;
-        scn->second_chance_bit=1;
-        mm->f_table.entry_table[index]->valid_bit=VALID;
-        mm->f_table.entry_table[index]->frame_number=block_number;
-        mm->f_table.entry_table[index]->pid=temp_pcb->pid;
+        // The block of the frame is part of the reserved DRAM region - nothing to allocate
+        reference_mm_frame(mm, index);
+        mm->f_table.entry_table[index].valid_bit=VALID;
+        mm->f_table.entry_table[index].pid=temp_pcb->pid;
 
-        total_page_count++;
+        ctx->total_page_count++;
 //        temp_pcb->page_count++;
         temp_pai->num_main_memory_misses++;
-        mm->f_table.entry_table[index]->page_number=block_number;
+        mm->f_table.entry_table[index].page_number=block_number;
+        mm->f_table.entry_table[index].pte_table_index=inner;
+        mm->f_table.entry_table[index].pte_entry_index=frameindex;
+        mm->p_tables[inner]->entry_table[frameindex].pageframe.frame_num = index;
+        mm->p_tables[inner]->entry_table[frameindex].valid_bit = VALID;
     }
     temp_pai->num_main_memory_hits++;
     retval = &(mm->p_tables[inner]->entry_table[frameindex]);
@@ -239,20 +244,17 @@ page_table_entry *get_page_entry(unsigned int block_number /*virtual address*/,
     return retval;
 }
 
-void page_table_free(page_table* p_table)
+void page_table_free(simulator_context* ctx, page_table* p_table)
 {
     // printf("invalidating page");
+    // The page directories and tables below the page directory of the process belong to main memory - they are invalidated and released
     for(int i=0;i<128;i++)
     {
         if(p_table->entry_table[i].valid_bit==VALID)
         {
-            if(p_table->granularity==1)
-            {
-                invalidate_page(p_table->entry_table[i].pageframe.p_table_index);
-                unsigned int temp = p_table->entry_table[i].pageframe.p_table_index;
-                page_table_free(mm->p_tables[temp]);
-            }
-            p_table->entry_table[i].valid_bit==INVALID;
+            invalidate_page(ctx, p_table->entry_table[i].pageframe.p_table_index);
+            replace_page_table(ctx, ctx->mm->p_table_nodes[p_table->entry_table[i].pageframe.p_table_index]);
+            p_table->entry_table[i].valid_bit=INVALID;
         }
     }
     free(p_table);
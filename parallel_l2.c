@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "parallel_l2.h"
+
+// L2 entries are filled with this block on a miss - the L1 caches are filled from main memory directly, so the L2 data is never read
+static data_byte parallel_L2_fill_block [PAGE_SIZE];
+
+// Worker thread of a shard - simulates the queued L1 misses and write backs in the L2 sets of the shard, in queue order. When the queue is empty it yields
+// the CPU until the simulation thread pushes more misses (or asks it to stop).
+
+static void* parallel_L2_worker_thread (void *arg) {
+    parallel_L2_shard *shard = (parallel_L2_shard *) arg;
+    parallel_L2_cache *parallel_l2 = shard->parallel_l2;
+    unsigned long tail = atomic_load_explicit (&shard->tail, memory_order_relaxed);
+    parallel_L2_request *request;
+    parallel_L2_stats *stats;
+
+    while (1) {
+        if (tail == atomic_load_explicit (&shard->head, memory_order_acquire)) {
+            if (atomic_load_explicit (&parallel_l2->stop, memory_order_acquire) &&
+                tail == atomic_load_explicit (&shard->head, memory_order_acquire))
+                break;
+            sched_yield ();
+            continue;
+        }
+
+        request = &shard->requests[tail % PARALLEL_L2_QUEUE_SIZE];
+        stats = &shard->stats[request->process];
+
+        // Dirty L1 block write back - updates the L2 entry and its replacement state if present, not counted as an L2 access (as in the
+        // serial simulation)
+        if (request->access_type == WRITE_ACCESS)
+            search_L2_cache (parallel_l2->l2_cache, request->physical_address, parallel_L2_fill_block, WRITE_ACCESS);
+
+        // L2 cache hit - nothing else to do, the L1 cache already got the block
+        else if (search_L2_cache (parallel_l2->l2_cache, request->physical_address, NULL, READ_ACCESS) != NULL) {
+            stats->num_l2_cache_accesses++;
+            stats->num_l2_cache_hits++;
+        }
+
+        // L2 cache miss - the block is fetched from main memory
+        else {
+            stats->num_l2_cache_accesses++;
+            stats->num_l2_cache_misses++;
+            stats->num_main_memory_accesses++;
+            update_L2_cache (parallel_l2->l2_cache, parallel_L2_fill_block, request->physical_address);
+        }
+
+        // Hand the slot back - the release store also publishes the stats updated above to merge_parallel_L2_stats
+        tail++;
+        atomic_store_explicit (&shard->tail, tail, memory_order_release);
+    }
+
+    return NULL;
+}
+
+// Sets up the shards and starts their worker threads.
+
+parallel_L2_cache* start_parallel_L2_cache (L2_cache *l2_cache, int num_shards, int num_processes) {
+    parallel_L2_cache *parallel_l2;
+    parallel_L2_shard *shard;
+    int i = 0;
+
+    // Power of 2 number of shards, each owning a contiguous range of sets (neighbouring sets share host cache lines)
+    if (num_shards > MAX_PARALLEL_L2_SHARDS)
+        num_shards = MAX_PARALLEL_L2_SHARDS;
+    if ((unsigned int) num_shards > l2_cache->geometry.num_sets)
+        num_shards = l2_cache->geometry.num_sets;
+    if (num_shards < 1) {
+        fprintf(stderr, " ERROR: The parallel L2 cache needs at least 1 worker thread\n");
+        return NULL;
+    }
+    num_shards = 1 << (31 - __builtin_clz ((unsigned int) num_shards));
+
+    parallel_l2 = (parallel_L2_cache *) malloc (sizeof (parallel_L2_cache));
+    parallel_l2->l2_cache = l2_cache;
+    parallel_l2->num_processes = num_processes;
+    parallel_l2->num_shards = num_shards;
+    parallel_l2->shard_shift = l2_cache->geometry.set_index_bits - __builtin_ctz ((unsigned int) num_shards);
+    atomic_init (&parallel_l2->stop, 0);
+    parallel_l2->shards = (parallel_L2_shard *) aligned_alloc (HOST_CACHE_LINE_SIZE, num_shards * sizeof (parallel_L2_shard));
+
+    for (i = 0; i < num_shards; i++) {
+        shard = &parallel_l2->shards[i];
+        atomic_init (&shard->head, 0);
+        atomic_init (&shard->tail, 0);
+        shard->parallel_l2 = parallel_l2;
+        shard->stats = (parallel_L2_stats *) calloc (num_processes, sizeof (parallel_L2_stats));
+
+        if (pthread_create (&shard->worker_thread, NULL, parallel_L2_worker_thread, shard) != 0) {
+            fprintf(stderr, " ERROR: Could not start the parallel L2 worker threads\n");
+            exit (-1);
+        }
+    }
+
+    return parallel_l2;
+}
+
+void enqueue_L2_cache_access (parallel_L2_cache *parallel_l2, unsigned int physical_address, int access_type, int process) {
+    L2_cache *l2_cache = parallel_l2->l2_cache;
+    unsigned int set_index = (physical_address >> l2_cache->geometry.offset_bits) & l2_cache->geometry.set_index_mask;
+    parallel_L2_shard *shard = &parallel_l2->shards[set_index >> parallel_l2->shard_shift];
+    unsigned long head = atomic_load_explicit (&shard->head, memory_order_relaxed);
+    parallel_L2_request *request;
+
+    // Queue full - wait for the worker thread of the shard to catch up
+    while (head - atomic_load_explicit (&shard->tail, memory_order_acquire) == PARALLEL_L2_QUEUE_SIZE)
+        sched_yield ();
+
+    request = &shard->requests[head % PARALLEL_L2_QUEUE_SIZE];
+    request->physical_address = physical_address;
+    request->process = (unsigned int) process;
+    request->access_type = access_type;
+
+    // Publish the request - the release store makes its contents visible before the new head
+    atomic_store_explicit (&shard->head, head + 1, memory_order_release);
+}
+
+// Waits for every shard to empty its queue, then moves the per shard stats into the access info structs. The workers are idle while
+// their queue is empty, so the stats can be read and reset here.
+
+void merge_parallel_L2_stats (parallel_L2_cache *parallel_l2, Proc_Access_Info *proc_access_info) {
+    parallel_L2_shard *shard;
+    parallel_L2_stats *stats;
+    int i = 0;
+    int p = 0;
+
+    for (i = 0; i < parallel_l2->num_shards; i++) {
+        shard = &parallel_l2->shards[i];
+        while (atomic_load_explicit (&shard->tail, memory_order_acquire) != atomic_load_explicit (&shard->head, memory_order_relaxed))
+            sched_yield ();
+
+        for (p = 0; p < parallel_l2->num_processes; p++) {
+            stats = &shard->stats[p];
+            proc_access_info[p].num_l2_cache_accesses += stats->num_l2_cache_accesses;
+            proc_access_info[p].num_l2_cache_hits += stats->num_l2_cache_hits;
+            proc_access_info[p].num_l2_cache_misses += stats->num_l2_cache_misses;
+            proc_access_info[p].num_main_memory_accesses += stats->num_main_memory_accesses;
+        }
+        memset (shard->stats, 0, parallel_l2->num_processes * sizeof (parallel_L2_stats));
+    }
+
+    // Page fault frequencies are checked with the merged main memory access counts
+    for (p = 0; p < parallel_l2->num_processes; p++) {
+        if (proc_access_info[p].num_main_memory_accesses > 0)
+            proc_access_info[p].page_fault_frequency = (double)proc_access_info[p].num_main_memory_misses/(double)proc_access_info[p].num_main_memory_accesses;
+    }
+}
+
+void stop_parallel_L2_cache (parallel_L2_cache *parallel_l2) {
+    int i = 0;
+
+    atomic_store_explicit (&parallel_l2->stop, 1, memory_order_release);
+    for (i = 0; i < parallel_l2->num_shards; i++) {
+        pthread_join (parallel_l2->shards[i].worker_thread, NULL);
+        free (parallel_l2->shards[i].stats);
+    }
+    free (parallel_l2->shards);
+    free (parallel_l2);
+}
@@ -0,0 +1,75 @@
+#ifndef PARALLEL_L2_H
+#define PARALLEL_L2_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "cache.h"
+#include "processes.h"
+#include "trace_prefetch.h"
+
+// PARALLEL L2 MACROS
+
+// The sets of the L2 cache are independent, so the L1 miss stream can be simulated in the L2 cache by several worker threads at once.
+// The sets are split into contiguous ranges (shards), one per worker thread. The simulation thread pushes every L1 miss into the queue of
+// the shard owning its set - each set is only ever touched by one worker, in the order of the misses. L1 caches are filled straight from
+// main memory (the L2 cache would return the same data), so the simulation thread never waits for the L2 lookup.
+
+// L1 misses buffered per shard (power of 2 so that queue indices wrap with a mask)
+#define PARALLEL_L2_QUEUE_SIZE 4096
+
+#define MAX_PARALLEL_L2_SHARDS 64
+
+// PARALLEL L2 ADT DEFINITIONS
+
+// L1 miss (READ_ACCESS) or dirty L1 block write back (WRITE_ACCESS) forwarded to the L2 cache
+typedef struct {
+    unsigned int physical_address;
+    unsigned int process;                                     // Index of the process in the access info array
+    int access_type;
+} parallel_L2_request;
+
+// L2 access stats of one process, gathered by one shard
+typedef struct {
+    int num_l2_cache_accesses;
+    int num_l2_cache_hits;
+    int num_l2_cache_misses;
+    int num_main_memory_accesses;                             // Main memory is accessed on every L2 miss
+} parallel_L2_stats;
+
+typedef struct parallel_L2_cache parallel_L2_cache;
+
+// Single-producer single-consumer queue of one shard (like the trace prefetch ring). The simulation thread is the only producer (advances head),
+// the worker thread of the shard the only consumer (advances tail).
+typedef struct {
+    _Alignas (HOST_CACHE_LINE_SIZE) atomic_ulong head;       // Number of requests pushed so far - written by the simulation thread only
+    _Alignas (HOST_CACHE_LINE_SIZE) atomic_ulong tail;       // Number of requests simulated so far - written by the worker thread only
+    _Alignas (HOST_CACHE_LINE_SIZE) parallel_L2_cache *parallel_l2;
+    parallel_L2_stats *stats;                                 // Per process stats gathered since the last merge
+    pthread_t worker_thread;
+    parallel_L2_request requests [PARALLEL_L2_QUEUE_SIZE];
+} parallel_L2_shard;
+
+struct parallel_L2_cache {
+    L2_cache *l2_cache;
+    int num_processes;
+    int num_shards;                                           // Power of 2, at most the number of L2 sets
+    unsigned int shard_shift;                                 // set index >> shard_shift gives the shard owning the set
+    atomic_int stop;                                          // Set to make the worker threads quit once their queues are empty
+    parallel_L2_shard *shards;
+};
+
+// FUNCTION DECLARATIONS
+
+// Starts num_shards worker threads (rounded down to a power of 2 and the number of L2 sets) simulating the given L2 cache - returns NULL on error
+parallel_L2_cache* start_parallel_L2_cache (L2_cache *l2_cache, int num_shards, int num_processes);
+
+// Queues an L1 miss (READ_ACCESS) or write back (WRITE_ACCESS) of the given process for the shard owning its L2 set (waits if the queue is full)
+void enqueue_L2_cache_access (parallel_L2_cache *parallel_l2, unsigned int physical_address, int access_type, int process);
+
+// Waits until all queued L1 misses have been simulated and adds the L2 stats gathered since the last merge to the access info structs
+void merge_parallel_L2_stats (parallel_L2_cache *parallel_l2, Proc_Access_Info *proc_access_info);
+
+// Stops and joins the worker threads and frees the shards (the L2 cache itself is left alone)
+void stop_parallel_L2_cache (parallel_L2_cache *parallel_l2);
+
+#endif
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include "cache.h"
 #include "pagetable.h"
 #include "processes.h"
+#include "trace_prefetch.h"
 
 void initialize_pcb (FILE* fptr, PCB* pcb_ptr, int num_processes) {
     int i = 0; 
@@ -13,10 +15,13 @@ void initialize_pcb (FILE* fptr, PCB* pcb_ptr, int num_processes) {
         pcb_ptr[i].num_traces_context_sw = (rand() % 100) + 200;           // assign a random number of traces before context switch (200-300)
         
         fscanf(fptr,"%s\n",pcb_ptr[i].filename);                           // get input file name for each process
-        pcb_ptr[i].proc_input_file = fopen (pcb_ptr[i].filename, "r");     // get input file stream pointer for each process
         
-        if (pcb_ptr[i].proc_input_file == NULL) {
-            printf(" ERROR: Could not open the input file for process %d\n", pcb_ptr[i].pid); 
+        pcb_ptr[i].proc_trace_reader = open_trace_reader (pcb_ptr[i].filename);     // get input file reader for each process (format detected from the file)
+        pcb_ptr[i].proc_prefetch_ring = NULL;                                      // reader threads are only started after prepaging
+        
+        if (pcb_ptr[i].proc_trace_reader == NULL) {
+            fprintf(stderr, " ERROR: Could not open the input file for process %d\n", pcb_ptr[i].pid); 
+            pcb_ptr[i].process_state = TERMINATED;                         // nothing to simulate - the other processes still run
         } 
         
         // page directory base address
@@ -57,7 +62,7 @@ void initialize_access_info_structs (Proc_Access_Info* proc_access_info, int num
     }
 }
 
-void prepaging_function (PCB* pcb_ptr, Proc_Access_Info* proc_access_info, int num_processes) {
+void prepaging_function (simulator_context* ctx, PCB* pcb_ptr, Proc_Access_Info* proc_access_info, int num_processes) {
 
     int i = 0;
     unsigned int logical_address_page1;
@@ -65,17 +70,23 @@ void prepaging_function (PCB* pcb_ptr, Proc_Access_Info* proc_access_info, int n
 
     // For each READY process  
     for (i = 0 ; i < num_processes ; i++) {
-        if (pcb_ptr[i].process_state = READY) {
+        if (pcb_ptr[i].process_state == READY) {
             
-            fscanf(pcb_ptr[i].proc_input_file, "%x", &logical_address_page1);
+            // A live trace stream (shared-memory ring) may end before its first trace
+            if (get_next_trace(&pcb_ptr[i], &logical_address_page1) == EOF)
+                continue;
             printf(" Process %d logical address 1: %x\n", i, logical_address_page1);
             
             // TODO: Pre-page page corresponding to logical_address_page1 
-            get_page_entry((logical_address_page1 >> 9), pcb_ptr, proc_access_info); // page table walk
+            get_page_entry(ctx, (logical_address_page1 >> 9), pcb_ptr, proc_access_info); // page table walk
             
             // Keep reading next traces till next request is from another (distinct) page
+            // (or till the traces run out - the second page is then the first one again)
             while (1) {
-                 fscanf(pcb_ptr[i].proc_input_file, "%x", &logical_address_page2);
+                 if (get_next_trace(&pcb_ptr[i], &logical_address_page2) == EOF) {
+                     logical_address_page2 = logical_address_page1;
+                     break;
+                 }
                  if ((logical_address_page2 >> 9) != (logical_address_page1 >> 9))
                      break;
             }
@@ -84,16 +95,88 @@ void prepaging_function (PCB* pcb_ptr, Proc_Access_Info* proc_access_info, int n
             printf("\n");
             
             // TODO: Pre-page page corresponding to logical_address_page2 
-            get_page_entry((logical_address_page2 >> 9), pcb_ptr, proc_access_info); // page table walk
+            get_page_entry(ctx, (logical_address_page2 >> 9), pcb_ptr, proc_access_info); // page table walk
             
             // Reset file stream pointers to start --TODO fseek(fptr, 0, SEEK_SET); rewind(fptr);
             // fclose(pcb_ptr[i].proc_input_file);
             // pcb_ptr[i].proc_input_file = fopen (pcb_ptr[i].filename, "r");
-            fseek(pcb_ptr[i].proc_input_file, 0, SEEK_SET);
+            rewind_trace_input(&pcb_ptr[i]);
         }
     }
 }
 
+// Reads the next trace (32-bit logical address) of the given process from its input file.
+// Returns EOF once all traces of the process have been read.
+
+int get_next_trace (PCB* pcb, unsigned int* logical_address) {
+    return read_next_trace (pcb->proc_trace_reader, logical_address);
+}
+
+// Gets the next trace of the given process with its trace type and page number decoded. With TRACE_PREFETCH the reader thread of the
+// process has already done the reading and decoding, so the trace is just popped from its ring.
+// Returns EOF once all traces of the process have been read.
+
+int get_next_trace_info (PCB* pcb, trace_info* trace) {
+    unsigned int logical_address = 0;
+
+    if (pcb->proc_prefetch_ring != NULL)
+        return pop_prefetched_trace (pcb->proc_prefetch_ring, trace);
+
+    if (read_next_trace (pcb->proc_trace_reader, &logical_address) != TRACE_READ_SUCCESSFUL)
+        return EOF;
+
+    decode_trace (logical_address, trace);
+    return 1;
+}
+
+// Fills in the trace fields that only depend on the logical address.
+
+void decode_trace (unsigned int logical_address, trace_info* trace) {
+    trace->logical_address = logical_address;
+
+    // Determining if the trace belongs to instruction series (7f) or data series (10) 
+    // - reqd to determine L1 (split) cache type
+    if ((logical_address >> 24) == 0x7f)
+        trace->trace_type = INSTRUCTION;
+    else
+        trace->trace_type = DATA;
+
+    // Extract 23-bit page number from the 32-bit logical address
+    trace->page_number = logical_address >> 9;
+}
+
+// Starts a reader thread for each READY process, so that its traces are read and decoded while other processes are being simulated.
+// Must be called after prepaging (which rewinds the trace inputs). If a thread cannot be started the process reads its traces directly.
+
+void start_trace_prefetching (PCB* pcb_ptr, int num_processes) {
+    int i = 0;
+
+    if (!TRACE_PREFETCH)
+        return;
+
+    for (i = 0 ; i < num_processes ; i++) {
+        if (pcb_ptr[i].process_state == READY && pcb_ptr[i].proc_trace_reader != NULL)
+            pcb_ptr[i].proc_prefetch_ring = start_trace_prefetch (pcb_ptr[i].proc_trace_reader);
+    }
+}
+
+// Restarts the trace input of the given process from its first trace.
+
+void rewind_trace_input (PCB* pcb) {
+    rewind_trace_reader (pcb->proc_trace_reader);
+}
+
+// Closes the trace input of the given process (once it has TERMINATED).
+
+void close_trace_input (PCB* pcb) {
+    if (pcb->proc_prefetch_ring != NULL) {
+        stop_trace_prefetch (pcb->proc_prefetch_ring);
+        pcb->proc_prefetch_ring = NULL;
+    }
+    close_trace_reader (pcb->proc_trace_reader);
+    pcb->proc_trace_reader = NULL;
+}
+
 void print_pcb (PCB* pcb_ptr, int num_processes) {
     int i = 0;
     
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include "pagetable.h"
+#include "tracefile.h"
 
 // Process states -- according to the 3-state diagram
 
@@ -14,6 +15,10 @@
 #define MAX_PAGE_FAULT_FREQUENCY 0.01 // 1%
 #define MIN_PAGE_FAULT_FREQUENCY 0.0000025 // 0.00025%
 
+// 1 - the traces of every process are read and decoded ahead of time by a reader thread per process (see trace_prefetch.h)
+// 0 - the simulation reads and decodes every trace itself when the process gets its turn
+#define TRACE_PREFETCH 1
+
 // PCB structure maintained per process
 
 typedef struct {
@@ -21,7 +26,8 @@ typedef struct {
     int process_state;                 // READY, RUNNING or WAITING
     int num_traces_context_sw;         // Maximum number of requests serviced before context switch
     char filename[100];                // Input file name containing traces from that process
-    FILE *proc_input_file;             // Input file pointer containing traces from that process
+    trace_reader *proc_trace_reader;   // Reader for the input file containing traces from that process (text or binary - see tracefile.h)
+    struct trace_prefetch_ring *proc_prefetch_ring;   // Ring of traces decoded ahead of time by the reader thread of that process (NULL if not prefetching)
     // pointer to page table           // Pointer to page table structure of that process (mem context info)
     page_table* page_dir_base_addr;
     unsigned int page_count;           // Total number of pages held by this process
@@ -75,13 +81,23 @@ typedef struct {
 } Proc_Access_Info;
 
 void initialize_pcb (FILE* fptr, PCB* pcb_array, int num_processes);                                              // Initializes the Process Control Block fields for all processes
-void prepaging_function (PCB* pcb_array, Proc_Access_Info* proc_access_info, int num_processes);                  // Loads the first 2 pages of all READY processes
+void prepaging_function (simulator_context* ctx, PCB* pcb_array, Proc_Access_Info* proc_access_info, int num_processes); // Loads the first 2 pages of all READY processes
 void print_pcb (PCB* pcb_array, int num_processes);
 void initialize_access_info_structs (Proc_Access_Info* proc_access_info, int num_processes);
 
+int get_next_trace (PCB* pcb, unsigned int* logical_address);                                                     // Reads the next trace of the process - returns EOF at the end of its input
+int get_next_trace_info (PCB* pcb, trace_info* trace);                                                            // Gets the next decoded trace of the process - returns EOF at the end of its input
+void decode_trace (unsigned int logical_address, trace_info* trace);                                              // Decodes the trace type and page number of a logical address
+void start_trace_prefetching (PCB* pcb_array, int num_processes);                                                 // Starts the reader threads of all READY processes (TRACE_PREFETCH)
+void rewind_trace_input (PCB* pcb);                                                                               // Restarts the trace input of the process from the first trace
+void close_trace_input (PCB* pcb);                                                                                // Closes the trace input of the process
+
 page_table* page_dir_init();
-page_table_entry *get_page_entry(unsigned int block_number /*virtual address*/, PCB* temp_pcb, Proc_Access_Info* temp_pai);
-void invalidate_page(unsigned int p_table_index);
-void page_table_free(page_table* p_table);
+page_table_lru_queue page_table_lru_init(simulator_context* ctx);
+int get_page_directory_index(unsigned int block_number /*virtual address*/);                                      // Page directory entry of the page - -1 outside the data (10...) and instruction (7f...) regions
+page_table_entry *get_page_entry(simulator_context* ctx, unsigned int block_number /*virtual address*/, PCB* temp_pcb, Proc_Access_Info* temp_pai); // NULL outside the regions
+void invalidate_page(simulator_context* ctx, unsigned int p_table_index);
+void replace_page_table(simulator_context* ctx, page_table_lru_node* replaced);                                     // Releases the page table and its p_tables slot
+void page_table_free(simulator_context* ctx, page_table* p_table);
 
 #endif
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replacement.h"
+
+// Policy names used in geometry / sweep files, indexed by REPLACEMENT_*
+static const char *replacement_policy_names[NUM_REPLACEMENT_POLICIES] = { "lru", "plru", "srrip", "brrip", "fifo", "random", "clock" };
+
+// Allocates and initializes the replacement state of a level. LRU keeps a row mask per way (num_ways words per set), every other policy
+// REPLACEMENT_SET_WORDS words per set.
+
+void initialize_replacement_state (replacement_state *replacement, const level_geometry *geometry) {
+    unsigned int i = 0;
+
+    replacement->policy = geometry->replacement_policy;
+    replacement->num_ways = geometry->num_ways;
+    replacement->way_mask = geometry->way_mask;
+    replacement->tree_levels = __builtin_ctz (geometry->num_ways);
+    replacement->set_words = (replacement->policy == REPLACEMENT_LRU) ? geometry->num_ways : REPLACEMENT_SET_WORDS;
+    replacement->state = (unsigned int *) calloc ((size_t) geometry->num_sets * replacement->set_words, sizeof (unsigned int));
+
+    // RRIP - all ways start out distant
+    if (replacement->policy == REPLACEMENT_SRRIP || replacement->policy == REPLACEMENT_BRRIP) {
+        for (i = 0; i < geometry->num_sets; i++) {
+            replacement->state[i * REPLACEMENT_SET_WORDS] = geometry->way_mask;
+            replacement->state[i * REPLACEMENT_SET_WORDS + 1] = geometry->way_mask;
+        }
+    }
+
+    // RANDOM - every set seeds its own generator (a zero xorshift state would stay zero, so a zero seed is replaced)
+    if (get_level_replacement_policy (replacement) == REPLACEMENT_RANDOM) {
+        for (i = 0; i < geometry->num_sets; i++) {
+            replacement->state[i * replacement->set_words] = REPLACEMENT_RANDOM_SEED ^ (i * REPLACEMENT_RANDOM_SET_STRIDE);
+            if (replacement->state[i * replacement->set_words] == 0)
+                replacement->state[i * replacement->set_words] = REPLACEMENT_RANDOM_SEED;
+        }
+    }
+}
+
+// Frees the state arrays of a level.
+
+void free_replacement_state (replacement_state *replacement) {
+    free (replacement->state);
+    replacement->state = NULL;
+}
+
+// Looks up a policy by its name.
+
+int get_replacement_policy (const char *name) {
+    int i = 0;
+
+    for (i = 0; i < NUM_REPLACEMENT_POLICIES; i++) {
+        if (strcmp (name, replacement_policy_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char* get_replacement_policy_name (unsigned int policy) {
+    if (policy >= NUM_REPLACEMENT_POLICIES)
+        return "unknown";
+    return replacement_policy_names[policy];
+}
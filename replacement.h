@@ -0,0 +1,333 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+#include <stdlib.h>
+#include "geometry.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// REPLACEMENT POLICY MACROS
+
+// Every set-associative level (L1 / L2 TLB, L1 / L2 cache) keeps its replacement state in a replacement_state and drives it through
+// the same three calls - replacement_on_hit, replacement_on_fill and replacement_choose_victim (only called once every way of the set
+// is VALID - the levels place new entries in INVALID ways first). The policy of each level is picked at run time from its geometry
+// ("<level>_policy <name>" in geometry / sweep files). The calls are inline switches over the policy with every policy inlined in
+// its case, so the hot path takes one predictable branch and makes no indirect calls.
+
+#define REPLACEMENT_LRU 0                      // True LRU - bit matrix, one row mask per way
+#define REPLACEMENT_TREE_PLRU 1                // Binary tree pseudo-LRU - ways - 1 tree bits per set (power-of-2 ways)
+#define REPLACEMENT_SRRIP 2                    // Static re-reference interval prediction - 2-bit RRPV per way, fills predicted "long"
+#define REPLACEMENT_BRRIP 3                    // Bimodal RRIP - fills predicted "distant", 1 in REPLACEMENT_BRRIP_LONG_INTERVAL "long"
+#define REPLACEMENT_FIFO 4                     // First in first out - pointer to the earliest arrived way
+#define REPLACEMENT_RANDOM 5                   // Random way - xorshift generator of the set
+#define REPLACEMENT_CLOCK 6                    // CLOCK (second chance) - reference bit per way and a clock hand
+#define NUM_REPLACEMENT_POLICIES 7
+
+#define REPLACEMENT_RRPV_LONG 2                // RRPV of SRRIP fills (and the occasional BRRIP fill)
+#define REPLACEMENT_RRPV_DISTANT 3             // RRPV of BRRIP fills and of invalidated ways - the next victims
+#define REPLACEMENT_BRRIP_LONG_INTERVAL 32     // Every 32nd BRRIP fill of a set is predicted "long" (a per-set counter instead of rand (), so
+                                               // the random number sequence of the simulation is not disturbed)
+#define REPLACEMENT_RANDOM_SEED 0x2545F491u    // Initial xorshift state (any non-zero value), mixed with the set index - RANDOM runs are repeatable
+#define REPLACEMENT_RANDOM_SET_STRIDE 0x9E3779B9u  // Seed step from one set to the next, so that the sets draw different sequences
+
+// Words of policy state per set for all policies but LRU (which keeps one row mask per way)
+#define REPLACEMENT_SET_WORDS 3
+
+// REPLACEMENT ADT DEFINITIONS
+
+// Replacement state of one level. The meaning of the words of a set depends on the policy:
+//     LRU          word w - row mask of way w (bit j set if way w was used more recently than way j - the LRU way has an all-0 row)
+//     TREE_PLRU    word 0 - tree bits, node n (heap order, root 1) points to the subtree holding the next victim (0 - left, 1 - right)
+//     SRRIP/BRRIP  word 0 / 1 - high / low RRPV bit of every way, word 2 - BRRIP fill counter
+//     FIFO         word 0 - way of the earliest arrived entry
+//     CLOCK        word 0 - clock hand, word 1 - reference bit of every way
+//     RANDOM       word 0 - xorshift state of the set (only touched with the set - safe with the parallel L2 shards, which own disjoint sets)
+typedef struct {
+    unsigned int policy;                       // REPLACEMENT_*
+    unsigned int num_ways;
+    unsigned int way_mask;                     // Bit mask with one bit set per way
+    unsigned int tree_levels;                  // log_2(num_ways) - TREE_PLRU
+    unsigned int set_words;                    // Words of state per set
+    unsigned int *state;                       // num_sets * set_words words, set s at s * set_words
+} replacement_state;
+
+// FUNCTION DECLARATIONS
+
+// Allocates the replacement state of a level with the given geometry (its replacement_policy selects the policy) - all ways start out
+// equally old (LRU / FIFO / CLOCK: way 0 is the first victim, RRIP: all ways distant)
+void initialize_replacement_state (replacement_state *replacement, const level_geometry *geometry);
+
+// Frees the state arrays
+void free_replacement_state (replacement_state *replacement);
+
+// Returns the policy with the given name (lru, plru, srrip, brrip, fifo, random, clock) - -1 if there is none
+int get_replacement_policy (const char *name);
+
+// Returns the name of the given policy
+const char* get_replacement_policy_name (unsigned int policy);
+
+// REPLACEMENT POLICY KERNELS
+
+// LRU - the accessed way becomes the most recently used one: its column is cleared (every other way is less recent than it, four rows
+// per SSE2 AND) and its row set (it is more recent than every other way).
+
+static inline __attribute__ ((always_inline)) void touch_LRU_way (unsigned int *rows, unsigned int num_ways, unsigned int way_mask, unsigned int way_index) {
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    __m128i column_mask = _mm_set1_epi32 ((int) ~(1u << way_index));
+
+    for (; i + 4 <= num_ways; i = i + 4)
+        _mm_storeu_si128 ((__m128i *) (rows + i), _mm_and_si128 (_mm_loadu_si128 ((const __m128i *) (rows + i)), column_mask));
+#endif
+
+    for (; i < num_ways; i++)
+        rows[i] &= ~(1u << way_index);
+
+    rows[way_index] = way_mask & ~(1u << way_index);
+}
+
+// LRU - the victim is the first way with an all-0 row (four rows compared per SSE2 instruction).
+
+static inline __attribute__ ((always_inline)) unsigned int find_LRU_way (const unsigned int *rows, unsigned int num_ways) {
+    unsigned int zero_rows = 0;
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    for (; i + 4 <= num_ways; i = i + 4) {
+        __m128i zero_compare = _mm_cmpeq_epi32 (_mm_loadu_si128 ((const __m128i *) (rows + i)), _mm_setzero_si128 ());
+        zero_rows |= (unsigned int) _mm_movemask_ps (_mm_castsi128_ps (zero_compare)) << i;
+    }
+#endif
+
+    for (; i < num_ways; i++) {
+        if (rows[i] == 0)
+            zero_rows |= 1u << i;
+    }
+
+    return __builtin_ctz (zero_rows);
+}
+
+// TREE_PLRU - every node on the path of the accessed way is pointed away from it.
+
+static inline void touch_PLRU_way (unsigned int *tree, unsigned int tree_levels, unsigned int way_index) {
+    unsigned int node = 1;
+    unsigned int direction = 0;
+    unsigned int level = 0;
+
+    for (level = 0; level < tree_levels; level++) {
+        direction = (way_index >> (tree_levels - 1 - level)) & 1;
+        if (direction)
+            *tree &= ~(1u << node);
+        else
+            *tree |= 1u << node;
+        node = 2 * node + direction;
+    }
+}
+
+// TREE_PLRU - the victim is found by following the node pointers from the root.
+
+static inline unsigned int find_PLRU_way (unsigned int tree, unsigned int tree_levels) {
+    unsigned int node = 1;
+    unsigned int level = 0;
+
+    for (level = 0; level < tree_levels; level++)
+        node = 2 * node + ((tree >> node) & 1);
+
+    return node - (1u << tree_levels);
+}
+
+// SRRIP / BRRIP - sets the RRPV of a way in the two bit planes.
+
+static inline void set_RRPV (unsigned int *planes, unsigned int way_index, unsigned int rrpv) {
+    unsigned int way_bit = 1u << way_index;
+
+    planes[0] = (rrpv & 2) ? (planes[0] | way_bit) : (planes[0] & ~way_bit);
+    planes[1] = (rrpv & 1) ? (planes[1] | way_bit) : (planes[1] & ~way_bit);
+}
+
+// SRRIP / BRRIP - the victim is the first way with a distant RRPV (3). If there is none, all RRPVs are aged by the distance of the
+// largest one from 3 in a single step (the bit plane form of incrementing them all until one reaches 3).
+
+static inline unsigned int find_RRIP_way (unsigned int *planes, unsigned int way_mask) {
+    unsigned int high = planes[0];
+    unsigned int low = planes[1];
+
+    if ((high & low) == 0) {
+        if (high != 0) {                       // Largest RRPV 2 - add 1
+            high = high | low;
+            low = ~low & way_mask;
+        }
+        else if (low != 0)                     // Largest RRPV 1 - add 2
+            high = way_mask;
+        else {                                 // All RRPVs 0 - add 3
+            high = way_mask;
+            low = way_mask;
+        }
+        planes[0] = high;
+        planes[1] = low;
+    }
+
+    return __builtin_ctz (high & low);
+}
+
+// CLOCK - the hand sweeps from its position, clearing the reference bits it passes, and stops at the first way whose reference bit is
+// already clear (back at its start if every bit was set). The hand then moves past the victim.
+
+static inline unsigned int find_CLOCK_way (unsigned int *clock, unsigned int num_ways, unsigned int way_mask) {
+    unsigned int hand = clock[0];
+    unsigned int unreferenced = ~clock[1] & way_mask;
+    unsigned int passed = 0;
+    unsigned int victim = 0;
+
+    if ((unreferenced >> hand) != 0) {
+        victim = hand + __builtin_ctz (unreferenced >> hand);
+        passed = (unsigned int) (((1ULL << victim) - 1) & ~((1ULL << hand) - 1));
+    }
+    else if (unreferenced != 0) {
+        victim = __builtin_ctz (unreferenced);
+        passed = (way_mask & ~(unsigned int) ((1ULL << hand) - 1)) | (unsigned int) ((1ULL << victim) - 1);
+    }
+    else {
+        victim = hand;
+        passed = way_mask;
+    }
+
+    clock[1] &= ~passed;
+    clock[0] = (victim + 1 == num_ways) ? 0 : victim + 1;
+    return victim;
+}
+
+// RANDOM - one xorshift32 step of the generator of the set, scaled to a way (the high bits - the number of ways need not be a power of 2).
+
+static inline unsigned int find_random_way (unsigned int *random_state, unsigned int num_ways) {
+    unsigned int x = *random_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *random_state = x;
+    return (unsigned int) (((unsigned long long) x * num_ways) >> 32);
+}
+
+// REPLACEMENT INTERFACE
+
+// Selects the policy of a call. Build with -DREPLACEMENT_POLICY=<REPLACEMENT_*> to fix the policy of every level at compile time -
+// the switches below then fold into the code of that one policy (the geometries take it over in place of the configured ones).
+
+static inline unsigned int get_level_replacement_policy (const replacement_state *replacement) {
+#ifdef REPLACEMENT_POLICY
+    (void) replacement;
+    return REPLACEMENT_POLICY;
+#else
+    return replacement->policy;
+#endif
+}
+
+// Records a hit on the given way.
+
+static inline void replacement_on_hit (replacement_state *replacement, unsigned int set_index, unsigned int way_index) {
+    unsigned int *set_state = replacement->state + set_index * replacement->set_words;
+
+    switch (get_level_replacement_policy (replacement)) {
+        case REPLACEMENT_LRU:
+            touch_LRU_way (set_state, replacement->num_ways, replacement->way_mask, way_index);
+            break;
+        case REPLACEMENT_TREE_PLRU:
+            touch_PLRU_way (set_state, replacement->tree_levels, way_index);
+            break;
+        case REPLACEMENT_SRRIP:
+        case REPLACEMENT_BRRIP:
+            set_RRPV (set_state, way_index, 0);
+            break;
+        case REPLACEMENT_CLOCK:
+            set_state[1] |= 1u << way_index;
+            break;
+        default:                               // FIFO / RANDOM - hits do not change the replacement order
+            break;
+    }
+}
+
+// Records that a new entry has been placed in the given way (an INVALID way or the victim).
+
+static inline void replacement_on_fill (replacement_state *replacement, unsigned int set_index, unsigned int way_index) {
+    unsigned int *set_state = replacement->state + set_index * replacement->set_words;
+
+    switch (get_level_replacement_policy (replacement)) {
+        case REPLACEMENT_LRU:
+            touch_LRU_way (set_state, replacement->num_ways, replacement->way_mask, way_index);
+            break;
+        case REPLACEMENT_TREE_PLRU:
+            touch_PLRU_way (set_state, replacement->tree_levels, way_index);
+            break;
+        case REPLACEMENT_SRRIP:
+            set_RRPV (set_state, way_index, REPLACEMENT_RRPV_LONG);
+            break;
+        case REPLACEMENT_BRRIP:
+            set_state[2]++;
+            set_RRPV (set_state, way_index, (set_state[2] % REPLACEMENT_BRRIP_LONG_INTERVAL == 0) ? REPLACEMENT_RRPV_LONG : REPLACEMENT_RRPV_DISTANT);
+            break;
+        case REPLACEMENT_FIFO:
+            // The entry placed under the pointer becomes the latest arrival
+            if (set_state[0] == way_index)
+                set_state[0] = (way_index + 1 == replacement->num_ways) ? 0 : way_index + 1;
+            break;
+        case REPLACEMENT_CLOCK:
+            set_state[1] |= 1u << way_index;
+            break;
+        default:                               // RANDOM
+            break;
+    }
+}
+
+// Returns the way to be replaced in the given set (every way VALID).
+
+static inline unsigned int replacement_choose_victim (replacement_state *replacement, unsigned int set_index) {
+    unsigned int *set_state = replacement->state + set_index * replacement->set_words;
+
+    switch (get_level_replacement_policy (replacement)) {
+        case REPLACEMENT_LRU:
+            return find_LRU_way (set_state, replacement->num_ways);
+        case REPLACEMENT_TREE_PLRU:
+            return find_PLRU_way (set_state[0], replacement->tree_levels);
+        case REPLACEMENT_SRRIP:
+        case REPLACEMENT_BRRIP:
+            return find_RRIP_way (set_state, replacement->way_mask);
+        case REPLACEMENT_FIFO:
+            return set_state[0];
+        case REPLACEMENT_CLOCK:
+            return find_CLOCK_way (set_state, replacement->num_ways, replacement->way_mask);
+        default:                               // RANDOM
+            return find_random_way (set_state, replacement->num_ways);
+    }
+}
+
+// Records that the ways in invalidated_ways of the given set have been invalidated (TLB flush) - they become the oldest entries.
+
+static inline void replacement_on_invalidate (replacement_state *replacement, unsigned int set_index, unsigned int invalidated_ways) {
+    unsigned int *set_state = replacement->state + set_index * replacement->set_words;
+    unsigned int i = 0;
+
+    switch (get_level_replacement_policy (replacement)) {
+        case REPLACEMENT_LRU:
+            for (i = 0; i < replacement->num_ways; i++) {
+                if ((invalidated_ways >> i) & 1)
+                    set_state[i] = 0;
+            }
+            break;
+        case REPLACEMENT_SRRIP:
+        case REPLACEMENT_BRRIP:
+            set_state[0] |= invalidated_ways;
+            set_state[1] |= invalidated_ways;
+            break;
+        case REPLACEMENT_CLOCK:
+            set_state[1] &= ~invalidated_ways;
+            break;
+        default:                               // TREE_PLRU / FIFO / RANDOM - INVALID ways are filled first anyway
+            break;
+    }
+}
+
+#endif
@@ -0,0 +1,291 @@
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+
+// Data written into the L1 data cache by WRITE accesses - in an actual system, the processor would write the result it obtained
+#define SIMULATED_WRITE_DATA 255
+
+// Creates empty TLBs and caches of the geometry of the context
+static void initialize_context_levels(simulator_context* ctx)
+{
+    ctx->l1_tlb = initialize_L1_TLB(&ctx->geometry.l1_tlb);
+    ctx->l2_tlb = initialize_L2_TLB(&ctx->geometry.l2_tlb);
+    ctx->l1_instr_cache = initialize_L1_cache(INSTRUCTION, &ctx->geometry);
+    ctx->l1_data_cache = initialize_L1_cache(DATA, &ctx->geometry);
+    ctx->l2_cache = initialize_L2_cache(&ctx->geometry);
+}
+
+// Frees the TLBs and caches of the context
+static void free_context_levels(simulator_context* ctx)
+{
+    free_L1_TLB(ctx->l1_tlb);
+    free_L2_TLB(ctx->l2_tlb);
+    free_L1_cache(ctx->l1_instr_cache);
+    free_L1_cache(ctx->l1_data_cache);
+    free_L2_cache(ctx->l2_cache);
+}
+
+simulator_context* initialize_simulator_context(const memory_geometry* geometry)
+{
+    simulator_context* ctx = (simulator_context*)calloc(1, sizeof(simulator_context));
+
+    main_memory_init(ctx);
+    initialize_slab_allocator(&ctx->page_table_slab, sizeof(page_table), PAGE_TABLE_SLAB_SIZE);
+    initialize_slab_allocator(&ctx->page_table_lru_slab, sizeof(page_table_lru_node), PAGE_TABLE_LRU_SLAB_SIZE);
+    page_table_lru_init(ctx);
+
+    ctx->geometry = *geometry;
+    initialize_context_levels(ctx);
+    return ctx;
+}
+
+// Translates the page number of a trace that missed in the L1 TLB into its frame number - L2 TLB, then a page table walk by the kernel.
+
+static unsigned int translate_L1_TLB_miss(simulator_context* ctx, trace_info* trace, PCB* pcb, Proc_Access_Info* access_info)
+{
+    unsigned int frame_number_returned = 0;
+    unsigned int shared_bit = 0;
+    page_table_entry* pte;
+
+    // The L1 TLB was searched by the batch lookup
+    access_info->num_l1_tlb_accesses++;
+    access_info->num_l1_tlb_misses++;
+
+    // Search L2 TLB - on a HIT the entry is also brought into the L1 TLB
+    frame_number_returned = search_L2_TLB(ctx->l2_tlb, trace->page_number, &shared_bit);
+    access_info->num_l2_tlb_accesses++;
+    if (frame_number_returned <= MAX_FRAME_NUMBER)
+    {
+        access_info->num_l2_tlb_hits++;
+        update_L1_TLB(ctx->l1_tlb, ctx->l2_tlb, trace->page_number, frame_number_returned, shared_bit);
+        return frame_number_returned;
+    }
+    access_info->num_l2_tlb_misses++;
+
+    // EXCEPTION: Kernel performs page table walk and updates the TLB entry in both the levels (first L2 TLB, then L1 TLB)
+    pte = get_page_entry(ctx, trace->page_number, pcb, access_info);
+    access_info->num_main_memory_accesses++;
+    frame_number_returned = pte->pageframe.frame_num;
+    shared_bit = pte->shared_bit;
+
+    // Number of main memory hits/misses updated in main memory functions - we check the updated value of page fault frequency
+    access_info->page_fault_frequency = (double)access_info->num_main_memory_misses/(double)access_info->num_main_memory_accesses;
+
+    update_L2_TLB(ctx->l2_tlb, trace->page_number, frame_number_returned, shared_bit);
+    update_L1_TLB(ctx->l1_tlb, ctx->l2_tlb, trace->page_number, frame_number_returned, shared_bit);
+
+    // Accessing L1 TLB again DEFINITELY results in a hit
+    frame_number_returned = search_L1_TLB(ctx->l1_tlb, trace->page_number);
+    access_info->num_l1_tlb_accesses++;
+    if (frame_number_returned <= MAX_FRAME_NUMBER)
+        access_info->num_l1_tlb_hits++;
+    return frame_number_returned;
+}
+
+void switch_TLB_address_space(simulator_context* ctx, unsigned int pid)
+{
+    unsigned int asid = pid % TLB_NUM_ASIDS;
+
+    if (!ctx->geometry.tlb_asids)
+        return;
+
+    // ASID recycled - the entries of the process that held it would translate the addresses of this one
+    if (ctx->asid_owner[asid] != pid + 1)
+    {
+        if (ctx->asid_owner[asid] != 0)
+            invalidate_TLB_asid(ctx->l1_tlb, ctx->l2_tlb, asid);
+        ctx->asid_owner[asid] = pid + 1;
+    }
+    set_TLB_asid(ctx->l1_tlb, ctx->l2_tlb, asid);
+}
+
+void leave_TLB_address_space(simulator_context* ctx)
+{
+    if (ctx->geometry.tlb_asids)
+        return;
+
+    flush_L1_TLB(ctx->l1_tlb);
+    flush_L2_TLB(ctx->l2_tlb);
+}
+
+void release_TLB_address_space(simulator_context* ctx, unsigned int pid)
+{
+    unsigned int asid = pid % TLB_NUM_ASIDS;
+
+    if (!ctx->geometry.tlb_asids)
+    {
+        flush_L1_TLB(ctx->l1_tlb);
+        flush_L2_TLB(ctx->l2_tlb);
+        return;
+    }
+
+    if (ctx->asid_owner[asid] == pid + 1)
+    {
+        invalidate_TLB_asid(ctx->l1_tlb, ctx->l2_tlb, asid);
+        ctx->asid_owner[asid] = 0;
+    }
+}
+
+// Simulates the cache and main memory part of an access whose frame number is known.
+
+static void access_memory(simulator_context* ctx, trace_info* trace, int access_type, Proc_Access_Info* access_info, int process)
+{
+    L1_cache* l1_cache;
+    unsigned int l1_data_returned = 0;
+
+    // Pointer view of the L1 datablock inside the L2 cache returned by L2 cache search function after miss in L1 cache (no copy - valid until the L2 set is updated)
+    data_byte* l2_l1_data_block_returned;
+
+    // Pointer view of the L2 datablock inside main memory returned by main memory search function after miss in L1 cache (no copy - valid until the frame is replaced)
+    data_byte* mm_l2_data_block_returned;
+
+    // Address of a dirty L1 block replaced on a miss, written back through the parallel L2 back end
+    unsigned int write_back_address = 0;
+
+    // Getting physical address from the frame number
+    trace->physical_address = ((trace->frame_number << 9) | (trace->logical_address % 512));
+
+    // -------------------------------------------Cache & Memory accesses -------------------------------------------------------
+
+    // Instruction traces access the L1 instruction cache and are always read, data traces access the L1 data cache
+    if (trace->trace_type == INSTRUCTION)
+    {
+        l1_cache = ctx->l1_instr_cache;
+        access_type = READ_ACCESS;
+    }
+    else
+        l1_cache = ctx->l1_data_cache;
+
+    // Hand the translated access to the swept cache configurations (simulated by the sweep worker threads) and the stack distance analyzer
+    if (ctx->sweep != NULL)
+        record_sweep_access(ctx->sweep, trace->physical_address, trace->trace_type, access_type);
+    if (ctx->stack_distance != NULL)
+        record_stack_distance_access(ctx->stack_distance, trace->physical_address, trace->page_number, trace->trace_type, process);
+
+    // Search entry corresponding to the given physical address in L1 cache - if found, read/write the corresponding datablock depending on the access type
+    l1_data_returned = search_L1_cache(l1_cache, trace->physical_address, SIMULATED_WRITE_DATA, access_type);
+    access_info->num_l1_cache_accesses++;
+
+    // If data returned by L1 cache is within valid range, L1 cache HIT for READ access - L1_CACHE_WRITE_SUCCESSFUL flag, L1 cache HIT for WRITE access
+    if (l1_data_returned <= 255 || l1_data_returned == L1_CACHE_WRITE_SUCCESSFUL)
+        access_info->num_l1_cache_hits++;
+
+    // L1_CACHE_WRITE_PROTECTION_EXCEPTION flag, L1 cache MISS for WRITE access - the exception routine is executed and the same instruction
+    // re-executed, so the second access to L1 is a HIT
+    else if (l1_data_returned == L1_CACHE_WRITE_PROTECTION_EXCEPTION)
+    {
+        access_info->num_l1_cache_misses++;
+        access_info->num_l1_cache_hits++;
+    }
+
+    // if NOT found, with the parallel L2 back end -- queue the L2 access for the worker thread owning its set and update L1 with the
+    // datablock from main memory right away (L2 is write-through, so main memory holds the same data the L2 cache would return)
+    else if (ctx->parallel_l2 != NULL)
+    {
+        access_info->num_l1_cache_misses++;
+
+        mm_l2_data_block_returned = get_l2_block(ctx, trace->physical_address >> ctx->geometry.l2_cache.offset_bits, ctx->geometry.l2_cache.block_size, access_info);
+        enqueue_L2_cache_access(ctx->parallel_l2, trace->physical_address, READ_ACCESS, process);
+
+        // The L1 datablock is the part of the L2 datablock at the L1 block offset. A dirty L1 victim is queued after the miss, the same
+        // order the serial L2 cache sees the fill and the write back in
+        if (update_L1_cache(l1_cache, NULL, mm_l2_data_block_returned + (trace->physical_address & ctx->geometry.l2_cache.offset_mask & ~ctx->geometry.l1_cache.offset_mask), trace->physical_address, &write_back_address))
+            enqueue_L2_cache_access(ctx->parallel_l2, write_back_address, WRITE_ACCESS, process);
+    }
+
+    // if NOT found -- LOOK-THROUGH to L2 cache and update L1 with the datablock entry reqd
+    else
+    {
+        access_info->num_l1_cache_misses++;
+
+        // *** L2 is Look-aside --> search L2 and main memory simultaneously
+        l2_l1_data_block_returned = search_L2_cache(ctx->l2_cache, trace->physical_address, NULL, READ_ACCESS);
+        access_info->num_l2_cache_accesses++;
+
+        // But since L2 is look-aside, when L2 search is initiated, L2 sends a signal to start searching main memory
+        mm_l2_data_block_returned = get_l2_block(ctx, trace->physical_address >> ctx->geometry.l2_cache.offset_bits, ctx->geometry.l2_cache.block_size, access_info);
+
+        // If search L2 cache returns a NULL pointer - L2 cache miss
+        if (l2_l1_data_block_returned == NULL)
+        {
+            access_info->num_l2_cache_misses++;
+            access_info->num_main_memory_accesses++;  // incrementing main memory access only when L2 is miss
+
+            // Number of main memory hits/misses updated in main memory functions - we check the updated value of page fault frequency
+            access_info->page_fault_frequency = (double)access_info->num_main_memory_misses/(double)access_info->num_main_memory_accesses;
+
+            l2_l1_data_block_returned = update_L2_cache(ctx->l2_cache, mm_l2_data_block_returned, trace->physical_address);
+        }
+
+        // If search L2 cache returns some data - L2 cache hit - sends signal to main memory to call off the search
+        else
+            access_info->num_l2_cache_hits++;
+
+        update_L1_cache(l1_cache, ctx->l2_cache, l2_l1_data_block_returned, trace->physical_address, NULL);
+    }
+}
+
+void simulate_access_batch(simulator_context* ctx, trace_info* traces, const int* access_types, int num_traces, PCB* pcb, Proc_Access_Info* access_info, int process)
+{
+    unsigned int page_numbers[TLB_BATCH_MAX];
+    unsigned int frame_numbers[TLB_BATCH_MAX];
+    int num_hits = 0;
+    int i = 0;
+    int k = 0;
+
+    for (i = 0; i < num_traces; i++)
+        page_numbers[i] = traces[i].page_number;
+
+    while (k < num_traces)
+    {
+        // ------------------------------------- TLB search ----------------------------------------------
+
+        // L1 TLB hits up to the next miss in one batch lookup - the TLB contents only change on a miss (the caches never touch them),
+        // so these are the hits the accesses would get one at a time
+        num_hits = search_L1_TLB_batch(ctx->l1_tlb, page_numbers + k, num_traces - k, frame_numbers + k);
+        access_info->num_l1_tlb_accesses += num_hits;
+        access_info->num_l1_tlb_hits += num_hits;
+        for (i = k; i < k + num_hits; i++)
+        {
+            traces[i].frame_number = frame_numbers[i];
+            access_memory(ctx, &traces[i], access_types[i], access_info, process);
+        }
+        k = k + num_hits;
+
+        // L1 TLB miss - L2 TLB, then a page table walk - before the batch lookup resumes after it
+        if (k < num_traces)
+        {
+            traces[k].frame_number = translate_L1_TLB_miss(ctx, &traces[k], pcb, access_info);
+            access_memory(ctx, &traces[k], access_types[k], access_info, process);
+            k++;
+        }
+    }
+}
+
+void reset_simulator_context(simulator_context* ctx)
+{
+    // Page tables and LRU nodes - both slabs rewound at once, the LRU queue starts out empty
+    reset_slab_allocator(&ctx->page_table_slab);
+    reset_slab_allocator(&ctx->page_table_lru_slab);
+    page_table_lru_init(ctx);
+    main_memory_reset(ctx);
+    ctx->total_page_count = 0;
+    ctx->page_table_index = 0;
+    memset(ctx->asid_owner, 0, sizeof(ctx->asid_owner));
+
+    free_context_levels(ctx);
+    initialize_context_levels(ctx);
+}
+
+void free_simulator_context(simulator_context* ctx)
+{
+    free_context_levels(ctx);
+
+    main_memory_free(ctx);
+
+    // Page tables and LRU queue nodes - whole slabs
+    free_slab_allocator(&ctx->page_table_slab);
+    free_slab_allocator(&ctx->page_table_lru_slab);
+    free(ctx);
+    return;
+}
@@ -0,0 +1,74 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "pagetable.h"
+#include "processes.h"
+#include "mainmemory.h"
+#include "geometry.h"
+#include "tlb.h"
+#include "cache.h"
+#include "sweep.h"
+#include "stack_distance.h"
+#include "parallel_l2.h"
+#include "slab.h"
+
+// SIMULATOR CONTEXT ADT DEFINITIONS
+
+// All state of one simulation - main memory, frame table, page tables and the TLBs / caches built from the geometry. Every function working
+// on main memory, the frame table or the page tables takes the context it works on, so independent simulations (each with its own context)
+// can run side by side in one process, e.g. on the threads of a thread pool.
+struct simulator_context {
+    main_memory* mm;                                      // Owner of all page tables and main memory blocks
+    frame_table* f_table;                                 // Frame table of the main memory
+    page_table_lru_queue page_table_lru;                  // Page table replacement queue
+    slab_allocator page_table_slab;                       // Page tables below the page directories of the processes
+    slab_allocator page_table_lru_slab;                   // Nodes (and head / tail) of the page table replacement queue
+    int total_page_count;                                 // Pages and page tables resident in main memory
+    int page_table_index;                                 // Index of the latest allocated page table
+
+    // TLBs and caches - sized from the geometry when the context is created
+    memory_geometry geometry;
+    L1_TLB* l1_tlb;
+    L2_TLB* l2_tlb;
+    L1_cache* l1_instr_cache;
+    L1_cache* l1_data_cache;
+    L2_cache* l2_cache;
+    unsigned int asid_owner[TLB_NUM_ASIDS];               // With ASIDs (geometry tlb_asids) - pid + 1 of the process holding each ASID, 0 if free
+
+    // Optional consumers of the translated access stream - NULL unless set up by the owner of the context, who also frees them
+    cache_sweep* sweep;                                   // Swept cache configurations
+    stack_distance_analyzer* stack_distance;              // Miss-ratio curves
+    parallel_L2_cache* parallel_l2;                       // L1 misses are simulated in the L2 cache by worker threads
+};
+
+// FUNCTION DECLARATIONS
+
+// Creates a context with an empty main memory, empty replacement queues and empty TLBs / caches of the given geometry
+simulator_context* initialize_simulator_context(const memory_geometry* geometry);
+
+// Simulates consecutive accesses of the given process in order - TLBs, page table walk on a TLB miss, L1 / L2 caches and main memory - and
+// counts them in the access info of the process. The L1 TLB is searched a run of hits at a time (search_L1_TLB_batch), with the same
+// results as one access at a time. The traces hold the decoded logical addresses (see decode_trace), their frame numbers and physical
+// addresses are filled in. At most TLB_BATCH_MAX traces, all of the running process (no context switch within a batch). The process
+// index is the one the parallel L2 back end gathers the stats of the accesses under.
+void simulate_access_batch(simulator_context* ctx, trace_info* traces, const int* access_types, int num_traces, PCB* pcb, Proc_Access_Info* access_info, int process);
+
+// Context switch to the given process (pid). With ASIDs the TLBs translate in its address space from now on - the ASID of a process is
+// pid % TLB_NUM_ASIDS, and if another process held it last, that process's entries are invalidated first. Without ASIDs nothing is done.
+void switch_TLB_address_space(simulator_context* ctx, unsigned int pid);
+
+// Context switch away from the running process - without ASIDs the TLBs are flushed (retaining all shared entries), with ASIDs they keep
+// the entries of every process
+void leave_TLB_address_space(simulator_context* ctx);
+
+// The given process terminated - without ASIDs the TLBs are flushed, with ASIDs only the entries of its ASID are invalidated and the ASID freed
+void release_TLB_address_space(simulator_context* ctx, unsigned int pid);
+
+// Empties main memory and the page tables (the page table slabs are rewound in O(1), the frame data is kept) and rebuilds the TLBs
+// and caches, so the context simulates the next run as if it were new. The page directories of the processes are left to their owner.
+void reset_simulator_context(simulator_context* ctx);
+
+// Frees the context along with its main memory, TLBs and caches
+void free_simulator_context(simulator_context* ctx);
+
+#endif
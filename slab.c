@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "slab.h"
+
+void initialize_slab_allocator (slab_allocator *allocator, size_t object_size, unsigned int objects_per_slab) {
+    allocator->object_size = (object_size + SLAB_OBJECT_ALIGNMENT - 1) & ~((size_t) SLAB_OBJECT_ALIGNMENT - 1);
+    allocator->objects_per_slab = objects_per_slab;
+    allocator->first = NULL;
+    allocator->current = NULL;
+    allocator->current_used = 0;
+    allocator->free_list = NULL;
+}
+
+// Free list first, then the rest of the current slab, then the next slab - a slab kept from before a reset, or a new one.
+
+void* slab_alloc (slab_allocator *allocator) {
+    void *object = allocator->free_list;
+    slab *next = NULL;
+
+    if (object != NULL) {
+        allocator->free_list = *(void **) object;
+        return object;
+    }
+
+    if (allocator->current == NULL || allocator->current_used == allocator->objects_per_slab) {
+        next = (allocator->current == NULL) ? allocator->first : allocator->current->next;
+        if (next == NULL) {
+            next = (slab *) malloc (sizeof (slab) + allocator->object_size * allocator->objects_per_slab);
+            if (next == NULL) {
+                fprintf(stderr, " ERROR: Could not allocate a slab of %u objects\n", allocator->objects_per_slab);
+                return NULL;
+            }
+            next->next = NULL;
+            if (allocator->current == NULL)
+                allocator->first = next;
+            else
+                allocator->current->next = next;
+        }
+        allocator->current = next;
+        allocator->current_used = 0;
+    }
+
+    object = (char *) allocator->current->objects + allocator->object_size * allocator->current_used;
+    allocator->current_used++;
+    return object;
+}
+
+void slab_free (slab_allocator *allocator, void *object) {
+    *(void **) object = allocator->free_list;
+    allocator->free_list = object;
+}
+
+void reset_slab_allocator (slab_allocator *allocator) {
+    allocator->current = NULL;
+    allocator->current_used = 0;
+    allocator->free_list = NULL;
+}
+
+void free_slab_allocator (slab_allocator *allocator) {
+    slab *curr = allocator->first;
+    slab *clear = NULL;
+
+    while (curr != NULL) {
+        clear = curr;
+        curr = curr->next;
+        free (clear);
+    }
+    initialize_slab_allocator (allocator, allocator->object_size, allocator->objects_per_slab);
+}
@@ -0,0 +1,49 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// SLAB ALLOCATOR
+
+// Hands out fixed-size objects (page tables, page table LRU nodes) carved from large slabs instead of one malloc per object. Freed
+// objects go on a free list (chained through their first word) and are handed out again first. Resetting the allocator rewinds it to
+// its first slab in O(1) - every object is free again and the slabs are kept for the next simulation - and freeing it frees whole slabs.
+
+#define SLAB_OBJECT_ALIGNMENT 8                // Object sizes are rounded up to a multiple of this (pointers in the objects stay aligned)
+
+// SLAB ADT DEFINITIONS
+
+typedef struct slab slab;
+
+struct slab {
+    slab *next;                                // Next slab of the allocator (kept across resets)
+    unsigned long long objects[];              // objects_per_slab objects of object_size bytes
+};
+
+typedef struct {
+    size_t object_size;
+    unsigned int objects_per_slab;
+    slab *first;                               // All slabs of the allocator, in allocation order
+    slab *current;                             // Slab new objects are carved from
+    unsigned int current_used;                 // Objects carved from the current slab
+    void *free_list;                           // Freed objects - handed out before carving new ones
+} slab_allocator;
+
+// FUNCTION DECLARATIONS
+
+// Sets up an empty allocator of objects of the given size - slabs are allocated as they are needed
+void initialize_slab_allocator (slab_allocator *allocator, size_t object_size, unsigned int objects_per_slab);
+
+// Returns an uninitialized object - NULL if a new slab cannot be allocated
+void* slab_alloc (slab_allocator *allocator);
+
+// Returns an object to the allocator
+void slab_free (slab_allocator *allocator, void *object);
+
+// Frees every object at once in O(1) - the slabs are kept and reused
+void reset_slab_allocator (slab_allocator *allocator);
+
+// Frees the slabs of the allocator
+void free_slab_allocator (slab_allocator *allocator);
+
+#endif
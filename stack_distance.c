@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "stack_distance.h"
+#include "cache.h"
+
+// Adds value to the mark count of access time t (Fenwick tree index t + 1). Unsigned wrap-around makes adding (unsigned) -1 a decrement.
+
+static void update_stack_distance_tree (stack_distance_set *set, unsigned int t, unsigned int value) {
+    for (unsigned int i = t + 1; i <= set->capacity; i += i & (0u - i))
+        set->tree[i] += value;
+}
+
+// Returns the number of marked access times 0 .. t.
+
+static unsigned int count_stack_distance_marks (const stack_distance_set *set, unsigned int t) {
+    unsigned int count = 0;
+
+    for (unsigned int i = t + 1; i > 0; i -= i & (0u - i))
+        count += set->tree[i];
+    return count;
+}
+
+// Renumbers the marked access times of a set 0, 1, ... (keeping their order) once all access times have been used up, and rebuilds its
+// Fenwick tree. The capacity is doubled if more than half of it is still marked, so compactions stay rare.
+
+static void compact_stack_distance_set (stack_distance_level *level, int profile, stack_distance_set *set) {
+    unsigned int num_marked = 0;
+    unsigned int t = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    for (t = 0; t < set->time; t++) {
+        if (set->owner[t] != STACK_DISTANCE_NO_BLOCK) {
+            set->owner[num_marked] = set->owner[t];
+            level->slot_times[set->owner[t] * NUM_STACK_DISTANCE_PROFILES + profile] = num_marked;
+            num_marked++;
+        }
+    }
+
+    if (set->capacity == 0 || num_marked * 2 > set->capacity) {
+        set->capacity = (set->capacity == 0) ? STACK_DISTANCE_SET_INITIAL_CAPACITY : set->capacity * 2;
+        set->tree = (unsigned int *) realloc (set->tree, (set->capacity + 1) * sizeof (unsigned int));
+        set->owner = (unsigned int *) realloc (set->owner, set->capacity * sizeof (unsigned int));
+    }
+
+    for (t = num_marked; t < set->capacity; t++)
+        set->owner[t] = STACK_DISTANCE_NO_BLOCK;
+
+    // Linear-time Fenwick tree build - times 0 .. num_marked - 1 marked
+    set->tree[0] = 0;
+    for (i = 1; i <= set->capacity; i++)
+        set->tree[i] = (i <= num_marked) ? 1 : 0;
+    for (i = 1; i <= set->capacity; i++) {
+        j = i + (i & (0u - i));
+        if (j <= set->capacity)
+            set->tree[j] += set->tree[i];
+    }
+
+    set->time = num_marked;
+    set->num_marked = num_marked;
+}
+
+// Returns the map index of the given block number - either the entry holding it or the empty entry it would be inserted at.
+
+static unsigned int find_stack_distance_block (const stack_distance_level *level, unsigned long long block_number) {
+    unsigned int mask = level->map_capacity - 1;
+    unsigned int index = (unsigned int) ((block_number * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctz (level->map_capacity)));
+
+    while (level->map_keys[index] != STACK_DISTANCE_EMPTY_KEY && level->map_keys[index] != block_number)
+        index = (index + 1) & mask;
+    return index;
+}
+
+// Doubles the block map (keeping it at most half full) and the slot times with it.
+
+static void grow_stack_distance_map (stack_distance_level *level) {
+    unsigned long long *old_keys = level->map_keys;
+    unsigned int *old_slots = level->map_slots;
+    unsigned int old_capacity = level->map_capacity;
+    unsigned int index = 0;
+    unsigned int i = 0;
+
+    level->map_capacity = old_capacity * 2;
+    level->map_keys = (unsigned long long *) malloc (level->map_capacity * sizeof (unsigned long long));
+    level->map_slots = (unsigned int *) malloc (level->map_capacity * sizeof (unsigned int));
+    for (i = 0; i < level->map_capacity; i++)
+        level->map_keys[i] = STACK_DISTANCE_EMPTY_KEY;
+
+    for (i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != STACK_DISTANCE_EMPTY_KEY) {
+            index = find_stack_distance_block (level, old_keys[i]);
+            level->map_keys[index] = old_keys[i];
+            level->map_slots[index] = old_slots[i];
+        }
+    }
+    free (old_keys);
+    free (old_slots);
+
+    level->slot_times = (unsigned int *) realloc (level->slot_times, (size_t) (level->map_capacity / 2) * NUM_STACK_DISTANCE_PROFILES * sizeof (unsigned int));
+}
+
+// Sets up an empty level for the given block size.
+
+static void initialize_stack_distance_level (stack_distance_level *level, const char *name, unsigned int block_size) {
+    int p = 0;
+
+    level->name = name;
+    level->block_size = block_size;
+    level->block_bits = __builtin_ctz (block_size);
+    level->num_accesses = 0;
+    level->num_cold_misses = 0;
+
+    // Sets get their access times on first use (compaction of an empty set)
+    for (p = 0; p < NUM_STACK_DISTANCE_PROFILES; p++) {
+        level->profiles[p].num_sets = 1u << p;
+        level->profiles[p].sets = (stack_distance_set *) calloc (level->profiles[p].num_sets, sizeof (stack_distance_set));
+        level->profiles[p].histogram = (unsigned long long *) calloc (MAX_STACK_DISTANCE, sizeof (unsigned long long));
+        level->profiles[p].num_far_accesses = 0;
+    }
+
+    level->map_capacity = STACK_DISTANCE_MAP_INITIAL_CAPACITY;
+    level->map_keys = (unsigned long long *) malloc (level->map_capacity * sizeof (unsigned long long));
+    level->map_slots = (unsigned int *) malloc (level->map_capacity * sizeof (unsigned int));
+    for (unsigned int i = 0; i < level->map_capacity; i++)
+        level->map_keys[i] = STACK_DISTANCE_EMPTY_KEY;
+    level->slot_times = (unsigned int *) malloc ((size_t) (level->map_capacity / 2) * NUM_STACK_DISTANCE_PROFILES * sizeof (unsigned int));
+    level->num_blocks = 0;
+}
+
+stack_distance_analyzer* initialize_stack_distance_analyzer (const memory_geometry *geometry) {
+    stack_distance_analyzer *analyzer;
+    analyzer = (stack_distance_analyzer *) malloc (sizeof (stack_distance_analyzer));
+
+    initialize_stack_distance_level (&analyzer->levels[STACK_DISTANCE_L1_INSTR_CACHE], "L1 instruction cache", geometry->l1_cache.block_size);
+    initialize_stack_distance_level (&analyzer->levels[STACK_DISTANCE_L1_DATA_CACHE], "L1 data cache", geometry->l1_cache.block_size);
+    initialize_stack_distance_level (&analyzer->levels[STACK_DISTANCE_L2_CACHE], "L2 cache", geometry->l2_cache.block_size);
+    initialize_stack_distance_level (&analyzer->levels[STACK_DISTANCE_TLB], "TLB", 1);
+
+    return analyzer;
+}
+
+// Records an access to the given address in every profile of the level.
+
+static void record_stack_distance_level_access (stack_distance_level *level, unsigned long long address) {
+    unsigned long long block_number = address >> level->block_bits;
+    unsigned int index = 0;
+    unsigned int slot = 0;
+    unsigned int *slot_times;
+    stack_distance_profile *profile;
+    stack_distance_set *set;
+    unsigned int distance = 0;
+    unsigned int t = 0;
+    int cold = 0;
+    int p = 0;
+
+    level->num_accesses++;
+
+    // Look up the slot of the block - first reference if it has none
+    index = find_stack_distance_block (level, block_number);
+    if (level->map_keys[index] == STACK_DISTANCE_EMPTY_KEY) {
+        if ((level->num_blocks + 1) * 2 > level->map_capacity) {
+            grow_stack_distance_map (level);
+            index = find_stack_distance_block (level, block_number);
+        }
+        level->map_keys[index] = block_number;
+        level->map_slots[index] = level->num_blocks++;
+        level->num_cold_misses++;
+        cold = 1;
+    }
+    slot = level->map_slots[index];
+    slot_times = level->slot_times + slot * NUM_STACK_DISTANCE_PROFILES;
+
+    for (p = 0; p < NUM_STACK_DISTANCE_PROFILES; p++) {
+        profile = &level->profiles[p];
+        set = &profile->sets[block_number & (profile->num_sets - 1)];
+
+        if (set->time == set->capacity)
+            compact_stack_distance_set (level, p, set);
+
+        if (!cold) {
+            // Stack distance - blocks of the set marked after the previous access to this block
+            t = slot_times[p];
+            distance = set->num_marked - count_stack_distance_marks (set, t);
+            if (distance < MAX_STACK_DISTANCE)
+                profile->histogram[distance]++;
+            else
+                profile->num_far_accesses++;
+
+            // The previous access is no longer the latest one of the block
+            update_stack_distance_tree (set, t, (unsigned int) -1);
+            set->owner[t] = STACK_DISTANCE_NO_BLOCK;
+            set->num_marked--;
+        }
+
+        update_stack_distance_tree (set, set->time, 1);
+        set->owner[set->time] = slot;
+        slot_times[p] = set->time;
+        set->time++;
+        set->num_marked++;
+    }
+}
+
+void record_stack_distance_access (stack_distance_analyzer *analyzer, unsigned int physical_address, unsigned int page_number, int trace_type, int process) {
+    if (trace_type == INSTRUCTION)
+        record_stack_distance_level_access (&analyzer->levels[STACK_DISTANCE_L1_INSTR_CACHE], physical_address);
+    else
+        record_stack_distance_level_access (&analyzer->levels[STACK_DISTANCE_L1_DATA_CACHE], physical_address);
+
+    record_stack_distance_level_access (&analyzer->levels[STACK_DISTANCE_L2_CACHE], physical_address);
+    record_stack_distance_level_access (&analyzer->levels[STACK_DISTANCE_TLB], ((unsigned long long) process << VIRTUAL_PAGE_NUMBER_BITS) | page_number);
+}
+
+// Writes the miss-ratio curves - for every level and number of sets, the miss ratio of an LRU cache with 1 .. 64 ways and then every
+// power-of-2 number of ways up to MAX_STACK_DISTANCE. Capacities are in bytes for the caches and in entries for the TLBs.
+
+int write_miss_ratio_curves (stack_distance_analyzer *analyzer, const char *filename) {
+    stack_distance_level *level;
+    stack_distance_profile *profile;
+    unsigned long long num_hits = 0;
+    unsigned int ways = 0;
+    unsigned int d = 0;
+    FILE *fptr;
+    int l = 0;
+    int p = 0;
+
+    fptr = fopen (filename, "w");
+    if (fptr == NULL) {
+        fprintf(stderr, " ERROR: Could not open the miss-ratio curve file %s\n", filename);
+        return -1;
+    }
+
+    fprintf (fptr, "level,sets,ways,capacity,miss_ratio\n");
+    for (l = 0; l < NUM_STACK_DISTANCE_LEVELS; l++) {
+        level = &analyzer->levels[l];
+        if (level->num_accesses == 0)
+            continue;
+
+        for (p = 0; p < NUM_STACK_DISTANCE_PROFILES; p++) {
+            profile = &level->profiles[p];
+            num_hits = 0;
+            d = 0;
+
+            for (ways = 1; ways <= MAX_STACK_DISTANCE; ways = (ways < 64) ? ways + 1 : ways * 2) {
+
+                // Accesses with a stack distance below the number of ways hit
+                for (; d < ways; d++)
+                    num_hits += profile->histogram[d];
+
+                fprintf (fptr, "%s,%u,%u,%llu,%lf\n", level->name, profile->num_sets, ways,
+                         (unsigned long long) profile->num_sets * ways * level->block_size,
+                         1.0 - (double) num_hits / (double) level->num_accesses);
+            }
+        }
+    }
+
+    fclose (fptr);
+    return 0;
+}
+
+void free_stack_distance_analyzer (stack_distance_analyzer *analyzer) {
+    stack_distance_level *level;
+    unsigned int s = 0;
+    int l = 0;
+    int p = 0;
+
+    for (l = 0; l < NUM_STACK_DISTANCE_LEVELS; l++) {
+        level = &analyzer->levels[l];
+        for (p = 0; p < NUM_STACK_DISTANCE_PROFILES; p++) {
+            for (s = 0; s < level->profiles[p].num_sets; s++) {
+                free (level->profiles[p].sets[s].tree);
+                free (level->profiles[p].sets[s].owner);
+            }
+            free (level->profiles[p].sets);
+            free (level->profiles[p].histogram);
+        }
+        free (level->map_keys);
+        free (level->map_slots);
+        free (level->slot_times);
+    }
+    free (analyzer);
+}
@@ -0,0 +1,87 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include "geometry.h"
+
+// STACK DISTANCE MACROS
+
+// The stack distance analyzer computes LRU miss-ratio curves of the L1 caches, the L2 cache and the TLBs in a single pass (Mattson's
+// stack algorithm). For every power-of-2 number of sets up to MAX_STACK_DISTANCE_SETS, the LRU stack distance of an access is the number
+// of distinct blocks of its set referenced since the previous access to the same block - an access hits in every LRU cache with that
+// number of sets and more ways than its stack distance. The distances are counted with a Fenwick tree over the access times of each set,
+// in which only the latest access to every block is marked.
+
+#define MAX_STACK_DISTANCE_SETS 1024                       // Set counts 1, 2, 4 ... MAX_STACK_DISTANCE_SETS are profiled
+#define NUM_STACK_DISTANCE_PROFILES 11                     // log_2(MAX_STACK_DISTANCE_SETS) + 1
+#define MAX_STACK_DISTANCE 4096                            // Distances (ways) counted exactly - larger ones only count as misses
+
+#define STACK_DISTANCE_SET_INITIAL_CAPACITY 64             // Access times per set before the first compaction (power of 2)
+#define STACK_DISTANCE_MAP_INITIAL_CAPACITY 4096           // Block map entries before the first growth (power of 2)
+#define STACK_DISTANCE_NO_BLOCK 0xFFFFFFFFu                // Unmarked access time
+#define STACK_DISTANCE_EMPTY_KEY (~0ULL)                   // Empty block map entry
+
+// Analyzed levels
+#define STACK_DISTANCE_L1_INSTR_CACHE 0
+#define STACK_DISTANCE_L1_DATA_CACHE 1
+#define STACK_DISTANCE_L2_CACHE 2
+#define STACK_DISTANCE_TLB 3
+#define NUM_STACK_DISTANCE_LEVELS 4
+
+// STACK DISTANCE ADT DEFINITIONS
+
+// Access times of one set. Time t is marked in the Fenwick tree while it is the latest access to the block in owner[t].
+// When the times run out the marked times are renumbered 0, 1, ... in order (compaction), doubling the capacity if more than half are marked.
+typedef struct {
+    unsigned int capacity;                                 // Access times before the next compaction
+    unsigned int time;                                     // Next access time
+    unsigned int num_marked;                               // Distinct blocks referenced in the set so far
+    unsigned int *tree;                                    // Fenwick tree of marks - tree[1 .. capacity]
+    unsigned int *owner;                                   // Block map slot of the block accessed at each marked time
+} stack_distance_set;
+
+// Stack distance profile of one number of sets
+typedef struct {
+    unsigned int num_sets;
+    stack_distance_set *sets;
+    unsigned long long *histogram;                         // Number of accesses per stack distance (0 .. MAX_STACK_DISTANCE - 1)
+    unsigned long long num_far_accesses;                   // Accesses with a stack distance of MAX_STACK_DISTANCE or more
+} stack_distance_profile;
+
+// One analyzed level. Every referenced block gets a slot in the block map (open addressing, linear probing) -
+// the slot holds the latest access time of the block in each profile. The TLB level's blocks are pages of one process (process index
+// above the page number bits), as the TLBs never translate the pages of one process for another.
+typedef struct {
+    const char *name;
+    unsigned int block_bits;                               // log_2(block size) - addresses are shifted by it to get the block number
+    unsigned int block_size;                               // Bytes per block (1 for the TLBs - one page number per entry)
+    unsigned long long num_accesses;
+    unsigned long long num_cold_misses;                    // First references of a block - miss in every cache
+    stack_distance_profile profiles[NUM_STACK_DISTANCE_PROFILES];
+
+    unsigned long long *map_keys;                          // Block number of each map entry (STACK_DISTANCE_EMPTY_KEY if empty)
+    unsigned int *map_slots;                               // Slot of each map entry
+    unsigned int map_capacity;                             // Map entries (power of 2)
+    unsigned int num_blocks;                               // Slots in use
+    unsigned int *slot_times;                              // [slot][profile] latest access time of the block of the slot
+} stack_distance_level;
+
+typedef struct {
+    stack_distance_level levels[NUM_STACK_DISTANCE_LEVELS];
+} stack_distance_analyzer;
+
+// FUNCTION DECLARATIONS
+
+// Creates the analyzer - the L1 / L2 cache levels are profiled at the block sizes of the given geometry
+stack_distance_analyzer* initialize_stack_distance_analyzer (const memory_geometry *geometry);
+
+// Records one translated access - the physical address feeds the L1 (instruction or data, by trace type) and L2 levels, the page number
+// of the process (its index) the TLB level
+void record_stack_distance_access (stack_distance_analyzer *analyzer, unsigned int physical_address, unsigned int page_number, int trace_type, int process);
+
+// Writes the miss-ratio curves of all levels (level, sets, ways, capacity, miss ratio) as CSV - returns -1 if the file cannot be written
+int write_miss_ratio_curves (stack_distance_analyzer *analyzer, const char *filename);
+
+// Frees the analyzer
+void free_stack_distance_analyzer (stack_distance_analyzer *analyzer);
+
+#endif
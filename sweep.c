@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sweep.h"
+
+// Swept L2 caches are filled with this block on a miss. Main memory frames are owned by the simulation thread (and may be replaced
+// while a chunk is simulated), so the swept caches do not copy them - only hits and misses are measured.
+static data_byte sweep_fill_block [PAGE_SIZE];
+
+// Simulates one access in the caches of a swept configuration - the same L1 / L2 access sequence the driver follows.
+
+static void simulate_sweep_access (sweep_config *config, const sweep_access *access) {
+    L1_cache *l1_cache = (access->trace_type == INSTRUCTION) ? config->l1_instr_cache : config->l1_data_cache;
+    unsigned int l1_data_returned = 0;
+    data_byte *l2_l1_data_block_returned;
+
+    l1_data_returned = search_L1_cache (l1_cache, access->physical_address, 255, access->access_type);
+    config->num_l1_cache_accesses++;
+
+    // L1 cache HIT for READ / WRITE access
+    if (l1_data_returned <= 255 || l1_data_returned == L1_CACHE_WRITE_SUCCESSFUL)
+        config->num_l1_cache_hits++;
+
+    // WRITE PROTECTION EXCEPTION - counted as a miss followed by a hit on re-execution (as in the driver)
+    else if (l1_data_returned == L1_CACHE_WRITE_PROTECTION_EXCEPTION) {
+        config->num_l1_cache_misses++;
+        config->num_l1_cache_hits++;
+    }
+
+    // L1 cache MISS - look through to L2 cache
+    else {
+        config->num_l1_cache_misses++;
+
+        l2_l1_data_block_returned = search_L2_cache (config->l2_cache, access->physical_address, NULL, READ_ACCESS);
+        config->num_l2_cache_accesses++;
+
+        if (l2_l1_data_block_returned == NULL) {
+            config->num_l2_cache_misses++;
+            l2_l1_data_block_returned = update_L2_cache (config->l2_cache, sweep_fill_block, access->physical_address);
+        }
+        else
+            config->num_l2_cache_hits++;
+
+        update_L1_cache (l1_cache, config->l2_cache, l2_l1_data_block_returned, access->physical_address, NULL);
+    }
+}
+
+// Worker thread - waits for each published chunk and simulates it in its share of the configurations.
+
+static void* sweep_worker_thread (void *arg) {
+    sweep_worker *worker = (sweep_worker *) arg;
+    cache_sweep *sweep = worker->sweep;
+    unsigned long generation = 0;        // Chunks simulated by this worker
+    const sweep_access *chunk;
+    unsigned int length = 0;
+    unsigned int i = 0;
+    int k = 0;
+
+    while (1) {
+        pthread_mutex_lock (&sweep->lock);
+        while (sweep->generation == generation && !sweep->stop)
+            pthread_cond_wait (&sweep->chunk_ready, &sweep->lock);
+        if (sweep->generation == generation) {
+            pthread_mutex_unlock (&sweep->lock);
+            break;
+        }
+        generation = sweep->generation;
+        chunk = sweep->chunks[sweep->ready_chunk];
+        length = sweep->ready_length;
+        pthread_mutex_unlock (&sweep->lock);
+
+        // Configuration-major order - the caches of one configuration stay hot in the host caches for the whole chunk
+        for (k = worker->thread_index; k < sweep->num_configs; k = k + sweep->num_threads) {
+            for (i = 0; i < length; i++)
+                simulate_sweep_access (&sweep->configs[k], &chunk[i]);
+        }
+
+        pthread_mutex_lock (&sweep->lock);
+        sweep->num_done++;
+        if (sweep->num_done == sweep->num_threads)
+            pthread_cond_signal (&sweep->chunk_done);
+        pthread_mutex_unlock (&sweep->lock);
+    }
+
+    return NULL;
+}
+
+// Waits for the workers to finish the chunk published last (they must be done with it before the chunk after it is published,
+// as that frees the buffer the simulation thread fills next). Called with the lock held.
+
+static void wait_sweep_chunk_done (cache_sweep *sweep) {
+    while (sweep->num_done < sweep->num_threads)
+        pthread_cond_wait (&sweep->chunk_done, &sweep->lock);
+}
+
+// Hands the chunk being filled to the worker threads and switches the simulation thread to the other chunk.
+
+static void publish_sweep_chunk (cache_sweep *sweep) {
+    pthread_mutex_lock (&sweep->lock);
+    wait_sweep_chunk_done (sweep);
+    sweep->ready_chunk = sweep->fill_chunk;
+    sweep->ready_length = sweep->fill_length;
+    sweep->num_done = 0;
+    sweep->generation++;
+    pthread_cond_broadcast (&sweep->chunk_ready);
+    pthread_mutex_unlock (&sweep->lock);
+
+    sweep->fill_chunk ^= 1;
+    sweep->fill_length = 0;
+}
+
+// Frees the cache instances of the configurations created so far.
+
+static void free_sweep_configs (cache_sweep *sweep) {
+    for (int k = 0; k < sweep->num_configs; k++) {
+        free_L1_cache (sweep->configs[k].l1_instr_cache);
+        free_L1_cache (sweep->configs[k].l1_data_cache);
+        free_L2_cache (sweep->configs[k].l2_cache);
+    }
+    free (sweep->configs);
+}
+
+// Reads the sweep file and sets up the configurations, chunks and worker threads. Each non-empty line of the sweep file is one
+// configuration - geometry "<key> <value>" pairs applied on top of the base geometry, e.g.
+//     l1_cache_ways 8 l1_cache_sets 8
+//     l2_cache_ways 32 l2_cache_sets 16
+//     l2_cache_policy srrip
+// Lines starting with # are comments.
+
+cache_sweep* start_cache_sweep (const char *filename, const memory_geometry *base_geometry) {
+    cache_sweep *sweep;
+    sweep_config *config;
+    FILE *fptr;
+    char line[512];
+    char first[2];
+    long num_cpus = 0;
+    int i = 0;
+
+    fptr = fopen (filename, "r");
+    if (fptr == NULL) {
+        fprintf(stderr, " ERROR: Could not open the sweep file %s\n", filename);
+        return NULL;
+    }
+
+    sweep = (cache_sweep *) calloc (1, sizeof (cache_sweep));
+    sweep->configs = (sweep_config *) calloc (MAX_SWEEP_CONFIGS, sizeof (sweep_config));
+
+    while (fgets (line, sizeof (line), fptr) != NULL) {
+
+        // Skip blank lines and comments
+        if (sscanf (line, " %1s", first) != 1 || first[0] == '#')
+            continue;
+
+        if (sweep->num_configs == MAX_SWEEP_CONFIGS) {
+            fprintf(stderr, " ERROR: At most %d sweep configurations are supported\n", MAX_SWEEP_CONFIGS);
+            break;
+        }
+
+        config = &sweep->configs[sweep->num_configs];
+        config->geometry = *base_geometry;
+        if (apply_memory_geometry_settings (line, &config->geometry) < 0)
+            break;
+
+        config->l1_instr_cache = initialize_L1_cache (INSTRUCTION, &config->geometry);
+        config->l1_data_cache = initialize_L1_cache (DATA, &config->geometry);
+        config->l2_cache = initialize_L2_cache (&config->geometry);
+        sweep->num_configs++;
+    }
+
+    // Stopped early on an error
+    if (!feof (fptr) || sweep->num_configs == 0) {
+        if (sweep->num_configs == 0)
+            fprintf(stderr, " ERROR: No configurations in the sweep file %s\n", filename);
+        fclose (fptr);
+        free_sweep_configs (sweep);
+        free (sweep);
+        return NULL;
+    }
+    fclose (fptr);
+
+    sweep->chunks[0] = (sweep_access *) malloc (SWEEP_CHUNK_SIZE * sizeof (sweep_access));
+    sweep->chunks[1] = (sweep_access *) malloc (SWEEP_CHUNK_SIZE * sizeof (sweep_access));
+
+    // One worker per host CPU (the simulation thread mostly translates), but no more workers than configurations
+    num_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    sweep->num_threads = (num_cpus > 0) ? (int) num_cpus : 1;
+    if (sweep->num_threads > sweep->num_configs)
+        sweep->num_threads = sweep->num_configs;
+    if (sweep->num_threads > MAX_SWEEP_THREADS)
+        sweep->num_threads = MAX_SWEEP_THREADS;
+
+    pthread_mutex_init (&sweep->lock, NULL);
+    pthread_cond_init (&sweep->chunk_ready, NULL);
+    pthread_cond_init (&sweep->chunk_done, NULL);
+
+    sweep->workers = (sweep_worker *) calloc (sweep->num_threads, sizeof (sweep_worker));
+    for (i = 0; i < sweep->num_threads; i++) {
+        sweep->workers[i].sweep = sweep;
+        sweep->workers[i].thread_index = i;
+        if (pthread_create (&sweep->workers[i].thread, NULL, sweep_worker_thread, &sweep->workers[i]) != 0) {
+            fprintf(stderr, " ERROR: Could not start the sweep worker threads\n");
+            exit (-1);
+        }
+    }
+
+    // No chunk published yet - all workers count as done
+    sweep->num_done = sweep->num_threads;
+
+    return sweep;
+}
+
+void record_sweep_access (cache_sweep *sweep, unsigned int physical_address, int trace_type, int access_type) {
+    sweep_access *access = &sweep->chunks[sweep->fill_chunk][sweep->fill_length];
+
+    access->physical_address = physical_address;
+    access->trace_type = (unsigned char) trace_type;
+    access->access_type = (unsigned char) access_type;
+    sweep->fill_length++;
+
+    if (sweep->fill_length == SWEEP_CHUNK_SIZE)
+        publish_sweep_chunk (sweep);
+}
+
+// Simulates the partly filled last chunk, stops the workers and prints the hit rates of every configuration.
+
+void finish_cache_sweep (cache_sweep *sweep) {
+    sweep_config *config;
+    int i = 0;
+
+    if (sweep->fill_length > 0)
+        publish_sweep_chunk (sweep);
+
+    pthread_mutex_lock (&sweep->lock);
+    wait_sweep_chunk_done (sweep);
+    sweep->stop = 1;
+    pthread_cond_broadcast (&sweep->chunk_ready);
+    pthread_mutex_unlock (&sweep->lock);
+
+    for (i = 0; i < sweep->num_threads; i++)
+        pthread_join (sweep->workers[i].thread, NULL);
+
+    printf("\n Cache sweep results (%d configurations, %d worker threads)\n", sweep->num_configs, sweep->num_threads);
+    for (i = 0; i < sweep->num_configs; i++) {
+        config = &sweep->configs[i];
+        printf(" [%d] L1 %u x %u x %uB %s, L2 %u x %u x %uB %s: L1 hit rate %lf, L2 hit rate %lf\n", i,
+               config->geometry.l1_cache.num_sets, config->geometry.l1_cache.num_ways, config->geometry.l1_cache.block_size,
+               get_replacement_policy_name (config->geometry.l1_cache.replacement_policy),
+               config->geometry.l2_cache.num_sets, config->geometry.l2_cache.num_ways, config->geometry.l2_cache.block_size,
+               get_replacement_policy_name (config->geometry.l2_cache.replacement_policy),
+               config->num_l1_cache_accesses ? (double) config->num_l1_cache_hits / (double) config->num_l1_cache_accesses : 0.0,
+               config->num_l2_cache_accesses ? (double) config->num_l2_cache_hits / (double) config->num_l2_cache_accesses : 0.0);
+    }
+
+    pthread_mutex_destroy (&sweep->lock);
+    pthread_cond_destroy (&sweep->chunk_ready);
+    pthread_cond_destroy (&sweep->chunk_done);
+    free (sweep->chunks[0]);
+    free (sweep->chunks[1]);
+    free (sweep->workers);
+    free_sweep_configs (sweep);
+    free (sweep);
+}
@@ -0,0 +1,87 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <pthread.h>
+#include "geometry.h"
+#include "cache.h"
+
+// CACHE SWEEP MACROS
+
+// A cache sweep simulates several L1 / L2 cache configurations over the same physical address stream in a single run.
+// The simulation thread translates every trace once (TLBs, page tables) and appends the physical address to a chunk,
+// worker threads feed each full chunk to all swept cache instances while the next chunk is being filled.
+
+// Number of accesses per chunk handed to the worker threads
+#define SWEEP_CHUNK_SIZE 4096
+
+// Limits of a sweep
+#define MAX_SWEEP_CONFIGS 256
+#define MAX_SWEEP_THREADS 32
+
+// CACHE SWEEP ADT DEFINITIONS
+
+// One translated access of the physical address stream
+typedef struct {
+    unsigned int physical_address;
+    unsigned char trace_type;                             // INSTRUCTION or DATA - selects the L1 cache
+    unsigned char access_type;                            // READ_ACCESS or WRITE_ACCESS
+} sweep_access;
+
+// One swept cache configuration - its own L1 instruction / data and L2 cache instances and access stats
+typedef struct {
+    memory_geometry geometry;
+    L1_cache *l1_instr_cache;
+    L1_cache *l1_data_cache;
+    L2_cache *l2_cache;
+    unsigned long long num_l1_cache_accesses;
+    unsigned long long num_l1_cache_hits;
+    unsigned long long num_l1_cache_misses;
+    unsigned long long num_l2_cache_accesses;
+    unsigned long long num_l2_cache_hits;
+    unsigned long long num_l2_cache_misses;
+} sweep_config;
+
+typedef struct cache_sweep cache_sweep;
+
+// Worker thread - simulates the configurations thread_index, thread_index + num_threads, ...
+typedef struct {
+    cache_sweep *sweep;
+    int thread_index;
+    pthread_t thread;
+} sweep_worker;
+
+struct cache_sweep {
+    int num_configs;
+    sweep_config *configs;
+    int num_threads;
+    sweep_worker *workers;
+
+    // Double-buffered chunks - the simulation thread fills one while the workers simulate the other
+    sweep_access *chunks[2];
+    unsigned int fill_chunk;                              // Chunk being filled by the simulation thread
+    unsigned int fill_length;                             // Accesses in the chunk being filled
+
+    // Handoff of the published chunk - guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_ready;                           // Signalled when a chunk is published (or the sweep is stopped)
+    pthread_cond_t chunk_done;                            // Signalled when all workers are done with the published chunk
+    unsigned long generation;                             // Number of chunks published so far
+    unsigned int ready_chunk;                             // Chunk published last
+    unsigned int ready_length;                            // Accesses in the chunk published last
+    int num_done;                                         // Workers done with the chunk published last
+    int stop;                                             // Set once the last chunk has been simulated
+};
+
+// FUNCTION DECLARATIONS
+
+// Reads the sweep file (one configuration per line, given as "<key> <value>" geometry pairs on top of the base geometry),
+// creates the cache instances of all configurations and starts the worker threads - returns NULL on error
+cache_sweep* start_cache_sweep (const char *filename, const memory_geometry *base_geometry);
+
+// Appends a translated access to the current chunk - hands the chunk to the worker threads once it is full
+void record_sweep_access (cache_sweep *sweep, unsigned int physical_address, int trace_type, int access_type);
+
+// Simulates the remaining accesses, stops and joins the worker threads, prints the stats of all configurations and frees the sweep
+void finish_cache_sweep (cache_sweep *sweep);
+
+#endif
@@ -8,6 +8,7 @@ int main (int argc, char *argv[]) {
     unsigned int virtual_address = 0;
     unsigned int page_number = 0;
     unsigned int frame_number = 0;
+    unsigned int shared_bit = 0;
     
     // To maintain TLB access stats
     int num_l1_tlb_accesses = 0;
@@ -19,14 +20,18 @@ int main (int argc, char *argv[]) {
     int num_l2_tlb_misses = 0;
 
     srand(time(0)); 
+
+    // Default TLB geometry
+    memory_geometry geometry;
+    set_default_memory_geometry (&geometry);
     
     // Initialize L1 TLB
     L1_TLB *l1_tlb;
-    l1_tlb = initialize_L1_TLB ();
+    l1_tlb = initialize_L1_TLB (&geometry.l1_tlb);
     
     // Initialize L2 TLB
     L2_TLB *l2_tlb;
-    l2_tlb = initialize_L2_TLB ();   
+    l2_tlb = initialize_L2_TLB (&geometry.l2_tlb);   
     
     // Read memory requests from file
     FILE *fptr;
@@ -63,7 +68,7 @@ int main (int argc, char *argv[]) {
             num_l1_tlb_misses++;
             
             // Search L2 TLB
-            frame_number = search_L2_TLB (l2_tlb, page_number);
+            frame_number = search_L2_TLB (l2_tlb, page_number, &shared_bit);
             num_l2_tlb_accesses++;
             
             // If the returned frame number is within valid range - L2 TLB HIT - frame number acquired
@@ -1,17 +1,28 @@
 #ifndef TLB_H
 #define TLB_H
 
+#include "geometry.h"
+#include "replacement.h"
+
 #define MAX_FRAME_NUMBER 65535
 
-// 8-way set-associative L1 TLB with 16 entries
+// TLB tag compare kernels - the compare loop is specialised (fully unrolled) for the common way counts
+#define TLB_TAG_MATCH_GENERIC 0
+#define TLB_TAG_MATCH_4_WAYS 1
+#define TLB_TAG_MATCH_8_WAYS 2
+#define TLB_TAG_MATCH_16_WAYS 3
+
+// Default geometry - 8-way set-associative L1 TLB with 16 entries
 #define NUM_L1_TLB_WAYS 8
 #define NUM_L1_TLB_SETS 2
 #define NUM_L1_TLB_SET_INDEX_BITS 1    // No. of bits required to address 2 sets -- log_2(2)
+#define L1_TLB_REPLACEMENT_POLICY REPLACEMENT_RANDOM
 
-// 4-way set-associative L2 TLB with 32 entries
+// Default geometry - 4-way set-associative L2 TLB with 32 entries
 #define NUM_L2_TLB_WAYS 4
 #define NUM_L2_TLB_SETS 8
 #define NUM_L2_TLB_SET_INDEX_BITS 3    // No. of bits required to address 8 sets -- log_2(8)
+#define L2_TLB_REPLACEMENT_POLICY REPLACEMENT_LRU
 
 // Valid bit values
 #define VALID 1
@@ -21,78 +32,97 @@
 #define SHARED 1
 #define NOT_SHARED 0
 
-// TLB ADT DEFINITIONS
+// Address space IDs (tlb_asids 1 in geometry files) - entries are tagged with the ASID of the process that filled them and survive context
+// switches. The ASID is kept in the tag word above the page number bits, so an ASID-aware search is still a single SIMD tag compare
+// (plus one for the entries of shared pages, which are tagged with the global ASID and match in every address space).
+#define TLB_ASIDS 0                                            // Default - no ASIDs, the TLBs are flushed at every context switch
+#define TLB_ASID_SHIFT VIRTUAL_PAGE_NUMBER_BITS                // Tags never use more than the page number bits
+#define TLB_ASID_MASK (~0u << TLB_ASID_SHIFT)
+#define TLB_PAGE_TAG_MASK (~TLB_ASID_MASK)
+#define TLB_GLOBAL_ASID ((1u << (32 - TLB_ASID_SHIFT)) - 1)    // ASID of the entries of shared pages
+#define TLB_NUM_ASIDS TLB_GLOBAL_ASID                          // ASIDs handed to processes - 0 .. TLB_NUM_ASIDS - 1
 
-// L1 TLB entry structure 
-
-typedef struct {
-    unsigned int page_tag_entry:22;        // 22-bit tag entry: first 22 bits of 23-bit page number (32-bit virtual address, 9-bit offset - 512B page)
-                                           // remaining 1 bit is used as set index  
-    unsigned int frame_number_entry:16;    // 16-bit frame number (25-bit physical address, 9-bit offset - 512B page)
-    unsigned int valid_bit:1;              // Valid bit - set if the corresponding entry is valid
-    unsigned int shared_bit:1;             // Shared bit - set if the page is shared by two or more processes
-} L1_TLB_entry;
+// Maximum number of accesses simulated as one batch (one L1 TLB batch lookup per run of hits)
+#define TLB_BATCH_MAX 256
 
-// L2 TLB entry structure
+// TLB ADT DEFINITIONS
 
-typedef struct {
-    unsigned int page_tag_entry:20;        // 20-bit tag entry: first 20 bits of 23-bit page number (32-bit virtual address, 9-bit offset - 512B page) 
-                                           // remaining 3 bits are used as set index  
-    unsigned int frame_number_entry:16;    // 16-bit frame number (25-bit physical address, 9-bit offset - 512B page)
-    unsigned int valid_bit:1;              // Valid bit - set if the corresponding entry is valid
-    unsigned int shared_bit:1;             // Shared bit - set if the page is shared by two or more processes
-} L2_TLB_entry;
+// The TLBs are sized at run time from a level_geometry (the NUM_* macros above are the defaults). The entries are stored as
+// structures of arrays - the tags of all the ways of a set are contiguous (entry of way w of set s at index s * num_ways + w), so that
+// one set can be searched with a few SIMD compares, and the valid/shared bits of all ways are packed into one bit mask per set (bit i - way i).
 
 // L1 TLB structures 
 
 typedef struct {
-    L1_TLB_entry l1_tlb_entry[NUM_L1_TLB_WAYS];                // Array of NUM_L1_TLB_WAYS L1 TLB entries per set
-} L1_TLB_sets;
-
-typedef struct {
-    L1_TLB_sets l1_tlb_sets[NUM_L1_TLB_SETS];                  // And array of NUM_L1_TLB_SETS such sets make L1 TLB
+    level_geometry geometry;                                   // Sets, ways and the derived set index shift / mask
+    int tag_match_kernel;                                      // Tag compare kernel specialised for the number of ways (TLB_TAG_MATCH_*)
+    unsigned int *page_tag_entry;                              // Tag entries: page number bits above the set index bits (ASID above them)
+    unsigned short *frame_number_entry;                        // 16-bit frame numbers (25-bit physical address, 9-bit offset - 512B page)
+    unsigned int *valid_bits;                                  // Valid bits per set - bit i set if the entry in way i is valid
+    unsigned int *shared_bits;                                 // Shared bits per set - bit i set if the page in way i is shared by two or more processes
+    unsigned int asid_tag;                                     // ASID of the running process, in its tag word position (0 without ASIDs)
+    unsigned int global_asid_tag;                              // ASID bits of the tags of shared pages (equal to asid_tag without ASIDs)
+    replacement_state replacement;                             // Replacement policy state (random by default)
 } L1_TLB;
 
 // L2 TLB structures
 
 typedef struct {
-    L2_TLB_entry l2_tlb_entry[NUM_L2_TLB_WAYS];                // Array of NUM_L2_TLB_WAYS L1 TLB entries per set
-    int lru_square_matrix[NUM_L2_TLB_WAYS][NUM_L2_TLB_WAYS];   // LRU square matrix is maintained per set
-} L2_TLB_sets;
-
-typedef struct {
-    L2_TLB_sets l2_tlb_sets[NUM_L2_TLB_SETS];                  // And array of NUM_L2_TLB_SETS such sets make L2 TLB
+    level_geometry geometry;                                   // Sets, ways and the derived set index shift / mask
+    int tag_match_kernel;                                      // Tag compare kernel specialised for the number of ways (TLB_TAG_MATCH_*)
+    unsigned int *page_tag_entry;                              // Tag entries: page number bits above the set index bits (ASID above them)
+    unsigned short *frame_number_entry;                        // 16-bit frame numbers (25-bit physical address, 9-bit offset - 512B page)
+    unsigned int *valid_bits;                                  // Valid bits per set - bit i set if the entry in way i is valid
+    unsigned int *shared_bits;                                 // Shared bits per set - bit i set if the page in way i is shared by two or more processes
+    unsigned int asid_tag;                                     // ASID of the running process, in its tag word position (0 without ASIDs)
+    unsigned int global_asid_tag;                              // ASID bits of the tags of shared pages (equal to asid_tag without ASIDs)
+    replacement_state replacement;                             // Replacement policy state (LRU by default)
 } L2_TLB;
 
 // FUNCTION DECLARATIONS
 
-// Initializes the L1 TLB by allocating memory for the structure and initializing all the entries by marking them as invalid
-L1_TLB *initialize_L1_TLB ();                                             
+// Initializes the L1 TLB by allocating memory for the structure with the given geometry and initializing all the entries by marking them as invalid
+L1_TLB *initialize_L1_TLB (const level_geometry *geometry);                                             
+
+// Initializes the L2 TLB by y allocating memory for the structure with the given geometry, invalidating all the entries and initializing the replacement state
+L2_TLB *initialize_L2_TLB (const level_geometry *geometry);                                             
 
-// Initializes the L2 TLB by y allocating memory for the structure, invalidating all the entries and initializing lru square matrix by setting all bits to 0
-L2_TLB *initialize_L2_TLB ();                                             
+// Frees the L1 TLB structure and its entry arrays
+void free_L1_TLB (L1_TLB* l1_tlb);
+
+// Frees the L2 TLB structure and its entry arrays
+void free_L2_TLB (L2_TLB* l2_tlb);
 
 // Search the L1 TLB for the frame number entry corresponding to the requested page 
 unsigned int search_L1_TLB (L1_TLB* l1_tlb, unsigned int page_number);    
 
-// If the L1 TLB access results in a miss - Search the L2 TLB for the frame number entry corresponding to the requested page 
-unsigned int search_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number);    
+// If the L1 TLB access results in a miss - Search the L2 TLB for the frame number entry corresponding to the requested page (and its shared bit)
+unsigned int search_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number, unsigned int* shared_bit);    
+
+// Translate the leading page numbers of a batch with the L1 TLB up to the first miss - returns the number of hits, frame_numbers[i] set for each
+int search_L1_TLB_batch (L1_TLB* l1_tlb, const unsigned int* page_numbers, int num_pages, unsigned int* frame_numbers);
 
-// Update L1 TLB with the entry acquired via page table walk - placement / random replacement
+// Update L1 TLB with the entry acquired via page table walk - placement / replacement (random by default), the replaced entry moves to the L2 TLB
 void update_L1_TLB (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int pg_num, unsigned int frame_num, unsigned int shared_bit);
 
-// Update L2 TLB with the entry replaced in L1 TLB or the entry acquired via page table walk - placement / LRU replacement 
+// Update L2 TLB with the entry replaced in L1 TLB or the entry acquired via page table walk - placement / replacement (LRU by default)
 void update_L2_TLB (L2_TLB* l2_tlb, unsigned int pg_num, unsigned int frame_num, unsigned int shared_bit);
 
-// Get the Least Recently Used entry's way index from LRU square matrix (index of the first row with all bits 0)
-int get_LRU_entry_index (L2_TLB* l2_tlb, int set_index);                  
-
 // Flush (invalidate) all the entries, except for those corresponding to shared pages, from L1 TLB
 void flush_L1_TLB (L1_TLB* l1_tlb);                                       
 
 // Flush (invalidate) all the entries, except for those corresponding to shared pages, from L2 TLB
 void flush_L2_TLB (L2_TLB* l2_tlb);
 
+// Tags the searches and fills from now on with the given ASID (TLBs with ASIDs - until then every entry has ASID 0, as without ASIDs)
+void set_TLB_asid (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int asid);
+
+// Invalidates the entries of the given ASID in both TLBs (the entries of shared pages have the global ASID and are kept)
+void invalidate_TLB_asid (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int asid);
+
+// Invalidates the entries translating the page to the given frame in both TLBs, whatever their ASID (the page left main memory)
+void invalidate_TLB_page (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number);
+
 // Print all L1 TLB entries                                       
 void print_L1_tlb (L1_TLB* l1_tlb);    
 
@@ -2,294 +2,454 @@
 #include <stdlib.h>
 #include "tlb.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Compares the given tag with the tags of all the ways of a set - returns a bit mask with bit i set if the tag in way i matches.
+// With SSE2 four ways are compared per instruction (L1 TLB set - 2 compares, L2 TLB set - 1 compare). The valid bits are not checked here.
+// Always inlined, so that calls with a constant number of ways (see match_TLB_set) compile into fully unrolled compare kernels.
+
+static inline __attribute__ ((always_inline)) unsigned int match_TLB_tags (const unsigned int* page_tags, unsigned int num_ways, unsigned int tag) {
+    unsigned int match_mask = 0;
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    __m128i search_tag = _mm_set1_epi32 ((int) tag);
+
+    for (; i + 4 <= num_ways; i = i + 4) {
+        __m128i way_tags = _mm_loadu_si128 ((const __m128i *) (page_tags + i));
+        match_mask |= (unsigned int) _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (way_tags, search_tag))) << i;
+    }
+#endif
+
+    for (; i < num_ways; i++) {
+        if (page_tags[i] == tag)
+            match_mask |= 1u << i;
+    }
+
+    return match_mask;
+}
+
+// Compares the given tag with the tags of a set using the compare kernel selected for the way count of the TLB.
+
+static inline unsigned int match_TLB_set (int tag_match_kernel, const unsigned int* page_tags, unsigned int num_ways, unsigned int tag) {
+    switch (tag_match_kernel) {
+        case TLB_TAG_MATCH_4_WAYS:
+            return match_TLB_tags (page_tags, 4, tag);
+        case TLB_TAG_MATCH_8_WAYS:
+            return match_TLB_tags (page_tags, 8, tag);
+        case TLB_TAG_MATCH_16_WAYS:
+            return match_TLB_tags (page_tags, 16, tag);
+        default:
+            return match_TLB_tags (page_tags, num_ways, tag);
+    }
+}
+
+// Compares the given tag with the tags of a set in the address space of the running process - its own entries (tag word with its ASID)
+// and those of shared pages (global ASID). Without ASIDs both ASIDs are 0 and only one compare is made.
+
+static inline unsigned int match_TLB_address_space (int tag_match_kernel, const unsigned int* page_tags, unsigned int num_ways, unsigned int tag,
+                                                    unsigned int asid_tag, unsigned int global_asid_tag) {
+    unsigned int match_mask = match_TLB_set (tag_match_kernel, page_tags, num_ways, tag | asid_tag);
+
+    if (global_asid_tag != asid_tag)
+        match_mask |= match_TLB_set (tag_match_kernel, page_tags, num_ways, tag | global_asid_tag);
+    return match_mask;
+}
+
+// Selects the tag compare kernel for the given number of ways.
+
+static int get_TLB_tag_match_kernel (unsigned int num_ways) {
+    switch (num_ways) {
+        case 4:
+            return TLB_TAG_MATCH_4_WAYS;
+        case 8:
+            return TLB_TAG_MATCH_8_WAYS;
+        case 16:
+            return TLB_TAG_MATCH_16_WAYS;
+        default:
+            return TLB_TAG_MATCH_GENERIC;
+    }
+}
+
 // Creates an empty L1 TLB structure with the given specifications and initializes the structure by marking all the TLB entries as INVALID.
 
-L1_TLB* initialize_L1_TLB () {
+L1_TLB* initialize_L1_TLB (const level_geometry *geometry) {
+    unsigned int num_entries = geometry->num_sets * geometry->num_ways;
 
     // Create an empty L1 TLB structure
     L1_TLB *l1_tlb;
     l1_tlb = (L1_TLB *) malloc (sizeof (L1_TLB));
 
-    int i = 0;
-    int j = 0;
-    
+    l1_tlb->geometry = *geometry;
+    l1_tlb->tag_match_kernel = get_TLB_tag_match_kernel (geometry->num_ways);
+
     // Initialize the L1 TLB with all entries marked INVALID
-    for (i = 0; i < NUM_L1_TLB_SETS; i++) {
-        for (j = 0; j < NUM_L1_TLB_WAYS; j++)
-            l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].valid_bit = INVALID;
-    }
-    
+    l1_tlb->page_tag_entry = (unsigned int *) calloc (num_entries, sizeof (unsigned int));
+    l1_tlb->frame_number_entry = (unsigned short *) calloc (num_entries, sizeof (unsigned short));
+    l1_tlb->valid_bits = (unsigned int *) calloc (geometry->num_sets, sizeof (unsigned int));
+    l1_tlb->shared_bits = (unsigned int *) calloc (geometry->num_sets, sizeof (unsigned int));
+    l1_tlb->asid_tag = 0;
+    l1_tlb->global_asid_tag = 0;
+
+    // Initialize the L1 TLB replacement state
+    initialize_replacement_state (&l1_tlb->replacement, geometry);
+
     // Return pointer to L1 TLB structure
     return l1_tlb;
 }
 
-// Creates an empty L2 TLB structure with the given specifications and initializes the structure by marking all the TLB entries as INVALID 
-// and initializing all entries of LRU square matrix as 0.
+// Creates an empty L2 TLB structure with the given specifications and initializes the structure by marking all the TLB entries as INVALID
+// and initializing its replacement state.
 
-L2_TLB* initialize_L2_TLB () {
+L2_TLB* initialize_L2_TLB (const level_geometry *geometry) {
+    unsigned int num_entries = geometry->num_sets * geometry->num_ways;
 
     // Create an empty L2 TLB structure
     L2_TLB *l2_tlb;
     l2_tlb = (L2_TLB *) malloc (sizeof (L2_TLB));
 
-    int i = 0;
-    int j = 0;
-    int k = 0;
-    
+    l2_tlb->geometry = *geometry;
+    l2_tlb->tag_match_kernel = get_TLB_tag_match_kernel (geometry->num_ways);
+
     // Initialize the L2 TLB with all entries marked INVALID
-    for (i = 0; i < NUM_L2_TLB_SETS; i++) {
-        for (j = 0; j < NUM_L2_TLB_WAYS; j++)
-            l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].valid_bit = INVALID;
-    }
-        
-    // Initialize the L2 TLB LRU counters to 0
-    for (i = 0; i < NUM_L2_TLB_SETS; i++) {
-        for (j = 0; j < NUM_L2_TLB_WAYS; j++) {
-            for (k = 0; k < NUM_L2_TLB_WAYS; k++)
-                l2_tlb->l2_tlb_sets[i].lru_square_matrix[j][k] = 0;
-        }
-    }
-    
+    l2_tlb->page_tag_entry = (unsigned int *) calloc (num_entries, sizeof (unsigned int));
+    l2_tlb->frame_number_entry = (unsigned short *) calloc (num_entries, sizeof (unsigned short));
+    l2_tlb->valid_bits = (unsigned int *) calloc (geometry->num_sets, sizeof (unsigned int));
+    l2_tlb->shared_bits = (unsigned int *) calloc (geometry->num_sets, sizeof (unsigned int));
+    l2_tlb->asid_tag = 0;
+    l2_tlb->global_asid_tag = 0;
+
+    // Initialize the L2 TLB replacement state
+    initialize_replacement_state (&l2_tlb->replacement, geometry);
+
     // Return pointer to L2 TLB structure
     return l2_tlb;
 }
 
-// Searches the L1 TLB for an entry corresponding to the given page number. 
+// Frees the L1 TLB structure.
+
+void free_L1_TLB (L1_TLB* l1_tlb) {
+    free (l1_tlb->page_tag_entry);
+    free (l1_tlb->frame_number_entry);
+    free (l1_tlb->valid_bits);
+    free (l1_tlb->shared_bits);
+    free_replacement_state (&l1_tlb->replacement);
+    free (l1_tlb);
+}
+
+// Frees the L2 TLB structure.
+
+void free_L2_TLB (L2_TLB* l2_tlb) {
+    free (l2_tlb->page_tag_entry);
+    free (l2_tlb->frame_number_entry);
+    free (l2_tlb->valid_bits);
+    free (l2_tlb->shared_bits);
+    free_replacement_state (&l2_tlb->replacement);
+    free (l2_tlb);
+}
+
+// Searches the L1 TLB for an entry corresponding to the given page number.
 // If HIT returns corresponding frame number, else returns an invalid (out of range) frame number.
 
 unsigned int search_L1_TLB (L1_TLB* l1_tlb, unsigned int page_number) {
-    unsigned int frame_number = 0;
+    unsigned int hit_mask = 0;
+    unsigned int num_ways = l1_tlb->geometry.num_ways;
     int i = 0;
-    
+
     // Extracting the tag and index fields from the given page number
-    int set_index = page_number % NUM_L1_TLB_SETS;
-    int tag = page_number >> NUM_L1_TLB_SET_INDEX_BITS;    
-    
-    // Search L1 TLB
-    for (i = 0; i < NUM_L1_TLB_WAYS; i++) {
-    
-        // If the entry is VALID and the tag value matches the page entry tag bits -- Found!
-        if (l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].valid_bit == VALID && l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].page_tag_entry == tag) {
-        
-            // Get corresponding frame number
-            frame_number = l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].frame_number_entry;
-            printf (" Entry found in L1 TLB set %d, way %d Page entry (tag): %x, Frame entry (tag): %x\n", set_index, i+1, tag, l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].frame_number_entry);
-            break;
-        }        
+    unsigned int set_index = page_number & l1_tlb->geometry.set_index_mask;
+    unsigned int tag = page_number >> l1_tlb->geometry.set_index_bits;
+
+    // Search L1 TLB - ways whose entry is VALID and whose tag value matches the page entry tag bits (in the address space of the running process)
+    hit_mask = match_TLB_address_space (l1_tlb->tag_match_kernel, l1_tlb->page_tag_entry + set_index * num_ways, num_ways, tag, l1_tlb->asid_tag, l1_tlb->global_asid_tag)
+               & l1_tlb->valid_bits[set_index];
+
+    // If entry found in L1 TLB - update the replacement state and return frame number
+    if (hit_mask != 0) {
+        i = __builtin_ctz (hit_mask);
+        // printf (" Entry found in L1 TLB set %d, way %d Page entry (tag): %x, Frame entry (tag): %x\n", set_index, i+1, tag, l1_tlb->frame_number_entry[set_index * num_ways + i]);
+        replacement_on_hit (&l1_tlb->replacement, set_index, i);
+        return l1_tlb->frame_number_entry[set_index * num_ways + i];
     }
-    
-    // If entry found in L1 TLB - return frame number
-    if (i < NUM_L1_TLB_WAYS) 
-        return frame_number;
-        
+
     // Else NOT found - return invalid frame number to indicate a MISS
-    else 
+    else
         return -1;
 }
 
-// Searches the L2 TLB for an entry corresponding to the given page number. 
-// If HIT - updates LRU square matrix and returns corresponding frame number, else returns an invalid (out of range) frame number. 
- 
-unsigned int search_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number) {
-    unsigned int frame_number = 0;
+// Searches the L2 TLB for an entry corresponding to the given page number.
+// If HIT - updates the replacement state, sets the shared bit of the entry and returns corresponding frame number, else returns an invalid
+// (out of range) frame number.
+
+unsigned int search_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number, unsigned int* shared_bit) {
+    unsigned int hit_mask = 0;
+    unsigned int num_ways = l2_tlb->geometry.num_ways;
     int i = 0;
-    
+
     // Extracting the tag and index fields from the given page number
-    int set_index = page_number % NUM_L2_TLB_SETS;
-    int tag = page_number >> NUM_L2_TLB_SET_INDEX_BITS;
-    
-    for (i = 0; i < NUM_L2_TLB_WAYS; i++) {
-    
-        // If the entry is VALID and the tag value matches the page entry tag bits -- Found!
-        if (l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].valid_bit == VALID && l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].page_tag_entry == tag) {
-        
-            // Get corresponding frame number
-            frame_number = l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].frame_number_entry;
-            printf (" Entry found in L2 TLB set %d, way %d Page entry (tag): %x, Frame entry (tag): %x\n", set_index, i+1, tag, l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].frame_number_entry);
-            
-            // Update the LRU square matrix
-            for (int j = 0; j < NUM_L2_TLB_WAYS; j++)
-                l2_tlb->l2_tlb_sets[set_index].lru_square_matrix[i][j] = 1;   // Row bits corresponding to accessed way made 1
-            for (int j = 0; j < NUM_L2_TLB_WAYS; j++)
-                l2_tlb->l2_tlb_sets[set_index].lru_square_matrix[j][i] = 0;   // Column bits corresponding to accessed way made 0  
-                                
-            break;
-        }        
+    unsigned int set_index = page_number & l2_tlb->geometry.set_index_mask;
+    unsigned int tag = page_number >> l2_tlb->geometry.set_index_bits;
+
+    // Search L2 TLB - ways whose entry is VALID and whose tag value matches the page entry tag bits (in the address space of the running process)
+    hit_mask = match_TLB_address_space (l2_tlb->tag_match_kernel, l2_tlb->page_tag_entry + set_index * num_ways, num_ways, tag, l2_tlb->asid_tag, l2_tlb->global_asid_tag)
+               & l2_tlb->valid_bits[set_index];
+
+    // If entry found in L2 TLB -- update the replacement state and return frame number
+    if (hit_mask != 0) {
+        i = __builtin_ctz (hit_mask);
+        // printf (" Entry found in L2 TLB set %d, way %d Page entry (tag): %x, Frame entry (tag): %x\n", set_index, i+1, tag, l2_tlb->frame_number_entry[set_index * num_ways + i]);
+
+        // Update the replacement state
+        replacement_on_hit (&l2_tlb->replacement, set_index, i);
+
+        *shared_bit = (l2_tlb->shared_bits[set_index] >> i) & 1;
+        return l2_tlb->frame_number_entry[set_index * num_ways + i];
     }
-    
-    // If entry found in L2 TLB -- return frame number
-    if (i < NUM_L2_TLB_WAYS) 
-        return frame_number;
-        
+
     // Else, entry NOT found -- return invalid frame number to indicate a MISS
-    else 
+    else
         return -1;
 }
 
-// Updates the L1 TLB with the entry (page number, corresponding frame number) fetched from the main memory. 
-// Depending on the availability of free slots an entry is PLACED/REPLACED in the TLB. 
-// If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there. 
-// Else, REPLACE any of the way entries with required set index using RANDOM REPLACEMENT, add the entry replaced in L1 TLB to L2 TLB. 
+// Translates the leading page numbers of a batch with the L1 TLB, up to the first miss. Hits only change the replacement state (updated
+// in batch order, exactly as search_L1_TLB does), not the contents, so every page before the first miss is searched against the same
+// contents and gets the translation it would get on its own. Returns the number of pages that hit - frame_numbers[i] holds the frame
+// number of page_numbers[i] for each of them. The missing page is left to the caller (the search has no effect on a miss).
 
-void update_L1_TLB (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number, unsigned int shared_bit) {
+int search_L1_TLB_batch (L1_TLB* l1_tlb, const unsigned int* page_numbers, int num_pages, unsigned int* frame_numbers) {
+    unsigned int num_ways = l1_tlb->geometry.num_ways;
+    unsigned int way_hit_mask = 0;
+    unsigned int set_index = 0;
     int i = 0;
-    int random_replacement = 0; // Way number to be replaced - randomly selected
-    
-    // Extracting the tag and index fields from the given page number
-    int set_index = page_number % NUM_L1_TLB_SETS;
-    int tag = page_number >> NUM_L1_TLB_SET_INDEX_BITS;
 
-    // PLACEMENT: If there are INVALID entries in L1 TLB, PLACE this entry in the first INVALID entry's slot    
-    // Look for INVALID entry corresponding to the given set index
-    for (i = 0; i < NUM_L1_TLB_WAYS; i++) {
-        if (l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].valid_bit == INVALID) {
-            l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].page_tag_entry = tag; 
-            l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].frame_number_entry = frame_number; 
-            l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].valid_bit = VALID;
-            l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[i].shared_bit = shared_bit;
+    for (i = 0; i < num_pages; i++) {
+        set_index = page_numbers[i] & l1_tlb->geometry.set_index_mask;
+        way_hit_mask = match_TLB_address_space (l1_tlb->tag_match_kernel, l1_tlb->page_tag_entry + set_index * num_ways, num_ways, page_numbers[i] >> l1_tlb->geometry.set_index_bits,
+                                                l1_tlb->asid_tag, l1_tlb->global_asid_tag) & l1_tlb->valid_bits[set_index];
+        if (way_hit_mask == 0)
             break;
-        }        
-    }
-    
-    // REPLACEMENT: if all entries of the given set index are VALID, randomly REPLACE any entry
-    if (i == NUM_L1_TLB_WAYS) {
-        random_replacement = rand() % NUM_L1_TLB_WAYS;
-        
-        // Update L2 TLB with the entry to be replaced
-        update_L2_TLB (l2_tlb, l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].page_tag_entry << NUM_L1_TLB_SET_INDEX_BITS,
-        l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].frame_number_entry, 
-        l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].shared_bit);
-        
-        // Replace entry in L1 TLB
-        l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].page_tag_entry = tag; 
-        l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].frame_number_entry = frame_number; 
-        l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].valid_bit = VALID;
-        l1_tlb->l1_tlb_sets[set_index].l1_tlb_entry[random_replacement].shared_bit = shared_bit;
-        
+
+        frame_numbers[i] = l1_tlb->frame_number_entry[set_index * num_ways + __builtin_ctz (way_hit_mask)];
+        replacement_on_hit (&l1_tlb->replacement, set_index, __builtin_ctz (way_hit_mask));
     }
+    return i;
 }
 
-// Updates the L2 TLB with the entry (page number, corresponding frame number) fetched from the main memory. 
-// Depending on the availability of free slots an entry is PLACED/REPLACED in the TLB. 
-// If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there. 
-// Else, REPLACE the LRU way entry with required set index (way index obtained by checking the LRU square matrix corresponding to the required set index).
+static void fill_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number, unsigned int shared_bit, unsigned int asid_tag);
 
-void update_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number, unsigned int shared_bit) {
+// Updates the L1 TLB with the entry (page number, corresponding frame number) fetched from the main memory.
+// Depending on the availability of free slots an entry is PLACED/REPLACED in the TLB.
+// If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there.
+// Else, REPLACE the way entry chosen by the L1 TLB replacement policy (RANDOM REPLACEMENT by default), add the entry replaced in L1 TLB to L2 TLB.
+
+void update_L1_TLB (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number, unsigned int shared_bit) {
+    unsigned int num_ways = l1_tlb->geometry.num_ways;
     int i = 0;
-    int LRU_replacement = 0;  // Way number to be replaced - selected using LRU scheme
-    
-    // Extracting the tag and index fields from the given page number
-    int set_index = page_number % NUM_L2_TLB_SETS;
-    int tag = page_number >> NUM_L2_TLB_SET_INDEX_BITS;
+    int victim_way = 0;         // Way number to be replaced - chosen by the replacement policy
+    unsigned int invalid_ways = 0;
 
+    // Extracting the tag and index fields from the given page number
+    unsigned int set_index = page_number & l1_tlb->geometry.set_index_mask;
+    unsigned int tag = page_number >> l1_tlb->geometry.set_index_bits;
+    unsigned int *page_tag_entry = l1_tlb->page_tag_entry + set_index * num_ways;
+    unsigned short *frame_number_entry = l1_tlb->frame_number_entry + set_index * num_ways;
 
-    // PLACEMENT: If there are INVALID entries in L1 TLB, PLACE this entry in the first INVALID entry's slot    
+    // PLACEMENT: If there are INVALID entries in L1 TLB, PLACE this entry in the first INVALID entry's slot
     // Look for INVALID entry corresponding to the given set index
-    for (i = 0; i < NUM_L2_TLB_WAYS; i++) {
-        if (l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].valid_bit == INVALID) {
-            l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].page_tag_entry = tag; 
-            l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].frame_number_entry = frame_number; 
-            l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].valid_bit = VALID;
-            l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[i].shared_bit = shared_bit;
-            break;
-        }        
+    invalid_ways = ~l1_tlb->valid_bits[set_index] & l1_tlb->geometry.way_mask;
+
+    if (invalid_ways != 0) {
+        i = __builtin_ctz (invalid_ways);
     }
-    
-    // REPLACEMENT: if all entries of the given set index are VALID, REPLACE Least Recently Used (LRU) entry
-    if (i == NUM_L2_TLB_WAYS) {
-        LRU_replacement = get_LRU_entry_index (l2_tlb, set_index);
-        l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[LRU_replacement].page_tag_entry = tag; 
-        l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[LRU_replacement].frame_number_entry = frame_number; 
-        l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[LRU_replacement].valid_bit = VALID;
-        l2_tlb->l2_tlb_sets[set_index].l2_tlb_entry[LRU_replacement].shared_bit = shared_bit;
+
+    // REPLACEMENT: if all entries of the given set index are VALID, REPLACE the entry chosen by the replacement policy
+    else {
+        victim_way = replacement_choose_victim (&l1_tlb->replacement, set_index);
+
+        // Update L2 TLB with the entry to be replaced - it keeps its ASID (not necessarily the running process's)
+        fill_L2_TLB (l2_tlb, ((page_tag_entry[victim_way] & TLB_PAGE_TAG_MASK) << l1_tlb->geometry.set_index_bits) | set_index,
+        frame_number_entry[victim_way],
+        (l1_tlb->shared_bits[set_index] >> victim_way) & 1, page_tag_entry[victim_way] & TLB_ASID_MASK);
+
+        i = victim_way;
     }
+
+    // Place / replace entry in L1 TLB - tagged with the ASID of the running process (global ASID for shared pages)
+    page_tag_entry[i] = tag | ((shared_bit == SHARED) ? l1_tlb->global_asid_tag : l1_tlb->asid_tag);
+    frame_number_entry[i] = frame_number;
+    l1_tlb->valid_bits[set_index] |= 1u << i;
+    if (shared_bit == SHARED)
+        l1_tlb->shared_bits[set_index] |= 1u << i;
+    else
+        l1_tlb->shared_bits[set_index] &= ~(1u << i);
+    replacement_on_fill (&l1_tlb->replacement, set_index, i);
 }
 
-// Get the L2 TLB LRU way index for given set. (The LRU way index is given by the row number with all bits set to 0).
+// Updates the L2 TLB with the entry (page number, corresponding frame number) fetched from the main memory.
+// Depending on the availability of free slots an entry is PLACED/REPLACED in the TLB.
+// If an INVALID entry is available in any of the ways corresponding to the required set index, PLACE the new entry there.
+// Else, REPLACE the way entry chosen by the L2 TLB replacement policy (LRU REPLACEMENT by default).
 
-int get_LRU_entry_index (L2_TLB* l2_tlb, int set_index) {
-    int LRU_entry_index = 0;
-    int zero_count = 0;
+// The tag of the entry gets the given ASID bits (tag word position).
+
+static void fill_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number, unsigned int shared_bit, unsigned int asid_tag) {
+    unsigned int num_ways = l2_tlb->geometry.num_ways;
     int i = 0;
-    int j = 0;
-    
-    // Find the first row in the LRU square matrix counter with all entries set to 0
-    for (i = 0; i < NUM_L2_TLB_WAYS; i++) {
-        zero_count = 0;
-        for (j = 0; j < NUM_L2_TLB_WAYS; j++) {
-            if (l2_tlb->l2_tlb_sets[set_index].lru_square_matrix[i][j] == 0)
-                zero_count++;          
-        }
-        if (zero_count == NUM_L2_TLB_WAYS)
-            break;
-    }
-    return i;
+    unsigned int invalid_ways = 0;
+
+    // Extracting the tag and index fields from the given page number
+    unsigned int set_index = page_number & l2_tlb->geometry.set_index_mask;
+    unsigned int tag = page_number >> l2_tlb->geometry.set_index_bits;
+
+    // PLACEMENT: If there are INVALID entries in L2 TLB, PLACE this entry in the first INVALID entry's slot
+    // Look for INVALID entry corresponding to the given set index
+    invalid_ways = ~l2_tlb->valid_bits[set_index] & l2_tlb->geometry.way_mask;
+
+    if (invalid_ways != 0)
+        i = __builtin_ctz (invalid_ways);
+
+    // REPLACEMENT: if all entries of the given set index are VALID, REPLACE the entry chosen by the replacement policy
+    else
+        i = replacement_choose_victim (&l2_tlb->replacement, set_index);
+
+    l2_tlb->page_tag_entry[set_index * num_ways + i] = tag | asid_tag;
+    l2_tlb->frame_number_entry[set_index * num_ways + i] = frame_number;
+    l2_tlb->valid_bits[set_index] |= 1u << i;
+    if (shared_bit == SHARED)
+        l2_tlb->shared_bits[set_index] |= 1u << i;
+    else
+        l2_tlb->shared_bits[set_index] &= ~(1u << i);
+    replacement_on_fill (&l2_tlb->replacement, set_index, i);
 }
 
-// Flushes all L1 TLB entries (except for the ones corresponding to shared pages), by marking them as INVALID. 
+void update_L2_TLB (L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number, unsigned int shared_bit) {
+    fill_L2_TLB (l2_tlb, page_number, frame_number, shared_bit, (shared_bit == SHARED) ? l2_tlb->global_asid_tag : l2_tlb->asid_tag);
+}
+
+// Flushes all L1 TLB entries (except for the ones corresponding to shared pages), by marking them as INVALID (the oldest entries of the replacement state).
 
 void flush_L1_TLB (L1_TLB* l1_tlb) {
-    int i = 0;
-    int j = 0;
-    
+    unsigned int i = 0;
+
     // Flush L1 TLB with all entries (except for SHARED) -- mark INVALID
-    for (i = 0; i < NUM_L1_TLB_SETS; i++) {
-        for (j = 0; j < NUM_L1_TLB_WAYS; j++) {
-            if (l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].shared_bit == NOT_SHARED)
-                l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].valid_bit = INVALID;
-        }
+    for (i = 0; i < l1_tlb->geometry.num_sets; i++) {
+        replacement_on_invalidate (&l1_tlb->replacement, i, ~l1_tlb->shared_bits[i] & l1_tlb->geometry.way_mask);
+        l1_tlb->valid_bits[i] &= l1_tlb->shared_bits[i];
     }
 }
 
-// Flushes all L2 TLB entries (except for the ones corresponding to shared pages), by marking them as INVALID and resets the LRU square matrices corresponding to all sets to 0. 
+// Flushes all L2 TLB entries (except for the ones corresponding to shared pages), by marking them as INVALID and resets their replacement state
+// (the LRU bit matrix rows of the flushed entries to 0 with the default LRU policy).
 
 void flush_L2_TLB (L2_TLB* l2_tlb) {
-    int i = 0;
-    int j = 0;
-    int k = 0;
-    
+    unsigned int i = 0;
+
     // Flush L2 TLB with all entries (except for SHARED) -- mark INVALID
-    for (i = 0; i < NUM_L2_TLB_SETS; i++) {
-        for (j = 0; j < NUM_L2_TLB_WAYS; j++) {
-            if (l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].shared_bit == NOT_SHARED)
-                l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].valid_bit = INVALID;
-        }
+    for (i = 0; i < l2_tlb->geometry.num_sets; i++) {
+        replacement_on_invalidate (&l2_tlb->replacement, i, ~l2_tlb->shared_bits[i] & l2_tlb->geometry.way_mask);
+        l2_tlb->valid_bits[i] &= l2_tlb->shared_bits[i];
     }
-        
-    // Reset all the L2 TLB LRU square matrices to 0
-    for (i = 0; i < NUM_L2_TLB_SETS; i++) {
-        for (j = 0; j < NUM_L2_TLB_WAYS; j++) {
-            for (k = 0; k < NUM_L2_TLB_WAYS; k++) {
-                if (l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].shared_bit == NOT_SHARED)
-                    l2_tlb->l2_tlb_sets[i].lru_square_matrix[j][k] = 0;
-            }
-        }
+}
+
+// Sets the ASID of the running process - the global ASID of shared pages is set along with it, which turns on the second tag compare.
+
+void set_TLB_asid (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int asid) {
+    l1_tlb->asid_tag = asid << TLB_ASID_SHIFT;
+    l1_tlb->global_asid_tag = TLB_GLOBAL_ASID << TLB_ASID_SHIFT;
+    l2_tlb->asid_tag = asid << TLB_ASID_SHIFT;
+    l2_tlb->global_asid_tag = TLB_GLOBAL_ASID << TLB_ASID_SHIFT;
+}
+
+// Invalidates the VALID ways of one set whose tag carries the given ASID bits (the oldest entries of the replacement state).
+
+static void invalidate_TLB_set_asid (unsigned int* page_tags, unsigned int* valid_bits, replacement_state* replacement, unsigned int set_index,
+                                     unsigned int num_ways, unsigned int asid_tag) {
+    unsigned int asid_ways = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < num_ways; i++) {
+        if ((page_tags[i] & TLB_ASID_MASK) == asid_tag)
+            asid_ways |= 1u << i;
+    }
+    asid_ways &= *valid_bits;
+
+    if (asid_ways != 0) {
+        replacement_on_invalidate (replacement, set_index, asid_ways);
+        *valid_bits &= ~asid_ways;
     }
 }
 
+void invalidate_TLB_asid (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int asid) {
+    unsigned int i = 0;
+
+    for (i = 0; i < l1_tlb->geometry.num_sets; i++)
+        invalidate_TLB_set_asid (l1_tlb->page_tag_entry + i * l1_tlb->geometry.num_ways, &l1_tlb->valid_bits[i], &l1_tlb->replacement, i,
+                                 l1_tlb->geometry.num_ways, asid << TLB_ASID_SHIFT);
+    for (i = 0; i < l2_tlb->geometry.num_sets; i++)
+        invalidate_TLB_set_asid (l2_tlb->page_tag_entry + i * l2_tlb->geometry.num_ways, &l2_tlb->valid_bits[i], &l2_tlb->replacement, i,
+                                 l2_tlb->geometry.num_ways, asid << TLB_ASID_SHIFT);
+}
+
+// Invalidates the VALID ways of one set holding the given page tag (any ASID) and frame number (the oldest entries of the replacement state).
+
+static void invalidate_TLB_set_page (const unsigned int* page_tags, const unsigned short* frame_numbers, unsigned int* valid_bits, replacement_state* replacement,
+                                     unsigned int set_index, unsigned int num_ways, unsigned int tag, unsigned int frame_number) {
+    unsigned int page_ways = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < num_ways; i++) {
+        if ((page_tags[i] & TLB_PAGE_TAG_MASK) == tag && frame_numbers[i] == frame_number)
+            page_ways |= 1u << i;
+    }
+    page_ways &= *valid_bits;
+
+    if (page_ways != 0) {
+        replacement_on_invalidate (replacement, set_index, page_ways);
+        *valid_bits &= ~page_ways;
+    }
+}
+
+// The page number alone is not enough - with ASIDs another process may have the same page number cached for a frame of its own.
+
+void invalidate_TLB_page (L1_TLB* l1_tlb, L2_TLB* l2_tlb, unsigned int page_number, unsigned int frame_number) {
+    unsigned int set_index = page_number & l1_tlb->geometry.set_index_mask;
+
+    invalidate_TLB_set_page (l1_tlb->page_tag_entry + set_index * l1_tlb->geometry.num_ways, l1_tlb->frame_number_entry + set_index * l1_tlb->geometry.num_ways,
+                             &l1_tlb->valid_bits[set_index], &l1_tlb->replacement, set_index, l1_tlb->geometry.num_ways,
+                             page_number >> l1_tlb->geometry.set_index_bits, frame_number);
+
+    set_index = page_number & l2_tlb->geometry.set_index_mask;
+    invalidate_TLB_set_page (l2_tlb->page_tag_entry + set_index * l2_tlb->geometry.num_ways, l2_tlb->frame_number_entry + set_index * l2_tlb->geometry.num_ways,
+                             &l2_tlb->valid_bits[set_index], &l2_tlb->replacement, set_index, l2_tlb->geometry.num_ways,
+                             page_number >> l2_tlb->geometry.set_index_bits, frame_number);
+}
+
 // Prints all L1 TLB entries set-wise
 
 void print_L1_tlb (L1_TLB* l1_tlb) {
-    int i = 0;
-    int j = 0;
-    
-    for (i = 0; i < NUM_L1_TLB_SETS; i++) {
+    unsigned int num_ways = l1_tlb->geometry.num_ways;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    for (i = 0; i < l1_tlb->geometry.num_sets; i++) {
         printf ("SET %d\n", i + 1);
-        for (j = 0; j < NUM_L1_TLB_WAYS; j++)
-            printf(" Page Tag Number: %d Frame Number: %d Valid Bit: %d Shared bit: %d\n", l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].page_tag_entry, l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].frame_number_entry, l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].valid_bit, l1_tlb->l1_tlb_sets[i].l1_tlb_entry[j].shared_bit);
+        for (j = 0; j < num_ways; j++)
+            printf(" Page Tag Number: %d Frame Number: %d Valid Bit: %d Shared bit: %d\n", l1_tlb->page_tag_entry[i * num_ways + j], l1_tlb->frame_number_entry[i * num_ways + j], (l1_tlb->valid_bits[i] >> j) & 1, (l1_tlb->shared_bits[i] >> j) & 1);
     }
-} 
+}
 
-// Prints all L2 TLB entries set-wise 
+// Prints all L2 TLB entries set-wise
 
 void print_L2_tlb (L2_TLB* l2_tlb) {
-    int i = 0;
-    int j = 0;
-    
-    for (i = 0; i < NUM_L2_TLB_SETS; i++) {
+    unsigned int num_ways = l2_tlb->geometry.num_ways;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    for (i = 0; i < l2_tlb->geometry.num_sets; i++) {
         printf ("SET %d\n", i + 1);
-        for (j = 0; j < NUM_L2_TLB_WAYS; j++)
-            printf(" Page Tag Number: %d Frame Number: %d Valid Bit: %d Shared bit: %d\n", l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].page_tag_entry, l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].frame_number_entry, l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].valid_bit, l2_tlb->l2_tlb_sets[i].l2_tlb_entry[j].shared_bit);
+        for (j = 0; j < num_ways; j++)
+            printf(" Page Tag Number: %d Frame Number: %d Valid Bit: %d Shared bit: %d\n", l2_tlb->page_tag_entry[i * num_ways + j], l2_tlb->frame_number_entry[i * num_ways + j], (l2_tlb->valid_bits[i] >> j) & 1, (l2_tlb->shared_bits[i] >> j) & 1);
     }
-} 
-
+}
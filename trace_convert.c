@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tracefile.h"
+
+// Converts text trace files (one hex logical address per line) into binary trace files that the driver can read directly.
+// By default the raw (memory-mappable) format is written, -z writes the delta + zigzag varint compressed format instead.
+// Usage: trace_convert [-z] <input text trace> <output binary trace> [<input text trace> <output binary trace> ...]
+
+int main (int argc, char *argv[]) {
+    int i = 1;
+    int file_format = TRACE_FILE_RAW;
+    long long num_records = 0;
+
+    if (argc > 1 && strcmp (argv[1], "-z") == 0) {
+        file_format = TRACE_FILE_VARINT;
+        i++;
+    }
+
+    if (argc - i < 2 || (argc - i) % 2 != 0) {
+        printf(" Usage: %s [-z] <input text trace> <output binary trace> [...]\n", argv[0]);
+        return -1;
+    }
+
+    for (; i < argc; i = i + 2) {
+        num_records = convert_text_trace (argv[i], argv[i + 1], file_format);
+        if (num_records < 0)
+            return -1;
+
+        printf(" %s -> %s: %lld traces\n", argv[i], argv[i + 1], num_records);
+    }
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include "tracefile.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TRACE_PARSER_X86_SIMD 1
+#endif
+
+// Text trace files hold one 32-bit logical address per line as exactly 8 hex digits ended by "\n" or "\r\n". Runs of such lines are decoded
+// several at a time with SIMD (4 lines per AVX2 step, 2 lines per SSE4.1 step), anything else (short addresses, 0x prefixes, blank lines,
+// odd line endings, the last line of the file) goes through the scalar parser. The SIMD paths are compiled with per-function target
+// attributes and selected at run time, so the makefile flags do not change and the parser still runs on machines without AVX2/SSE4.1.
+
+// SIMD support levels
+#define TRACE_PARSER_SCALAR 0
+#define TRACE_PARSER_SSE41 1
+#define TRACE_PARSER_AVX2 2
+
+// Number of hex digits in a fixed-width line
+#define TRACE_HEX_DIGITS 8
+
+static int trace_parser_simd_level = -1;      // Detected on first use
+
+// Value + 1 of each hex digit character, 0 for anything else
+static const unsigned char hex_digit_value[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+};
+
+// Checks the SIMD support of the CPU we are running on.
+
+static int get_trace_parser_simd_level () {
+#ifdef TRACE_PARSER_X86_SIMD
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+        return TRACE_PARSER_AVX2;
+    if (__builtin_cpu_supports ("sse4.1"))
+        return TRACE_PARSER_SSE41;
+#endif
+    return TRACE_PARSER_SCALAR;
+}
+
+// Returns the length of the fixed-width line starting at position (8 hex digits + "\n" or "\r\n"), or 0 if the line terminator does not match.
+// The digits themselves are validated by the SIMD decoders.
+
+static size_t get_fixed_line_length (const char *buffer, size_t length, size_t position) {
+    if (position + TRACE_HEX_DIGITS + 1 <= length && buffer[position + TRACE_HEX_DIGITS] == '\n')
+        return TRACE_HEX_DIGITS + 1;
+    if (position + TRACE_HEX_DIGITS + 2 <= length && buffer[position + TRACE_HEX_DIGITS] == '\r' && buffer[position + TRACE_HEX_DIGITS + 1] == '\n')
+        return TRACE_HEX_DIGITS + 2;
+    return 0;
+}
+
+// Loads the 8 hex digit characters of a line (character 0 in the lowest byte).
+
+static unsigned long long load_hex_digits (const char *line) {
+    unsigned long long digits = 0;
+    memcpy (&digits, line, TRACE_HEX_DIGITS);
+    return digits;
+}
+
+#ifdef TRACE_PARSER_X86_SIMD
+
+// Decodes two lines of 8 hex digits (one per 64-bit half) into two addresses. Returns 0 if any character is not a hex digit.
+// Every character is turned into its nibble value, adjacent nibbles are combined into bytes with a multiply-add (high nibble * 16 + low nibble),
+// the bytes are packed together and reversed per address (the first digit pair is the most significant byte).
+
+__attribute__ ((target ("sse4.1")))
+static int decode_hex_lines_sse41 (unsigned long long line_0, unsigned long long line_1, uint32_t *records) {
+    __m128i ascii = _mm_set_epi64x ((long long) line_1, (long long) line_0);
+    __m128i digit = _mm_sub_epi8 (ascii, _mm_set1_epi8 ('0'));
+    __m128i letter = _mm_sub_epi8 (_mm_or_si128 (ascii, _mm_set1_epi8 (0x20)), _mm_set1_epi8 ('a'));    // Folds 'A'-'F' onto 'a'-'f'
+    __m128i is_digit = _mm_cmpeq_epi8 (_mm_min_epu8 (digit, _mm_set1_epi8 (9)), digit);                 // (unsigned) digit <= 9
+    __m128i is_letter = _mm_cmpeq_epi8 (_mm_min_epu8 (letter, _mm_set1_epi8 (5)), letter);              // (unsigned) letter <= 5
+    __m128i nibbles;
+    __m128i bytes;
+
+    if (_mm_movemask_epi8 (_mm_or_si128 (is_digit, is_letter)) != 0xFFFF)
+        return 0;
+
+    nibbles = _mm_blendv_epi8 (_mm_add_epi8 (letter, _mm_set1_epi8 (10)), digit, is_digit);
+    bytes = _mm_maddubs_epi16 (nibbles, _mm_set1_epi16 (0x0110));
+    bytes = _mm_packus_epi16 (bytes, bytes);
+    bytes = _mm_shuffle_epi8 (bytes, _mm_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 3, 2, 1, 0, 7, 6, 5, 4));
+
+    records[0] = (uint32_t) _mm_cvtsi128_si32 (bytes);
+    records[1] = (uint32_t) _mm_extract_epi32 (bytes, 1);
+    return 1;
+}
+
+// Same as decode_hex_lines_sse41 for four lines at once (two per 128-bit lane).
+
+__attribute__ ((target ("avx2")))
+static int decode_hex_lines_avx2 (const unsigned long long *lines, uint32_t *records) {
+    __m256i ascii = _mm256_set_epi64x ((long long) lines[3], (long long) lines[2], (long long) lines[1], (long long) lines[0]);
+    __m256i digit = _mm256_sub_epi8 (ascii, _mm256_set1_epi8 ('0'));
+    __m256i letter = _mm256_sub_epi8 (_mm256_or_si256 (ascii, _mm256_set1_epi8 (0x20)), _mm256_set1_epi8 ('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8 (_mm256_min_epu8 (digit, _mm256_set1_epi8 (9)), digit);
+    __m256i is_letter = _mm256_cmpeq_epi8 (_mm256_min_epu8 (letter, _mm256_set1_epi8 (5)), letter);
+    __m256i nibbles;
+    __m256i bytes;
+
+    if ((unsigned int) _mm256_movemask_epi8 (_mm256_or_si256 (is_digit, is_letter)) != 0xFFFFFFFFu)
+        return 0;
+
+    nibbles = _mm256_blendv_epi8 (_mm256_add_epi8 (letter, _mm256_set1_epi8 (10)), digit, is_digit);
+    bytes = _mm256_maddubs_epi16 (nibbles, _mm256_set1_epi16 (0x0110));
+    bytes = _mm256_packus_epi16 (bytes, bytes);
+    bytes = _mm256_shuffle_epi8 (bytes, _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 3, 2, 1, 0, 7, 6, 5, 4,
+                                                          3, 2, 1, 0, 7, 6, 5, 4, 3, 2, 1, 0, 7, 6, 5, 4));
+
+    records[0] = (uint32_t) _mm256_extract_epi32 (bytes, 0);
+    records[1] = (uint32_t) _mm256_extract_epi32 (bytes, 1);
+    records[2] = (uint32_t) _mm256_extract_epi32 (bytes, 4);
+    records[3] = (uint32_t) _mm256_extract_epi32 (bytes, 5);
+    return 1;
+}
+
+#endif
+
+// Parses the next whitespace-separated hex address the way fscanf ("%x") does - optional 0x prefix, any number of digits.
+// Returns 1 and advances position past the address, 0 if the buffer holds no further complete address (position then stays at
+// the incomplete address so it can be parsed once more data is available), or -1 if the next token is not a hex address.
+
+static int parse_hex_trace_scalar (const char *buffer, size_t length, int end_of_input, size_t *position, uint32_t *record) {
+    size_t i = *position;
+    size_t token_start = 0;
+    size_t digits_start = 0;
+    uint32_t value = 0;
+
+    // Skip blank space and line endings
+    while (i < length && (buffer[i] == ' ' || buffer[i] == '\t' || buffer[i] == '\r' || buffer[i] == '\n'))
+        i++;
+    if (i == length) {
+        *position = i;
+        return 0;
+    }
+    token_start = i;
+
+    if (i + 1 < length && buffer[i] == '0' && (buffer[i + 1] == 'x' || buffer[i + 1] == 'X'))
+        i = i + 2;
+
+    digits_start = i;
+    while (i < length && hex_digit_value[(unsigned char) buffer[i]] != 0) {
+        value = (value << 4) | (uint32_t) (hex_digit_value[(unsigned char) buffer[i]] - 1);
+        i++;
+    }
+
+    // The address runs up to the end of the buffer - it may continue in the next chunk
+    if (i == length && !end_of_input) {
+        *position = token_start;
+        return 0;
+    }
+
+    // No hex digits - not an address, except for a bare "0x" which fscanf (glibc) reads as the address 0
+    if (i == digits_start) {
+        if (digits_start == token_start + 2) {
+            *record = 0;
+            *position = digits_start;
+            return 1;
+        }
+        *position = token_start;
+        return -1;
+    }
+
+    *record = value;
+    *position = i;
+    return 1;
+}
+
+// Parses as many complete addresses from the given chunk of a text trace file as fit into records. The chunk may be a read buffer or
+// (part of) a memory-mapped file. If end_of_input is 0 a trailing address that is not yet terminated is left unconsumed for the next chunk.
+// Returns the number of addresses parsed, *bytes_consumed gives the number of chunk bytes that were used up. Parsing also stops at the
+// first token that is not a hex address (*bytes_consumed then points at it).
+
+size_t parse_hex_traces (const char *buffer, size_t length, int end_of_input, uint32_t *records, size_t max_records, size_t *bytes_consumed) {
+    size_t position = 0;
+    size_t num_records = 0;
+    size_t line_length[4];        // Lengths of the next fixed-width lines (0 if the line is not fixed-width)
+    unsigned long long lines[4];  // Hex digits of the next fixed-width lines
+    int simd_level = 0;
+    int retval = 0;
+    int i = 0;
+
+    if (trace_parser_simd_level < 0)
+        trace_parser_simd_level = get_trace_parser_simd_level ();
+    simd_level = trace_parser_simd_level;
+
+    while (num_records < max_records) {
+
+#ifdef TRACE_PARSER_X86_SIMD
+        // AVX2 - four fixed-width lines at once
+        if (simd_level >= TRACE_PARSER_AVX2 && num_records + 4 <= max_records) {
+            size_t line_position = position;
+
+            for (i = 0; i < 4; i++) {
+                line_length[i] = get_fixed_line_length (buffer, length, line_position);
+                if (line_length[i] == 0)
+                    break;
+                lines[i] = load_hex_digits (buffer + line_position);
+                line_position = line_position + line_length[i];
+            }
+            if (i == 4 && decode_hex_lines_avx2 (lines, records + num_records)) {
+                num_records = num_records + 4;
+                position = line_position;
+                continue;
+            }
+        }
+
+        // SSE4.1 - two fixed-width lines at once
+        if (simd_level >= TRACE_PARSER_SSE41 && num_records + 2 <= max_records) {
+            line_length[0] = get_fixed_line_length (buffer, length, position);
+            line_length[1] = line_length[0] ? get_fixed_line_length (buffer, length, position + line_length[0]) : 0;
+
+            if (line_length[1] != 0) {
+                lines[0] = load_hex_digits (buffer + position);
+                lines[1] = load_hex_digits (buffer + position + line_length[0]);
+                if (decode_hex_lines_sse41 (lines[0], lines[1], records + num_records)) {
+                    num_records = num_records + 2;
+                    position = position + line_length[0] + line_length[1];
+                    continue;
+                }
+            }
+        }
+#endif
+
+        // Scalar fallback - one address
+        retval = parse_hex_trace_scalar (buffer, length, end_of_input, &position, records + num_records);
+        if (retval != 1)
+            break;
+        num_records++;
+    }
+
+    *bytes_consumed = position;
+    return num_records;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "trace_prefetch.h"
+
+// Reader thread - reads the traces of one process, decodes them and pushes them into the ring until the trace file ends
+// (or the simulation asks it to stop). When the ring is full it yields the CPU until the simulation has popped some traces.
+
+static void* trace_prefetch_thread (void *arg) {
+    trace_prefetch_ring *ring = (trace_prefetch_ring *) arg;
+    unsigned long head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+    unsigned int logical_address = 0;
+
+    while (!atomic_load_explicit (&ring->stop, memory_order_relaxed)) {
+
+        // Ring full - wait for the simulation thread to catch up
+        if (head - atomic_load_explicit (&ring->tail, memory_order_acquire) == TRACE_PREFETCH_RING_SIZE) {
+            sched_yield ();
+            continue;
+        }
+
+        if (read_next_trace (ring->reader, &logical_address) != TRACE_READ_SUCCESSFUL)
+            break;
+
+        decode_trace (logical_address, &ring->records[head % TRACE_PREFETCH_RING_SIZE]);
+        head++;
+
+        // Publish the trace - the release store makes the record contents visible before the new head
+        atomic_store_explicit (&ring->head, head, memory_order_release);
+    }
+
+    atomic_store_explicit (&ring->end_of_stream, 1, memory_order_release);
+    return NULL;
+}
+
+// Creates the ring for the given trace file and starts its reader thread. Returns NULL if the thread cannot be created
+// (the caller then keeps reading the trace file directly).
+
+trace_prefetch_ring* start_trace_prefetch (trace_reader *reader) {
+    trace_prefetch_ring *ring;
+
+    ring = (trace_prefetch_ring *) aligned_alloc (HOST_CACHE_LINE_SIZE, sizeof (trace_prefetch_ring));
+    atomic_init (&ring->head, 0);
+    atomic_init (&ring->tail, 0);
+    atomic_init (&ring->end_of_stream, 0);
+    atomic_init (&ring->stop, 0);
+    ring->reader = reader;
+
+    if (pthread_create (&ring->reader_thread, NULL, trace_prefetch_thread, ring) != 0) {
+        free (ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+// Pops the next decoded trace. Normally the trace is already waiting in the ring - if not, yield until the reader thread pushes one
+// or reports the end of the trace file.
+
+int pop_prefetched_trace (trace_prefetch_ring *ring, trace_info *trace) {
+    unsigned long tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+
+    while (tail == atomic_load_explicit (&ring->head, memory_order_acquire)) {
+
+        // Ring empty - check for the end of the stream only after re-reading head, so that traces pushed just before it are not lost
+        if (atomic_load_explicit (&ring->end_of_stream, memory_order_acquire)) {
+            if (tail == atomic_load_explicit (&ring->head, memory_order_acquire))
+                return EOF;
+            break;
+        }
+        sched_yield ();
+    }
+
+    *trace = ring->records[tail % TRACE_PREFETCH_RING_SIZE];
+
+    // Hand the slot back to the reader thread
+    atomic_store_explicit (&ring->tail, tail + 1, memory_order_release);
+
+    return 1;
+}
+
+// Stops the reader thread (if it is still running), waits for it to finish and frees the ring.
+
+void stop_trace_prefetch (trace_prefetch_ring *ring) {
+    atomic_store_explicit (&ring->stop, 1, memory_order_relaxed);
+    pthread_join (ring->reader_thread, NULL);
+    free (ring);
+}
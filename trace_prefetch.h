@@ -0,0 +1,41 @@
+#ifndef TRACE_PREFETCH_H
+#define TRACE_PREFETCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "processes.h"
+
+// TRACE PREFETCH MACROS
+
+// Number of decoded traces buffered ahead of the simulation per process (power of 2 so that ring indices wrap with a mask)
+#define TRACE_PREFETCH_RING_SIZE 8192
+
+// Size of a host cache line - producer and consumer indices are kept on separate lines to avoid false sharing
+#define HOST_CACHE_LINE_SIZE 64
+
+// TRACE PREFETCH ADT DEFINITIONS
+
+// Single-producer single-consumer ring of decoded traces. The reader thread of the process is the only producer (advances head),
+// the simulation thread is the only consumer (advances tail). Indices only ever increase - the slot is index % TRACE_PREFETCH_RING_SIZE
+typedef struct trace_prefetch_ring {
+    _Alignas (HOST_CACHE_LINE_SIZE) atomic_ulong head;       // Number of traces pushed so far - written by the reader thread only
+    _Alignas (HOST_CACHE_LINE_SIZE) atomic_ulong tail;       // Number of traces popped so far - written by the simulation thread only
+    _Alignas (HOST_CACHE_LINE_SIZE) atomic_int end_of_stream; // Set by the reader thread once the last trace has been pushed
+    atomic_int stop;                                          // Set by the simulation thread to make the reader thread quit early
+    trace_reader *reader;                                     // Trace file the reader thread reads from
+    pthread_t reader_thread;                                  // Thread reading and decoding the traces of the process
+    trace_info records [TRACE_PREFETCH_RING_SIZE];            // Decoded traces
+} trace_prefetch_ring;
+
+// FUNCTION DECLARATIONS
+
+// Starts a reader thread that reads and decodes the traces of the given trace file ahead of time into a new ring
+trace_prefetch_ring* start_trace_prefetch (trace_reader *reader);
+
+// Pops the next decoded trace from the ring (waits for the reader thread if the ring is empty) - returns EOF once all traces were popped
+int pop_prefetched_trace (trace_prefetch_ring *ring, trace_info *trace);
+
+// Stops and joins the reader thread and frees the ring (the trace file itself is left open)
+void stop_trace_prefetch (trace_prefetch_ring *ring);
+
+#endif
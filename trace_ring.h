@@ -0,0 +1,176 @@
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+// SHARED-MEMORY TRACE RING
+//
+// Live traces from another local process (e.g. a binary instrumentation tool) are passed to the simulator through a single-producer
+// single-consumer ring in a POSIX shared-memory object. Each ring carries the traces of one simulated process - list the ring as
+// "shm:<name>" in process_files.txt in place of a trace file name, e.g. "shm:/memsim_ring_0".
+//
+// This header is all a producer needs - it only depends on the C library and works from C and C++ (GCC / Clang atomic builtins):
+//
+//     trace_ring *ring = trace_ring_create ("/memsim_ring_0", 1 << 20);
+//     trace_ring_push (ring, logical_address);              // waits while the ring is full (backpressure)
+//     trace_ring_push_batch (ring, addresses, count);
+//     trace_ring_close (ring);                              // marks the end of the stream and unmaps the ring
+//
+// Layout of the shared-memory object (host byte order, every field on its own 64-byte line):
+//     0     magic (4 bytes, TRACE_RING_MAGIC), version (4 bytes), capacity (4 bytes, power of 2), record size (4 bytes, 4)
+//     64    head - number of traces pushed so far (8 bytes, written by the producer only)
+//     128   tail - number of traces consumed so far (8 bytes, written by the simulator only)
+//     192   end of stream flag (4 bytes, set by the producer after its last push)
+//     256   records - capacity 32-bit logical addresses, trace i in slot i % capacity
+// head and tail only ever increase. The producer publishes traces with a release store of head, the simulator hands slots back with
+// a release store of tail - the ring is full while head - tail == capacity. The producer creates the object and writes the magic last;
+// the simulator waits for it, and unlinks the object once it is done with the ring.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define TRACE_RING_MAGIC 0x5253534D           // "MSSR" when read as little-endian bytes - Memory Subsystem Shared Ring
+#define TRACE_RING_VERSION 1
+#define TRACE_RING_RECORD_SIZE 4               // Each record is a 32-bit logical address
+#define TRACE_RING_LINE_SIZE 64
+
+// TRACE RING ADT DEFINITIONS
+
+typedef struct {
+    uint32_t magic;                            // TRACE_RING_MAGIC once the producer has initialized the ring
+    uint32_t version;                          // TRACE_RING_VERSION
+    uint32_t capacity;                         // Number of record slots (power of 2)
+    uint32_t record_size;                      // TRACE_RING_RECORD_SIZE
+    char pad0[TRACE_RING_LINE_SIZE - 16];
+    uint64_t head;                             // Traces pushed so far - producer only
+    char pad1[TRACE_RING_LINE_SIZE - 8];
+    uint64_t tail;                             // Traces consumed so far - simulator only
+    char pad2[TRACE_RING_LINE_SIZE - 8];
+    uint32_t end_of_stream;                    // Set by the producer once the last trace has been pushed
+    char pad3[TRACE_RING_LINE_SIZE - 4];
+    uint32_t records[];                        // capacity slots
+} trace_ring_layout;
+
+// Producer-side handle of a mapped ring
+typedef struct {
+    trace_ring_layout *shared;
+    size_t map_length;
+    uint64_t head;                             // Local copy of head
+    uint64_t tail_seen;                        // Latest tail read from the ring - re-read only when the ring looks full
+} trace_ring;
+
+// Bytes of shared memory taken by a ring with the given number of slots
+static inline size_t trace_ring_size (uint32_t capacity) {
+    return sizeof (trace_ring_layout) + (size_t) capacity * TRACE_RING_RECORD_SIZE;
+}
+
+// Creates (or recreates) the named shared-memory ring with capacity slots (power of 2) and maps it - returns NULL on error
+static inline trace_ring* trace_ring_create (const char *name, uint32_t capacity) {
+    trace_ring *ring;
+    void *map_base;
+    int fd;
+
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        return NULL;
+
+    fd = shm_open (name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate (fd, (off_t) trace_ring_size (capacity)) < 0) {
+        close (fd);
+        shm_unlink (name);
+        return NULL;
+    }
+    map_base = mmap (NULL, trace_ring_size (capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map_base == MAP_FAILED) {
+        shm_unlink (name);
+        return NULL;
+    }
+
+    ring = (trace_ring *) malloc (sizeof (trace_ring));
+    if (ring == NULL) {
+        munmap (map_base, trace_ring_size (capacity));
+        shm_unlink (name);
+        return NULL;
+    }
+    ring->shared = (trace_ring_layout *) map_base;
+    ring->map_length = trace_ring_size (capacity);
+    ring->head = 0;
+    ring->tail_seen = 0;
+
+    // A freshly truncated object is zero-filled - head, tail and the end of stream flag start out cleared
+    ring->shared->version = TRACE_RING_VERSION;
+    ring->shared->capacity = capacity;
+    ring->shared->record_size = TRACE_RING_RECORD_SIZE;
+    __atomic_store_n (&ring->shared->magic, TRACE_RING_MAGIC, __ATOMIC_RELEASE);
+
+    return ring;
+}
+
+// Number of free slots - the tail is only re-read from shared memory when the cached value says the ring is full
+static inline uint32_t trace_ring_free_slots (trace_ring *ring) {
+    uint32_t capacity = ring->shared->capacity;
+
+    if (ring->head - ring->tail_seen == capacity)
+        ring->tail_seen = __atomic_load_n (&ring->shared->tail, __ATOMIC_ACQUIRE);
+    return capacity - (uint32_t) (ring->head - ring->tail_seen);
+}
+
+// Pushes one trace unless the ring is full - returns 1 if pushed, 0 if full
+static inline int trace_ring_try_push (trace_ring *ring, uint32_t logical_address) {
+    if (trace_ring_free_slots (ring) == 0)
+        return 0;
+
+    ring->shared->records[ring->head & (ring->shared->capacity - 1)] = logical_address;
+    ring->head++;
+    __atomic_store_n (&ring->shared->head, ring->head, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Pushes one trace, yielding the CPU while the ring is full
+static inline void trace_ring_push (trace_ring *ring, uint32_t logical_address) {
+    while (!trace_ring_try_push (ring, logical_address))
+        sched_yield ();
+}
+
+// Pushes count traces, publishing them as they fit (one head update per contiguous run of slots) and yielding while the ring is full
+static inline void trace_ring_push_batch (trace_ring *ring, const uint32_t *logical_addresses, size_t count) {
+    uint32_t capacity = ring->shared->capacity;
+    uint32_t slot = 0;
+    size_t run = 0;
+
+    while (count > 0) {
+        run = trace_ring_free_slots (ring);
+        if (run == 0) {
+            sched_yield ();
+            continue;
+        }
+
+        // Stop at the end of the ring - the next run starts at slot 0
+        slot = (uint32_t) (ring->head & (capacity - 1));
+        if (run > capacity - slot)
+            run = capacity - slot;
+        if (run > count)
+            run = count;
+
+        memcpy (&ring->shared->records[slot], logical_addresses, run * TRACE_RING_RECORD_SIZE);
+        ring->head = ring->head + run;
+        __atomic_store_n (&ring->shared->head, ring->head, __ATOMIC_RELEASE);
+
+        logical_addresses = logical_addresses + run;
+        count = count - run;
+    }
+}
+
+// Marks the end of the stream (the simulator terminates the process once it has consumed all traces) and unmaps the ring
+static inline void trace_ring_close (trace_ring *ring) {
+    __atomic_store_n (&ring->shared->end_of_stream, 1, __ATOMIC_RELEASE);
+    munmap (ring->shared, ring->map_length);
+    free (ring);
+}
+
+#endif
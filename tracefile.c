@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tracefile.h"
+#include "trace_ring.h"
+
+// Size of the stdio buffer used to stream compressed trace files from disk
+#define TRACE_STREAM_BUFFER_SIZE (1 << 20)
+
+// Maps a raw binary trace file read-only into memory. The header has already been read and validated by open_trace_reader.
+
+static trace_reader* open_raw_trace_reader (const char *filename, const trace_file_header *header) {
+    int fd = 0;
+    struct stat file_stat;
+    void *map_base = NULL;
+    trace_reader *reader = NULL;
+
+    fd = open (filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    // All the records announced in the header must actually be present in the file
+    if (fstat (fd, &file_stat) < 0 || header->record_size != TRACE_RECORD_SIZE ||
+        header->record_count > ((size_t) file_stat.st_size - sizeof (trace_file_header)) / TRACE_RECORD_SIZE) {
+        close (fd);
+        return NULL;
+    }
+
+    map_base = mmap (NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map_base == MAP_FAILED) {
+        close (fd);
+        return NULL;
+    }
+
+    // Traces are consumed front to back - let the kernel read ahead aggressively
+    madvise (map_base, file_stat.st_size, MADV_SEQUENTIAL);
+
+    reader = (trace_reader *) calloc (1, sizeof (trace_reader));
+    reader->file_format = TRACE_FILE_RAW;
+    reader->fd = fd;
+    reader->map_base = map_base;
+    reader->map_length = file_stat.st_size;
+    reader->records = (const uint32_t *) ((const char *) map_base + sizeof (trace_file_header));
+
+    return reader;
+}
+
+// Sets up a streaming reader for a compressed trace file - the stream is left positioned at the first block header.
+
+static trace_reader* open_varint_trace_reader (FILE *stream, const trace_file_header *header) {
+    trace_reader *reader = NULL;
+
+    if (header->record_size == 0 || header->record_size > TRACE_VARINT_BLOCK_RECORDS)
+        return NULL;
+
+    reader = (trace_reader *) calloc (1, sizeof (trace_reader));
+    reader->file_format = TRACE_FILE_VARINT;
+    reader->fd = -1;
+    reader->stream = stream;
+    reader->max_block_records = header->record_size;
+    reader->block_payload = (unsigned char *) malloc (header->record_size * TRACE_VARINT_MAX_BYTES);
+    reader->block_records = (uint32_t *) malloc (header->record_size * sizeof (uint32_t));
+
+    return reader;
+}
+
+// Sets up a chunked reader for a text trace file - the stream is rewound to the start of the file.
+
+static trace_reader* open_text_trace_reader (FILE *stream) {
+    trace_reader *reader = NULL;
+
+    rewind (stream);
+
+    reader = (trace_reader *) calloc (1, sizeof (trace_reader));
+    reader->file_format = TRACE_FILE_TEXT;
+    reader->fd = -1;
+    reader->stream = stream;
+    reader->max_block_records = TRACE_TEXT_CHUNK_RECORDS;
+    reader->block_records = (uint32_t *) malloc (TRACE_TEXT_CHUNK_RECORDS * sizeof (uint32_t));
+    reader->text_buffer = (char *) malloc (TRACE_TEXT_CHUNK_SIZE);
+
+    return reader;
+}
+
+// Maps the named shared-memory trace ring. The producer may start after the simulator, so the ring is polled for until the
+// producer has created and initialized it (magic written last) or TRACE_SHM_OPEN_TIMEOUT seconds have passed.
+
+static trace_reader* open_shm_trace_reader (const char *name) {
+    const struct timespec poll_interval = { 0, 10000000 };      // 10 ms
+    long num_polls = 0;
+    struct stat object_stat;
+    trace_ring_layout *layout;
+    void *map_base = MAP_FAILED;
+    trace_reader *reader = NULL;
+    int fd = -1;
+
+    for (num_polls = 0; num_polls < TRACE_SHM_OPEN_TIMEOUT * 100L; num_polls++) {
+        fd = shm_open (name, O_RDWR, 0);
+        if (fd >= 0) {
+            if (fstat (fd, &object_stat) == 0 && (size_t) object_stat.st_size >= sizeof (trace_ring_layout))
+                map_base = mmap (NULL, object_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close (fd);
+
+            if (map_base != MAP_FAILED) {
+                layout = (trace_ring_layout *) map_base;
+                if (__atomic_load_n (&layout->magic, __ATOMIC_ACQUIRE) == TRACE_RING_MAGIC)
+                    break;
+                munmap (map_base, object_stat.st_size);
+                map_base = MAP_FAILED;
+            }
+        }
+        nanosleep (&poll_interval, NULL);
+    }
+    if (map_base == MAP_FAILED)
+        return NULL;
+
+    // The ring must be complete and the slots a power of 2
+    if (layout->version != TRACE_RING_VERSION || layout->record_size != TRACE_RING_RECORD_SIZE || layout->capacity == 0 ||
+        (layout->capacity & (layout->capacity - 1)) != 0 || (size_t) object_stat.st_size < trace_ring_size (layout->capacity)) {
+        munmap (map_base, object_stat.st_size);
+        return NULL;
+    }
+
+    reader = (trace_reader *) calloc (1, sizeof (trace_reader));
+    reader->file_format = TRACE_FILE_SHM;
+    reader->fd = -1;
+    reader->map_base = map_base;
+    reader->map_length = object_stat.st_size;
+    reader->records = layout->records;
+    reader->shm_name = strdup (name);
+    reader->shm_slot_mask = layout->capacity - 1;
+    reader->shm_head = 0;
+    reader->shm_released = 0;
+    reader->shm_hold = 1;
+
+    // Never hold back more than a quarter of the ring, so the producer can keep pushing while the simulator catches up
+    reader->shm_release_batch = layout->capacity / 4;
+    if (reader->shm_release_batch > TRACE_SHM_RELEASE_BATCH)
+        reader->shm_release_batch = TRACE_SHM_RELEASE_BATCH;
+    if (reader->shm_release_batch == 0)
+        reader->shm_release_batch = 1;
+
+    return reader;
+}
+
+// Opens the given trace file and detects its format from the header. Raw binary trace files are memory-mapped, compressed binary
+// trace files are streamed, and files without a binary trace magic are read as text trace files.
+// Returns NULL (without printing anything) if the file cannot be opened or carries a binary trace magic with an invalid header.
+
+trace_reader* open_trace_reader (const char *filename) {
+    FILE *stream;
+    trace_file_header header;
+    trace_reader *reader = NULL;
+    int header_read = 0;
+
+    // Live traces of another process - shared-memory ring
+    if (strncmp (filename, TRACE_SHM_PREFIX, strlen (TRACE_SHM_PREFIX)) == 0) {
+        reader = open_shm_trace_reader (filename + strlen (TRACE_SHM_PREFIX));
+        if (reader != NULL) {
+            reader->record_count = UINT64_MAX;
+            reader->access_type_flags = TRACE_HAS_INSTRUCTION | TRACE_HAS_DATA;
+            reader->next_record = 0;
+        }
+        return reader;
+    }
+
+    stream = fopen (filename, "rb");
+    if (stream == NULL)
+        return NULL;
+
+    header_read = (fread (&header, sizeof (trace_file_header), 1, stream) == 1);
+
+    if (header_read && (header.magic == TRACE_FILE_MAGIC || header.magic == TRACE_VARINT_FILE_MAGIC)) {
+        if (header.version != TRACE_FILE_VERSION) {
+            fclose (stream);
+            return NULL;
+        }
+
+        if (header.magic == TRACE_FILE_MAGIC) {
+            fclose (stream);
+            reader = open_raw_trace_reader (filename, &header);
+        }
+        else {
+            setvbuf (stream, NULL, _IOFBF, TRACE_STREAM_BUFFER_SIZE);
+            reader = open_varint_trace_reader (stream, &header);
+            if (reader == NULL)
+                fclose (stream);
+        }
+
+        if (reader != NULL) {
+            reader->record_count = header.record_count;
+            reader->access_type_flags = header.access_type_flags;
+        }
+    }
+    else {
+        // No binary trace magic - text trace file, the number of traces is only known once the whole file has been parsed
+        reader = open_text_trace_reader (stream);
+        reader->record_count = UINT64_MAX;
+        reader->access_type_flags = TRACE_HAS_INSTRUCTION | TRACE_HAS_DATA;
+    }
+
+    if (reader != NULL)
+        reader->next_record = 0;
+
+    return reader;
+}
+
+// Reads the next compressed block from the stream and decodes it into the reader's block buffer.
+// Returns 0 if there is no further (valid) block.
+
+static int load_next_trace_block (trace_reader *reader) {
+    trace_block_header block_header;
+    long num_decoded = 0;
+
+    if (fread (&block_header, sizeof (trace_block_header), 1, reader->stream) != 1)
+        return 0;
+
+    // Reject blocks that do not fit the buffers sized from the file header
+    if (block_header.record_count == 0 || block_header.record_count > reader->max_block_records ||
+        block_header.payload_bytes > reader->max_block_records * TRACE_VARINT_MAX_BYTES)
+        return 0;
+
+    if (fread (reader->block_payload, 1, block_header.payload_bytes, reader->stream) != block_header.payload_bytes)
+        return 0;
+
+    num_decoded = decode_trace_block (&block_header, reader->block_payload, reader->block_records);
+    if (num_decoded < 0)
+        return 0;
+
+    reader->block_record_count = (uint32_t) num_decoded;
+    reader->block_next_record = 0;
+    return 1;
+}
+
+// Parses the next chunk of a text trace file into the reader's block buffer. Text that was read but not parsed (an address split
+// across two chunks) is moved to the front of the text buffer and completed with the next read.
+// Returns 0 once the file holds no further address (end of file, or text that is not a hex address - as fscanf would stop there).
+
+static int load_next_text_block (trace_reader *reader) {
+    size_t num_read = 0;
+    size_t num_requested = 0;
+    size_t num_parsed = 0;
+    size_t bytes_consumed = 0;
+
+    while (1) {
+
+        // Keep the unparsed tail of the previous chunk
+        if (reader->text_position > 0) {
+            memmove (reader->text_buffer, reader->text_buffer + reader->text_position, reader->text_length - reader->text_position);
+            reader->text_length = reader->text_length - reader->text_position;
+            reader->text_position = 0;
+        }
+
+        // Fill up the rest of the text buffer
+        if (!reader->text_end_of_input && reader->text_length < TRACE_TEXT_CHUNK_SIZE) {
+            num_requested = TRACE_TEXT_CHUNK_SIZE - reader->text_length;
+            num_read = fread (reader->text_buffer + reader->text_length, 1, num_requested, reader->stream);
+            reader->text_length = reader->text_length + num_read;
+            if (num_read < num_requested)
+                reader->text_end_of_input = 1;
+        }
+
+        num_parsed = parse_hex_traces (reader->text_buffer, reader->text_length, reader->text_end_of_input,
+                                       reader->block_records, reader->max_block_records, &bytes_consumed);
+        reader->text_position = bytes_consumed;
+
+        if (num_parsed > 0) {
+            reader->block_record_count = (uint32_t) num_parsed;
+            reader->block_next_record = 0;
+            return 1;
+        }
+
+        // Nothing parsed even though no more text can be read or the buffer is full - END OF FILE (or a token that is not an address)
+        if (reader->text_end_of_input || (reader->text_position == 0 && reader->text_length == TRACE_TEXT_CHUNK_SIZE))
+            return 0;
+    }
+}
+
+// Waits until the producer has pushed the next trace of a shared-memory ring. Returns 0 if the producer has marked the end of the
+// stream and every trace it pushed has been read, or has pushed nothing for TRACE_SHM_READ_TIMEOUT seconds (a producer that died
+// without closing the ring) - the stream is then ended for good.
+
+static int wait_for_shm_trace (trace_reader *reader) {
+    trace_ring_layout *layout = (trace_ring_layout *) reader->map_base;
+    struct timespec wait_start, now;
+    unsigned long num_yields = 0;
+
+    while (reader->next_record == reader->shm_head) {
+        reader->shm_head = __atomic_load_n (&layout->head, __ATOMIC_ACQUIRE);
+        if (reader->next_record != reader->shm_head)
+            break;
+
+        // Ring empty - check for the end of the stream, then re-read head so that traces pushed just before it are not lost
+        if (__atomic_load_n (&layout->end_of_stream, __ATOMIC_ACQUIRE)) {
+            reader->shm_head = __atomic_load_n (&layout->head, __ATOMIC_ACQUIRE);
+            return reader->next_record != reader->shm_head;
+        }
+        sched_yield ();
+
+        // The clock is only read every TRACE_SHM_CLOCK_YIELDS yields
+        if (num_yields % TRACE_SHM_CLOCK_YIELDS == 0) {
+            clock_gettime (CLOCK_MONOTONIC, &now);
+            if (num_yields == 0)
+                wait_start = now;
+            else if ((now.tv_sec - wait_start.tv_sec) * 1000L + (now.tv_nsec - wait_start.tv_nsec) / 1000000 >= TRACE_SHM_READ_TIMEOUT * 1000L) {
+                fprintf(stderr, " ERROR: No trace pushed to the ring %s for %d seconds - ending its stream\n", reader->shm_name, TRACE_SHM_READ_TIMEOUT);
+                reader->record_count = reader->next_record;
+                return 0;
+            }
+        }
+        num_yields++;
+    }
+    return 1;
+}
+
+// Returns the next logical address of the trace file. Raw traces are a plain load from the mapping with no library call per record,
+// compressed and text traces are returned from the decoded block buffer (the file is only touched once per block / chunk).
+
+int read_next_trace (trace_reader *reader, unsigned int *logical_address) {
+
+    // All traces consumed - END OF FILE
+    if (reader->next_record == reader->record_count)
+        return TRACE_END_OF_FILE;
+
+    if (reader->file_format == TRACE_FILE_RAW) {
+        *logical_address = reader->records[reader->next_record];
+    }
+    else if (reader->file_format == TRACE_FILE_SHM) {
+        // Until the first rewind (after prepaging) every trace is held - once they fill the ring, reading further would lose them
+        if (reader->shm_hold && reader->next_record - reader->shm_released > reader->shm_slot_mask)
+            return TRACE_END_OF_FILE;
+        if (!wait_for_shm_trace (reader))
+            return TRACE_END_OF_FILE;
+        *logical_address = reader->records[reader->next_record & reader->shm_slot_mask];
+
+        // Hand the consumed slots back to the producer a batch at a time (one shared cache line write per batch)
+        if (!reader->shm_hold && reader->next_record + 1 - reader->shm_released >= reader->shm_release_batch) {
+            reader->shm_released = reader->next_record + 1;
+            __atomic_store_n (&((trace_ring_layout *) reader->map_base)->tail, reader->shm_released, __ATOMIC_RELEASE);
+        }
+    }
+    else {
+        // Current block exhausted - stream in and decode the next one
+        if (reader->block_next_record == reader->block_record_count) {
+            if (reader->file_format == TRACE_FILE_VARINT && !load_next_trace_block (reader))
+                return TRACE_END_OF_FILE;
+            if (reader->file_format == TRACE_FILE_TEXT && !load_next_text_block (reader))
+                return TRACE_END_OF_FILE;
+        }
+        *logical_address = reader->block_records[reader->block_next_record];
+        reader->block_next_record++;
+    }
+    reader->next_record++;
+
+    return TRACE_READ_SUCCESSFUL;
+}
+
+// Resets the reader so that the next read returns the first trace again (used after prepaging).
+
+void rewind_trace_reader (trace_reader *reader) {
+    reader->next_record = 0;
+
+    // Traces handed back to the producer are gone - restart from the oldest trace still held. Nothing is handed back before the
+    // first rewind, so that one restarts from the first trace.
+    if (reader->file_format == TRACE_FILE_SHM) {
+        reader->next_record = reader->shm_released;
+        reader->shm_hold = 0;
+    }
+
+    if (reader->file_format == TRACE_FILE_VARINT) {
+        fseek (reader->stream, sizeof (trace_file_header), SEEK_SET);
+        reader->block_record_count = 0;
+        reader->block_next_record = 0;
+    }
+    else if (reader->file_format == TRACE_FILE_TEXT) {
+        fseek (reader->stream, 0, SEEK_SET);
+        reader->block_record_count = 0;
+        reader->block_next_record = 0;
+        reader->text_length = 0;
+        reader->text_position = 0;
+        reader->text_end_of_input = 0;
+    }
+}
+
+// Unmaps / closes the trace file and frees the reader.
+
+void close_trace_reader (trace_reader *reader) {
+    if (reader->file_format == TRACE_FILE_RAW) {
+        munmap (reader->map_base, reader->map_length);
+        close (reader->fd);
+    }
+    else if (reader->file_format == TRACE_FILE_SHM) {
+        munmap (reader->map_base, reader->map_length);
+        shm_unlink (reader->shm_name);
+        free (reader->shm_name);
+    }
+    else {
+        fclose (reader->stream);
+        free (reader->block_payload);
+        free (reader->block_records);
+        free (reader->text_buffer);
+    }
+    free (reader);
+}
+
+// Encodes a block of traces. The traces interleave two address series - instructions (7fff... stack region) and data (100...) -
+// so every trace after the first is stored as the difference from the previous trace of the SAME series, which keeps the strides small.
+// The difference is zigzag mapped (so that small negative strides also give small values), the series bit is appended as the lowest bit,
+// and the result is written as a little-endian base-128 varint - 7 bits per byte, high bit set on all bytes but the last.
+// Most traces fit in 1-2 bytes.
+
+uint32_t encode_trace_block (const uint32_t *records, uint32_t record_count, unsigned char *payload) {
+    uint32_t num_bytes = 0;
+    uint32_t i = 0;
+    uint32_t previous[2];         // Previous trace of each series - both start at the first (stored) address of the block
+    int series = 0;               // 1 for the instruction series (7f...), 0 for the data series
+    int32_t delta = 0;
+    uint64_t value = 0;           // zigzag delta and series bit - 33 bits, so at most TRACE_VARINT_MAX_BYTES bytes
+
+    previous[0] = records[0];
+    previous[1] = records[0];
+
+    for (i = 1; i < record_count; i++) {
+        series = ((records[i] >> 24) == 0x7f);
+        delta = (int32_t) (records[i] - previous[series]);
+        value = ((uint64_t) (((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31)) << 1) | (uint64_t) series;
+        previous[series] = records[i];
+
+        while (value >= 0x80) {
+            payload[num_bytes++] = (unsigned char) (value | 0x80);
+            value = value >> 7;
+        }
+        payload[num_bytes++] = (unsigned char) value;
+    }
+
+    return num_bytes;
+}
+
+// Decodes a single block - needs nothing but the block header and its payload, so blocks can be decoded independently of each other.
+
+long decode_trace_block (const trace_block_header *block_header, const unsigned char *payload, uint32_t *records) {
+    uint32_t position = 0;
+    uint32_t i = 0;
+    uint32_t previous[2];         // Previous trace of each series (see encode_trace_block)
+    int series = 0;
+    uint32_t zigzag = 0;
+    uint64_t value = 0;
+    int shift = 0;
+    unsigned char byte = 0;
+
+    records[0] = block_header->first_address;
+    previous[0] = block_header->first_address;
+    previous[1] = block_header->first_address;
+
+    for (i = 1; i < block_header->record_count; i++) {
+        value = 0;
+        shift = 0;
+
+        // Gather the 7-bit groups of one varint
+        do {
+            if (position == block_header->payload_bytes || shift > 28)
+                return -1;
+            byte = payload[position++];
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            shift = shift + 7;
+        } while (byte & 0x80);
+
+        // Split off the series bit, undo the zigzag mapping and apply the delta to the previous trace of that series
+        series = (int) (value & 1);
+        zigzag = (uint32_t) (value >> 1);
+        records[i] = previous[series] + ((zigzag >> 1) ^ (0u - (zigzag & 1)));
+        previous[series] = records[i];
+    }
+
+    // Every payload byte must have been consumed
+    if (position != block_header->payload_bytes)
+        return -1;
+
+    return (long) block_header->record_count;
+}
+
+// Writes a block of traces (up to TRACE_VARINT_BLOCK_RECORDS) to a compressed trace file.
+
+static void write_trace_block (FILE *binary_file, const uint32_t *records, uint32_t record_count, unsigned char *payload) {
+    trace_block_header block_header;
+
+    block_header.record_count = record_count;
+    block_header.first_address = records[0];
+    block_header.payload_bytes = encode_trace_block (records, record_count, payload);
+
+    fwrite (&block_header, sizeof (trace_block_header), 1, binary_file);
+    fwrite (payload, 1, block_header.payload_bytes, binary_file);
+}
+
+// Converts a text trace file (one 32-bit hex logical address per line) into the given binary trace format. The input is read through
+// open_trace_reader, so a binary trace file can also be given as input (e.g. to compress a raw binary trace).
+// The header is written first with a record count of 0 and rewritten once all traces (and access types seen) are known.
+
+long long convert_text_trace (const char *text_filename, const char *binary_filename, int file_format) {
+    trace_reader *text_file;
+    FILE *binary_file;
+    trace_file_header header;
+    unsigned int logical_address = 0;
+    uint32_t record = 0;
+    uint32_t *block_records = NULL;           // Traces of the block being compressed
+    unsigned char *block_payload = NULL;      // Varint bytes of the block being compressed
+    uint32_t block_record_count = 0;
+
+    text_file = open_trace_reader (text_filename);
+    if (text_file == NULL) {
+        fprintf (stderr, " ERROR: Could not open the text trace file %s\n", text_filename);
+        return -1;
+    }
+
+    binary_file = fopen (binary_filename, "wb");
+    if (binary_file == NULL) {
+        fprintf (stderr, " ERROR: Could not create the binary trace file %s\n", binary_filename);
+        close_trace_reader (text_file);
+        return -1;
+    }
+
+    header.version = TRACE_FILE_VERSION;
+    header.record_count = 0;
+    header.access_type_flags = 0;
+
+    if (file_format == TRACE_FILE_VARINT) {
+        header.magic = TRACE_VARINT_FILE_MAGIC;
+        header.record_size = TRACE_VARINT_BLOCK_RECORDS;
+        block_records = (uint32_t *) malloc (TRACE_VARINT_BLOCK_RECORDS * sizeof (uint32_t));
+        block_payload = (unsigned char *) malloc (TRACE_VARINT_BLOCK_RECORDS * TRACE_VARINT_MAX_BYTES);
+    }
+    else {
+        header.magic = TRACE_FILE_MAGIC;
+        header.record_size = TRACE_RECORD_SIZE;
+    }
+    fwrite (&header, sizeof (trace_file_header), 1, binary_file);
+
+    // Copy every trace into a record (or the current block) and note its type (instruction series 7f... or data series)
+    while (read_next_trace (text_file, &logical_address) == TRACE_READ_SUCCESSFUL) {
+        record = logical_address;
+
+        if (file_format == TRACE_FILE_VARINT) {
+            block_records[block_record_count++] = record;
+            if (block_record_count == TRACE_VARINT_BLOCK_RECORDS) {
+                write_trace_block (binary_file, block_records, block_record_count, block_payload);
+                block_record_count = 0;
+            }
+        }
+        else {
+            fwrite (&record, TRACE_RECORD_SIZE, 1, binary_file);
+        }
+        header.record_count++;
+
+        if ((logical_address >> 24) == 0x7f)
+            header.access_type_flags |= TRACE_HAS_INSTRUCTION;
+        else
+            header.access_type_flags |= TRACE_HAS_DATA;
+    }
+
+    // Flush the last (partial) block
+    if (file_format == TRACE_FILE_VARINT) {
+        if (block_record_count > 0)
+            write_trace_block (binary_file, block_records, block_record_count, block_payload);
+        free (block_records);
+        free (block_payload);
+    }
+
+    // Rewrite the header with the final record count and access type flags
+    fseek (binary_file, 0, SEEK_SET);
+    fwrite (&header, sizeof (trace_file_header), 1, binary_file);
+
+    close_trace_reader (text_file);
+    if (fclose (binary_file) != 0) {
+        fprintf (stderr, " ERROR: Could not write the binary trace file %s\n", binary_filename);
+        return -1;
+    }
+
+    return (long long) header.record_count;
+}
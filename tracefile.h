@@ -0,0 +1,134 @@
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// BINARY TRACE FILE MACROS
+
+// Text trace files hold one hex logical address per line (see trace_parser.c).
+// Binary trace files start with a fixed header. Raw trace files follow it with one fixed-width 32-bit record (logical address) per trace,
+// compressed trace files follow it with independently decodable blocks of delta + zigzag varint encoded addresses
+#define TRACE_FILE_MAGIC 0x5452534D          // "MSRT" when read as little-endian bytes - Memory Subsystem Raw Trace
+#define TRACE_VARINT_FILE_MAGIC 0x5456534D   // "MSVT" when read as little-endian bytes - Memory Subsystem Varint Trace
+#define TRACE_FILE_VERSION 1
+#define TRACE_RECORD_SIZE 4                   // Each raw record is a 32-bit logical address stored in host (little-endian) byte order
+
+// Trace file formats
+#define TRACE_FILE_RAW 0                      // Fixed-width records - memory-mapped
+#define TRACE_FILE_VARINT 1                   // Delta + zigzag varint blocks - streamed from disk one block at a time
+#define TRACE_FILE_TEXT 2                     // Hex text - read in large chunks and parsed a chunk at a time
+#define TRACE_FILE_SHM 3                      // Shared-memory ring filled by a live producer process (see trace_ring.h)
+
+// Shared-memory trace rings - named "shm:<POSIX shared memory name>" in place of a trace file name
+#define TRACE_SHM_PREFIX "shm:"
+#define TRACE_SHM_OPEN_TIMEOUT 30             // Seconds to wait for the producer to create the ring
+#define TRACE_SHM_READ_TIMEOUT 30             // Seconds to wait for the producer to push the next trace - the stream then counts as ended
+#define TRACE_SHM_CLOCK_YIELDS 1024           // Yields of an empty-ring wait between two looks at the clock
+#define TRACE_SHM_RELEASE_BATCH 1024          // Consumed slots are handed back to the producer this many at a time (at most a quarter of the ring)
+
+// Text trace chunks
+#define TRACE_TEXT_CHUNK_SIZE (1 << 18)       // Bytes of text read and parsed at a time
+#define TRACE_TEXT_CHUNK_RECORDS (TRACE_TEXT_CHUNK_SIZE / 2 + 1)    // Most addresses a chunk can hold (1 digit + line feed each)
+
+// Compressed trace blocks
+#define TRACE_VARINT_BLOCK_RECORDS 4096       // Maximum number of traces per block
+#define TRACE_VARINT_MAX_BYTES 5              // A 32-bit zigzag delta plus the series bit takes at most 5 varint bytes (7 bits per byte)
+
+// Access type flags stored in the header - set if at least one trace of that type is present in the file
+#define TRACE_HAS_INSTRUCTION 0x1             // Instruction series traces (7f...)
+#define TRACE_HAS_DATA 0x2                    // Data series traces (10...)
+
+// Return values of the trace read functions
+#define TRACE_READ_SUCCESSFUL 1
+#define TRACE_END_OF_FILE -1                  // Same value as EOF, so callers can treat text and binary inputs alike
+
+// BINARY TRACE FILE ADT DEFINITIONS
+
+// Header at the start of every binary trace file (24 bytes, no padding)
+typedef struct {
+    uint32_t magic;                           // TRACE_FILE_MAGIC or TRACE_VARINT_FILE_MAGIC - identifies the file format
+    uint32_t version;                         // TRACE_FILE_VERSION - format version the file was written with
+    uint64_t record_count;                    // Total number of traces in the file
+    uint32_t access_type_flags;               // TRACE_HAS_INSTRUCTION and/or TRACE_HAS_DATA
+    uint32_t record_size;                     // Raw files: size of each record in bytes (TRACE_RECORD_SIZE)
+                                              // Compressed files: maximum number of traces per block (TRACE_VARINT_BLOCK_RECORDS)
+} trace_file_header;
+
+// Header at the start of every compressed block (12 bytes). The first address is stored as is, so every block decodes on its own
+typedef struct {
+    uint32_t record_count;                    // Number of traces in this block (including the first address)
+    uint32_t payload_bytes;                   // Number of varint bytes following this header
+    uint32_t first_address;                   // First logical address of the block - the remaining ones are deltas within their address series
+} trace_block_header;
+
+// Reader for a trace file - raw traces are read straight out of a memory mapping, compressed traces are decoded one block at a time,
+// text traces are parsed one chunk at a time and shared-memory rings are read in place as the producer fills them
+typedef struct {
+    int file_format;                          // TRACE_FILE_RAW, TRACE_FILE_VARINT, TRACE_FILE_TEXT or TRACE_FILE_SHM
+    uint64_t record_count;                    // Total number of traces in the file (UINT64_MAX for text files and rings - not known in advance)
+    uint64_t next_record;                     // Index of the next trace to be returned
+    unsigned int access_type_flags;           // Access type flags copied from the header
+
+    // TRACE_FILE_RAW and TRACE_FILE_SHM
+    int fd;                                   // File descriptor of the mapped file
+    void *map_base;                           // Start of the mapping (header)
+    size_t map_length;                        // Length of the mapping in bytes
+    const uint32_t *records;                  // First record - immediately after the header
+
+    // TRACE_FILE_VARINT and TRACE_FILE_TEXT
+    FILE *stream;                             // File stream - positioned at the next block header / next unread text
+    unsigned int max_block_records;           // Maximum number of traces per block (from the file header) / per text chunk
+    uint32_t *block_records;                  // Decoded traces of the current block / text chunk
+    uint32_t block_record_count;              // Number of decoded traces in the current block / text chunk
+    uint32_t block_next_record;               // Index of the next trace to be returned from the current block / text chunk
+
+    // TRACE_FILE_VARINT
+    unsigned char *block_payload;             // Varint bytes of the current block
+
+    // TRACE_FILE_TEXT
+    char *text_buffer;                        // Text read from the file that has not been parsed yet
+    size_t text_length;                       // Number of bytes in the text buffer
+    size_t text_position;                     // Number of text buffer bytes already parsed
+    int text_end_of_input;                    // Set once the whole file has been read into the text buffer
+
+    // TRACE_FILE_SHM
+    char *shm_name;                           // Name of the shared-memory object - unlinked when the reader is closed
+    uint32_t shm_slot_mask;                   // Ring capacity - 1
+    uint64_t shm_head;                        // Latest head read from the ring - re-read only when all traces up to it are consumed
+    uint64_t shm_released;                    // Traces handed back to the producer (the tail stored in the ring)
+    uint32_t shm_release_batch;               // Consumed traces handed back at a time
+    int shm_hold;                             // Set until the first rewind - no trace is handed back, so the rewind can replay them all
+} trace_reader;
+
+// FUNCTION DECLARATIONS
+
+// Opens a trace file (binary raw, binary compressed or text - detected from the file header) or a "shm:<name>" shared-memory ring
+// - returns NULL if the file cannot be opened
+trace_reader* open_trace_reader (const char *filename);
+
+// Reads the next trace (32-bit logical address) from the file - returns TRACE_END_OF_FILE once all traces are consumed
+// (shared-memory rings: also once a whole ring of traces is held for the first rewind)
+int read_next_trace (trace_reader *reader, unsigned int *logical_address);
+
+// Resets the reader to the first trace (shared-memory rings: only the first rewind - later ones go back to the oldest trace not yet
+// handed back to the producer)
+void rewind_trace_reader (trace_reader *reader);
+
+// Unmaps / closes the file and frees the reader
+void close_trace_reader (trace_reader *reader);
+
+// Delta + zigzag varint encodes a block of traces into payload - returns the number of payload bytes written
+uint32_t encode_trace_block (const uint32_t *records, uint32_t record_count, unsigned char *payload);
+
+// Decodes a single compressed block into records - returns the number of traces decoded, -1 if the payload is corrupt
+long decode_trace_block (const trace_block_header *block_header, const unsigned char *payload, uint32_t *records);
+
+// Parses a chunk of a text trace file into addresses (SIMD for fixed-width lines) - returns the number of addresses parsed
+size_t parse_hex_traces (const char *buffer, size_t length, int end_of_input, uint32_t *records, size_t max_records, size_t *bytes_consumed);
+
+// Converts a text trace file (one hex address per line) into a binary trace file of the given format - returns number of traces written, -1 on error
+long long convert_text_trace (const char *text_filename, const char *binary_filename, int file_format);
+
+#endif